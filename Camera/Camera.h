@@ -14,8 +14,22 @@
 
 #include "RayTracer/RayTracer.h"
 
+// Placement and lens of a camera, independent of the image it renders.
+struct CameraSettings {
+    Vector3d position = {};
+    Vector3d lookAt = { 0.0, 0.0, -1.0 };
+    Vector3d up = { 0.0, 1.0, 0.0 };
+    double verticalFov = 90.0;
+    double aperture = 0.0;
+    double focusDistance = 1.0;
+};
+
 class Camera {
 public:
+    Camera(double aspectRatio, const CameraSettings& settings)
+        : Camera(aspectRatio, settings.aperture, settings.focusDistance, settings.verticalFov,
+                 settings.position, settings.lookAt, settings.up) {}
+
     Camera(double aspectRatio,
            double aperture,
            double focusDistance,
@@ -51,6 +65,20 @@ public:
                  m_lowerLeftCorner + s * m_horizontal + t * m_vertical - m_origin - offset };
     }
 
+    // Viewport coordinates (s, t) of getRay through the lens center towards point, false when the
+    // point is behind the camera.
+    bool project(const Vector3d& point, double& s, double& t) const {
+        Vector3d direction = point - m_origin;
+        double depth = -dot(direction, w);
+        if (depth <= 0.0) return false;
+
+        s = dot(direction, u) / (depth * m_viewportWidth) + 0.5;
+        t = dot(direction, v) / (depth * m_viewportHeight) + 0.5;
+        return true;
+    }
+
+    inline const Vector3d& position() const { return m_origin; }
+
 private:
     double m_aspectRatio = 1.0;
     double m_lensRadius = 0.0f;
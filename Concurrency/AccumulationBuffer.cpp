@@ -0,0 +1,77 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#include <numeric>
+
+#include "AccumulationBuffer.h"
+
+void AccumulationBuffer::resolve(ExporterManager& em) const {
+    std::vector<float> row(3 * m_width);
+    for (int j = m_originY; j < m_originY + m_height; ++j) {
+        for (int i = m_originX; i < m_originX + m_width; ++i) {
+            auto color = average(i, j);
+            float* rgb = row.data() + 3 * (i - m_originX);
+            rgb[0] = static_cast<float>(color.r());
+            rgb[1] = static_cast<float>(color.g());
+            rgb[2] = static_cast<float>(color.b());
+        }
+        em.writeTile(m_originX, j, m_width, 1, row.data());
+    }
+}
+
+void AccumulationBuffer::preview(size_t width, size_t height, const TonemapSettings& tonemap, uint8_t* rgb) const {
+    std::vector<float> row(3 * width);
+    for (size_t j = 0; j < height; ++j) {
+        int y = m_originY + static_cast<int>((2 * j + 1) * m_height / (2 * height));
+        for (size_t i = 0; i < width; ++i) {
+            auto color = average(m_originX + static_cast<int>((2 * i + 1) * m_width / (2 * width)), y);
+            row[3 * i] = static_cast<float>(color.r());
+            row[3 * i + 1] = static_cast<float>(color.g());
+            row[3 * i + 2] = static_cast<float>(color.b());
+        }
+        tonemapRow(row.data(), width, 0, j, tonemap, rgb + 3 * j * width);
+    }
+}
+
+void AccumulationBuffer::write(std::ostream& out) const {
+    static_assert(sizeof(Vector3f) == 3 * sizeof(float), "Vector3f is written as packed floats.");
+    out.write(reinterpret_cast<const char*>(m_sum.data()), m_sum.size() * sizeof(Vector3f));
+    out.write(reinterpret_cast<const char*>(m_sampleCount.data()), m_sampleCount.size() * sizeof(uint32_t));
+    out.write(reinterpret_cast<const char*>(m_luminanceSquareSum.data()), m_luminanceSquareSum.size() * sizeof(float));
+}
+
+bool AccumulationBuffer::read(std::istream& in) {
+    in.read(reinterpret_cast<char*>(m_sum.data()), m_sum.size() * sizeof(Vector3f));
+    in.read(reinterpret_cast<char*>(m_sampleCount.data()), m_sampleCount.size() * sizeof(uint32_t));
+    in.read(reinterpret_cast<char*>(m_luminanceSquareSum.data()), m_luminanceSquareSum.size() * sizeof(float));
+    return static_cast<bool>(in);
+}
+
+uint64_t AccumulationBuffer::totalSampleCount() const {
+    return std::accumulate(m_sampleCount.begin(), m_sampleCount.end(), uint64_t(0));
+}
+
+double AccumulationBuffer::estimatedRelativeError() const {
+    constexpr double meanFloor = 0.01;
+
+    double errorSum = 0.0;
+    size_t pixelCount = 0;
+    for (size_t index = 0; index < m_sum.size(); ++index) {
+        double n = m_sampleCount[index];
+        // Variance is unknown below two samples.
+        if (n < 2.0) return infinity;
+
+        const auto& sum = m_sum[index];
+        double mean = luminance(Vector3d(sum.r(), sum.g(), sum.b())) / n;
+        double variance = std::max(0.0, (m_luminanceSquareSum[index] / n - mean * mean) * n / (n - 1.0));
+        errorSum += (variance / n) / (mean * mean + meanFloor * meanFloor);
+        ++pixelCount;
+    }
+    return pixelCount > 0 ? sqrt(errorSum / pixelCount) : infinity;
+}
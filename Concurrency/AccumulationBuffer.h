@@ -0,0 +1,86 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#ifndef ACCUMULATION_BUFFER_H
+#define ACCUMULATION_BUFFER_H
+
+#include "Exporter/ExporterManager.h"
+
+#include "RayTracer/RayTracer.h"
+
+/*
+ * Running sums of linear radiance and sample counts of the full image. Tiles write disjoint pixels,
+ * so passes can add into it concurrently, and any state of it resolves to a valid image.
+ * Squared luminance is summed as well to estimate the remaining noise of every pixel.
+ * A buffer may also cover only the width x height region at (originX, originY), e.g. a single tile
+ * rendered for a remote coordinator. Pixels are always addressed in full-image coordinates.
+ */
+class AccumulationBuffer {
+public:
+    AccumulationBuffer(int width, int height, int originX = 0, int originY = 0)
+        : m_width(width), m_height(height), m_originX(originX), m_originY(originY) {
+        m_sum.resize(width * height);
+        m_sampleCount.resize(width * height);
+        m_luminanceSquareSum.resize(width * height);
+    }
+
+    inline void add(int x, int y, const Vector3d& colorSum, double luminanceSquareSum, uint32_t sampleCount) {
+        size_t index = indexOf(x, y);
+        m_sum[index] += Vector3f(static_cast<float>(colorSum.r()), static_cast<float>(colorSum.g()),
+                                 static_cast<float>(colorSum.b()));
+        m_luminanceSquareSum[index] += static_cast<float>(luminanceSquareSum);
+        m_sampleCount[index] += sampleCount;
+    }
+
+    inline Vector3d average(int x, int y) const {
+        size_t index = indexOf(x, y);
+        if (m_sampleCount[index] == 0) return Vector3d::zero();
+        const auto& sum = m_sum[index];
+        return Vector3d(sum.r(), sum.g(), sum.b()) / static_cast<double>(m_sampleCount[index]);
+    }
+
+    inline uint32_t sampleCount(int x, int y) const { return m_sampleCount[indexOf(x, y)]; }
+
+    // Hand the average of every pixel of the region to em, which must cover it, a row at a time.
+    void resolve(ExporterManager& em) const;
+
+    // Point-sampled width x height 8-bit RGB of the averages, for live previews while passes add to it.
+    void preview(size_t width, size_t height, const TonemapSettings& tonemap, uint8_t* rgb) const;
+
+    uint64_t totalSampleCount() const;
+
+    /*
+     * Root mean square over all pixels of the standard error of the pixel mean relative to the mean,
+     * with a small floor on the mean so that black pixels do not dominate. Shrinks as 1 / sqrt(spp).
+     */
+    double estimatedRelativeError() const;
+
+    // Raw dump of all three buffers, read() expects the same size and returns false on a short stream.
+    void write(std::ostream& out) const;
+    bool read(std::istream& in);
+
+public:
+    inline int width() const { return m_width; }
+    inline int height() const { return m_height; }
+    inline int originX() const { return m_originX; }
+    inline int originY() const { return m_originY; }
+
+private:
+    inline size_t indexOf(int x, int y) const { return (x - m_originX) + (y - m_originY) * m_width; }
+
+private:
+    int m_width = 0, m_height = 0;
+    int m_originX = 0, m_originY = 0;
+
+    std::vector<Vector3f, AlignedAllocator<Vector3f>> m_sum = {};
+    std::vector<uint32_t, AlignedAllocator<uint32_t>> m_sampleCount = {};
+    std::vector<float, AlignedAllocator<float>> m_luminanceSquareSum = {};
+};
+
+#endif // ACCUMULATION_BUFFER_H
@@ -0,0 +1,153 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#include <thread>
+
+#include "BatchRenderer.h"
+
+BatchRenderer::Frame::Frame(const BatchJob& job, const PartialSceneInfo& sceneInfo, int tileSize,
+                            size_t workerCount, int groupCount)
+    : job(job), info(sceneInfo), scheduler(job.width, job.height, tileSize, workerCount, groupCount) {
+    info.fullSize = { job.width, job.height };
+    info.sampleCount = job.sampleCount;
+    info.camera = std::make_shared<Camera>(job.aspectRatio, job.camera);
+}
+
+BatchRenderer::BatchRenderer(ThreadPool& pool, const PartialSceneInfo& sceneInfo, int tileSize)
+    : m_pool(pool), m_sceneInfo(sceneInfo), m_tileSize(tileSize) {
+    m_sceneInfo.progress = &m_progress;
+    m_temporal = sceneInfo.directLighting == DirectLightingMode::ReSTIR && sceneInfo.restir.temporalMaxM > 0 &&
+                 sceneInfo.lights != nullptr && !sceneInfo.lights->empty();
+}
+
+BatchResult BatchRenderer::render(const std::vector<BatchJob>& jobs, double progressInterval) {
+    auto start = std::chrono::steady_clock::now();
+
+    m_frames.clear();
+    m_current = 0;
+    m_pendingCount = 0;
+    m_result = {};
+    uint64_t sampleCount = 0;
+    for (const auto& job : jobs) {
+        m_frames.push_back(std::make_unique<Frame>(job, m_sceneInfo, m_tileSize, m_pool.size(), m_pool.groupCount()));
+        sampleCount += static_cast<uint64_t>(job.width) * job.height * job.sampleCount;
+    }
+
+    std::thread writer(&BatchRenderer::writeFrames, this);
+
+    m_progress.start(sampleCount, m_pool.size());
+    std::vector<std::future<void>> workers;
+    for (size_t i = 0; i < m_pool.size(); ++i) {
+        workers.push_back(m_pool.submit([this] {
+            renderFrames();
+            m_progress.finishTask();
+        }));
+    }
+    m_progress.wait(std::cout, progressInterval);
+    for (auto& worker : workers) {
+        worker.get();
+    }
+    writer.join();
+    m_reservoirs[0] = m_reservoirs[1] = nullptr;
+
+    m_result.frameCount = jobs.size();
+    m_result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return m_result;
+}
+
+void BatchRenderer::renderFrames() {
+    int group = m_pool.currentGroup();
+    size_t index = m_current.load();
+    while (index < m_frames.size()) {
+        auto& frame = *m_frames[index];
+        if (m_temporal && index > 0) {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_frameRendered.wait(lock, [this, index] { return m_frames[index - 1]->finished.load(); });
+        }
+
+        frame.busy.fetch_add(1);
+        std::call_once(frame.started, [this, &frame, index] { startFrame(frame, index); });
+        Tile tile = {};
+        while (frame.scheduler.next(tile, group)) {
+            auto tileStart = std::chrono::steady_clock::now();
+            PartialProcessor(tileSceneInfo(frame.info, tile), 0).process();
+            frame.scheduler.finish(tile, std::chrono::steady_clock::now() - tileStart);
+            frame.image->markWritten(tile.widthRange.first, tile.heightRange.first, tile.width(), tile.height());
+        }
+        // Nobody can take a tile of it any more, the last worker out sees all pixels written.
+        if (frame.busy.fetch_sub(1) == 1 && !frame.finished.exchange(true)) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_finishedFrames.push_back(&frame);
+            m_frameFinished.notify_one();
+            m_frameRendered.notify_all();
+        }
+
+        // Another worker may have moved on already, then index is updated to its frame.
+        if (m_current.compare_exchange_strong(index, index + 1)) {
+            ++index;
+        }
+    }
+}
+
+void BatchRenderer::startFrame(Frame& frame, size_t index) {
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_frameWritten.wait(lock, [this] { return m_pendingCount < MaxPendingFrames; });
+        ++m_pendingCount;
+    }
+    frame.image = std::make_unique<ExporterManager>();
+    frame.image->startWrite(frame.job.width, frame.job.height, ExporterManager::isHdr(frame.job.fileType));
+    frame.image->setTonemap(frame.job.tonemap);
+    // Workers encode PNG strips as they complete them, the writer thread only stitches.
+    if (frame.job.fileType == ExporterManager::PNG) {
+        frame.image->streamPng();
+    }
+    frame.info.output = frame.image.get();
+
+    if (m_temporal) {
+        // The previous frame is rendered, and the one before it, which used this buffer, long since.
+        int width = frame.job.width, height = frame.job.height;
+        auto& output = m_reservoirs[index % 2];
+        if (output == nullptr || output->width() != width || output->height() != height) {
+            output = std::make_shared<ReservoirBuffer>(width, height);
+        }
+        frame.info.reservoirOutput = output;
+
+        const auto& history = m_reservoirs[(index + 1) % 2];
+        if (index > 0 && history != nullptr && history->width() == width && history->height() == height) {
+            frame.info.reservoirHistory = history;
+            frame.info.previousCamera = m_frames[index - 1]->info.camera;
+        }
+    }
+}
+
+void BatchRenderer::writeFrames() {
+    for (size_t written = 0; written < m_frames.size(); ++written) {
+        Frame* frame = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_frameFinished.wait(lock, [this] { return !m_finishedFrames.empty(); });
+            frame = m_finishedFrames.front();
+            m_finishedFrames.pop_front();
+        }
+
+        auto writeStart = std::chrono::steady_clock::now();
+        const auto& output = frame->job.output;
+        if (!frame->image->endWrite(output, frame->job.fileType)) {
+            std::cout << "Failed to write " << output << '\n';
+            ++m_result.failedCount;
+        }
+        frame->image.reset();
+        m_result.writeSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - writeStart).count();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        --m_pendingCount;
+        m_frameWritten.notify_all();
+    }
+}
@@ -0,0 +1,100 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#ifndef BATCH_RENDERER_H
+#define BATCH_RENDERER_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+#include "Concurrency/PartialProcessor.h"
+#include "Concurrency/RenderProgress.h"
+#include "Concurrency/ThreadPool.h"
+#include "Concurrency/TileScheduler.h"
+#include "Exporter/ExporterManager.h"
+#include "RayTracer/BatchJob.h"
+
+#include "RayTracer/RayTracer.h"
+
+struct BatchResult {
+    size_t frameCount = 0;
+    size_t failedCount = 0;
+    double seconds = 0.0;
+    // Spent by the writer thread, overlapped with rendering.
+    double writeSeconds = 0.0;
+};
+
+/*
+ * Renders a list of frames of one resident scene without a barrier between them: a worker that finds
+ * no tile left in the current frame moves on to the next one while the others finish the tail, and the
+ * last worker out of a frame hands it to a writer thread, so encoding overlaps the following frames.
+ * With ReSTIR a frame reuses the reservoirs of the one before, so it only starts once that one is
+ * rendered; writing still overlaps.
+ */
+class BatchRenderer {
+public:
+    // Frames with an image buffer that is not written yet. Workers wait before starting another one,
+    // which bounds the memory when encoding is slower than rendering.
+    constexpr static size_t MaxPendingFrames = 3;
+
+    BatchRenderer(ThreadPool& pool, const PartialSceneInfo& sceneInfo, int tileSize);
+
+    BatchResult render(const std::vector<BatchJob>& jobs, double progressInterval);
+
+private:
+    struct Frame {
+        const BatchJob& job;
+        PartialSceneInfo info;
+        TileScheduler scheduler;
+
+        // Allocated by the first worker to arrive, released once written.
+        std::once_flag started;
+        std::unique_ptr<ExporterManager> image = nullptr;
+
+        // Workers inside the frame, the one leaving it last after the tiles ran out finishes it.
+        std::atomic<int> busy = 0;
+        std::atomic<bool> finished = false;
+
+        Frame(const BatchJob& job, const PartialSceneInfo& sceneInfo, int tileSize, size_t workerCount, int groupCount);
+    };
+
+    // Worker loop over the frames from m_current on.
+    void renderFrames();
+
+    void startFrame(Frame& frame, size_t index);
+
+    void writeFrames();
+
+private:
+    ThreadPool& m_pool;
+
+    PartialSceneInfo m_sceneInfo;
+    int m_tileSize = 32;
+
+    std::vector<std::unique_ptr<Frame>> m_frames = {};
+    std::atomic<size_t> m_current = 0;
+
+    RenderProgress m_progress = {};
+
+    // Frames write their final reservoirs to these in turn and read the other one, the previous frame's.
+    bool m_temporal = false;
+    std::shared_ptr<ReservoirBuffer> m_reservoirs[2] = {};
+
+    std::mutex m_mutex;
+    std::condition_variable m_frameWritten;
+    std::condition_variable m_frameFinished;
+    std::condition_variable m_frameRendered;
+    size_t m_pendingCount = 0;             // Guarded by m_mutex.
+    std::deque<Frame*> m_finishedFrames = {}; // Guarded by m_mutex.
+
+    BatchResult m_result = {};
+};
+
+#endif // BATCH_RENDERER_H
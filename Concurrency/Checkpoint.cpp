@@ -0,0 +1,169 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "Checkpoint.h"
+
+namespace {
+    constexpr char checkpointMagic[8] = { 'R', 'T', 'C', 'H', 'E', 'C', 'K', '2' };
+
+    template<typename T>
+    void writeValue(std::ostream& out, T value) {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template<typename T>
+    T readValue(std::istream& in) {
+        T value = {};
+        in.read(reinterpret_cast<char*>(&value), sizeof(T));
+        return value;
+    }
+
+    // FNV-1a, which unlike std::hash gives the same value in every build.
+    class Fnv1a {
+    public:
+        template<typename T>
+        void add(const T& value) { addBytes(&value, sizeof(T)); }
+
+        void add(const std::string& value) {
+            add<uint64_t>(value.size());
+            addBytes(value.data(), value.size());
+        }
+
+        inline uint64_t value() const { return m_hash; }
+
+    private:
+        void addBytes(const void* data, size_t size) {
+            auto bytes = static_cast<const uint8_t*>(data);
+            for (size_t i = 0; i < size; ++i) {
+                m_hash = (m_hash ^ bytes[i]) * 0x100000001b3ull;
+            }
+        }
+
+        uint64_t m_hash = 0xcbf29ce484222325ull;
+    };
+
+    // Flush the written file to disk, so that renaming it cannot leave an empty or partial file behind.
+    bool syncFile(const std::string& filename) {
+        int fd = ::open(filename.c_str(), O_WRONLY);
+        if (fd < 0) return false;
+        bool synced = ::fsync(fd) == 0;
+        return ::close(fd) == 0 && synced;
+    }
+
+    CheckpointHeader readHeader(std::istream& in, const std::string& filename) {
+        char magic[sizeof(checkpointMagic)] = {};
+        in.read(magic, sizeof(magic));
+        if (!in || std::memcmp(magic, checkpointMagic, sizeof(magic)) != 0) {
+            throw std::runtime_error(filename + " is not a render checkpoint.");
+        }
+
+        CheckpointHeader header = {};
+        header.width = readValue<int32_t>(in);
+        header.height = readValue<int32_t>(in);
+        header.seed = readValue<uint32_t>(in);
+        header.renderHash = readValue<uint64_t>(in);
+        header.state.passCount = readValue<int32_t>(in);
+        header.state.finishedSampleCount = readValue<int32_t>(in);
+        header.state.pendingSampleCount = readValue<int32_t>(in);
+        header.state.seconds = readValue<double>(in);
+        header.state.passSeconds = readValue<double>(in);
+        if (!in) {
+            throw std::runtime_error("Checkpoint " + filename + " is truncated.");
+        }
+        return header;
+    }
+}
+
+bool saveCheckpoint(const std::string& filename, const CheckpointHeader& header, const AccumulationBuffer& accumulation) {
+    std::string temporary = filename + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) return false;
+
+        out.write(checkpointMagic, sizeof(checkpointMagic));
+        writeValue<int32_t>(out, header.width);
+        writeValue<int32_t>(out, header.height);
+        writeValue<uint32_t>(out, header.seed);
+        writeValue<uint64_t>(out, header.renderHash);
+        writeValue<int32_t>(out, header.state.passCount);
+        writeValue<int32_t>(out, header.state.finishedSampleCount);
+        writeValue<int32_t>(out, header.state.pendingSampleCount);
+        writeValue<double>(out, header.state.seconds);
+        writeValue<double>(out, header.state.passSeconds);
+        accumulation.write(out);
+
+        out.close();
+        if (!out || !syncFile(temporary)) {
+            std::remove(temporary.c_str());
+            return false;
+        }
+    }
+    return std::rename(temporary.c_str(), filename.c_str()) == 0;
+}
+
+uint64_t renderHash(const RenderOptions& options, const SceneStatistics& statistics) {
+    Fnv1a hash = {};
+    hash.add(options.aspectRatio);
+    hash.add<int32_t>(options.imageWidth);
+    hash.add<int32_t>(options.maxDepth);
+    hash.add(options.scene);
+    hash.add<int32_t>(options.lightCount);
+    hash.add<uint64_t>(options.generator.sphereCount);
+    hash.add(options.generator.density);
+    for (double weight : options.generator.materialMix) {
+        hash.add(weight);
+    }
+    hash.add<int32_t>(options.generator.clusterCount);
+    hash.add<int32_t>(options.generator.paletteSize);
+    hash.add<uint32_t>(static_cast<uint32_t>(options.directLighting));
+    hash.add<int32_t>(options.restir.candidateCount);
+    hash.add<int32_t>(options.restir.spatialNeighbors);
+    hash.add<int32_t>(options.restir.spatialRadius);
+    hash.add<uint64_t>(statistics.sphereCount);
+    hash.add<uint64_t>(statistics.materialCount);
+    hash.add<uint64_t>(statistics.distinctMaterialCount);
+    return hash.value();
+}
+
+CheckpointHeader readCheckpointHeader(const std::string& filename) {
+    std::ifstream in(filename, std::ios::binary);
+    if (!in.is_open()) {
+        throw std::runtime_error("Cannot open checkpoint " + filename + ".");
+    }
+    return readHeader(in, filename);
+}
+
+CheckpointHeader loadCheckpoint(const std::string& filename, AccumulationBuffer& accumulation, uint64_t hash) {
+    std::ifstream in(filename, std::ios::binary);
+    if (!in.is_open()) {
+        throw std::runtime_error("Cannot open checkpoint " + filename + ".");
+    }
+
+    auto header = readHeader(in, filename);
+    if (header.width != accumulation.width() || header.height != accumulation.height()) {
+        throw std::runtime_error("Checkpoint " + filename + " is " + std::to_string(header.width) + "x" +
+                                 std::to_string(header.height) + ", the render is " +
+                                 std::to_string(accumulation.width()) + "x" + std::to_string(accumulation.height()) + ".");
+    }
+    if (header.renderHash != hash) {
+        throw std::runtime_error("Checkpoint " + filename + " was taken of another render, its scene, depth or "
+                                 "lighting options differ from these.");
+    }
+    if (!accumulation.read(in)) {
+        throw std::runtime_error("Checkpoint " + filename + " is truncated.");
+    }
+    return header;
+}
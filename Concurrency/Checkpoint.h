@@ -0,0 +1,58 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "Concurrency/AccumulationBuffer.h"
+#include "RayTracer/RenderOptions.h"
+#include "Scene/SceneBuilder.h"
+
+#include "RayTracer/RayTracer.h"
+
+// Where a progressive render stands, everything besides the accumulation buffer needed to continue it.
+struct ProgressiveState {
+    int passCount = 0;
+    int finishedSampleCount = 0;
+    double seconds = 0.0;     // Wall-clock time of the render so far.
+    double passSeconds = 0.0; // Time spent inside passes, sizes the passes of the time-budget mode.
+    int pendingSampleCount = 0; // Size of a pass that was cut short, zero between passes.
+};
+
+struct CheckpointHeader {
+    int width = 0, height = 0;
+    // Seeds scene generation and the per-pixel sample streams, so a resumed render matches a straight one.
+    unsigned seed = 0;
+    // See renderHash, a checkpoint only continues the render it was taken of.
+    uint64_t renderHash = 0;
+    ProgressiveState state = {};
+};
+
+// Hash of the options that decide the samples of a render besides seed and sample count, i.e. image,
+// scene, lighting and generator settings, and of the size of the scene they built. Tonemapping and
+// scheduling are left out, they may change between runs of one render.
+uint64_t renderHash(const RenderOptions& options, const SceneStatistics& statistics);
+
+/*
+ * File layout, native byte order: magic "RTCHECK2", width, height and seed as 32-bit integers, the
+ * 64-bit render hash, pass count, finished spp and pending spp as 32-bit integers, both timings as doubles,
+ * then the raw sums, sample counts and squared luminance sums of the accumulation buffer. Written to
+ * filename + ".tmp" first, synced to disk and renamed over filename, so a killed process or a crashed
+ * machine leaves either the previous checkpoint or the new one.
+ */
+bool saveCheckpoint(const std::string& filename, const CheckpointHeader& header, const AccumulationBuffer& accumulation);
+
+// Header only, e.g. to rebuild the scene from the saved seed. Throws std::runtime_error on a bad file.
+CheckpointHeader readCheckpointHeader(const std::string& filename);
+
+// Throws std::runtime_error on a bad file, when the image size differs from accumulation or when the
+// checkpoint was taken of a render of another hash, see renderHash.
+CheckpointHeader loadCheckpoint(const std::string& filename, AccumulationBuffer& accumulation, uint64_t hash);
+
+#endif // CHECKPOINT_H
@@ -0,0 +1,90 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#include <thread>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#ifdef RAYTRACER_HAVE_NUMA
+#include <numa.h>
+#endif
+
+#include "CpuTopology.h"
+
+CpuTopology CpuTopology::detect(int emulatedNodeCount) {
+    CpuTopology topology = {};
+
+#ifdef __linux__
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    if (sched_getaffinity(0, sizeof(mask), &mask) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &mask)) topology.cpus.push_back(cpu);
+        }
+    }
+#endif
+    if (topology.cpus.empty()) {
+        for (int cpu = 0; cpu < static_cast<int>(std::max(1u, std::thread::hardware_concurrency())); ++cpu) {
+            topology.cpus.push_back(cpu);
+        }
+    }
+    topology.nodes.assign(topology.cpus.size(), 0);
+
+    if (emulatedNodeCount > 0) {
+        // Contiguous blocks, like sockets usually are numbered.
+        topology.nodeCount = std::min(emulatedNodeCount, static_cast<int>(topology.cpus.size()));
+        for (size_t i = 0; i < topology.cpus.size(); ++i) {
+            topology.nodes[i] = static_cast<int>(i * topology.nodeCount / topology.cpus.size());
+        }
+        return topology;
+    }
+
+#ifdef RAYTRACER_HAVE_NUMA
+    if (numa_available() >= 0) {
+        topology.nodeCount = numa_max_node() + 1;
+        for (size_t i = 0; i < topology.cpus.size(); ++i) {
+            topology.nodes[i] = std::max(0, numa_node_of_cpu(topology.cpus[i]));
+        }
+
+        std::vector<size_t> order(topology.cpus.size());
+        for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return topology.nodes[a] < topology.nodes[b];
+        });
+        CpuTopology sorted = topology;
+        for (size_t i = 0; i < order.size(); ++i) {
+            sorted.cpus[i] = topology.cpus[order[i]];
+            sorted.nodes[i] = topology.nodes[order[i]];
+        }
+        return sorted;
+    }
+#endif
+    return topology;
+}
+
+bool pinCurrentThread(int cpu) {
+#ifdef __linux__
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    CPU_SET(cpu, &mask);
+    return sched_setaffinity(0, sizeof(mask), &mask) == 0;
+#else
+    return false;
+#endif
+}
+
+void preferLocalMemory() {
+#ifdef RAYTRACER_HAVE_NUMA
+    if (numa_available() >= 0) {
+        numa_set_localalloc();
+    }
+#endif
+}
@@ -0,0 +1,32 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#ifndef CPU_TOPOLOGY_H
+#define CPU_TOPOLOGY_H
+
+#include "RayTracer/RayTracer.h"
+
+// CPUs the process may run on, ordered by NUMA node.
+struct CpuTopology {
+    std::vector<int> cpus = {};
+    std::vector<int> nodes = {}; // Node of cpus[i].
+    int nodeCount = 1;
+
+    // Reads the affinity mask and, with libnuma, the node of every CPU. Falls back to one node holding
+    // all hardware threads. emulatedNodeCount > 0 deals the CPUs into that many fake nodes instead.
+    static CpuTopology detect(int emulatedNodeCount = 0);
+};
+
+// Pin the calling thread to one CPU, false where unsupported or refused.
+bool pinCurrentThread(int cpu);
+
+// Let later allocations of the calling thread land on the node it runs on.
+void preferLocalMemory();
+
+#endif // CPU_TOPOLOGY_H
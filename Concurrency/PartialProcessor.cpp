@@ -9,47 +9,252 @@
 
 #include "PartialProcessor.h"
 
+#include "Material/Material.h"
 #include "RayTracer/RayColor.h"
 
+namespace {
+    // SplitMix64 finalizer, spreads nearby inputs over the whole range.
+    inline uint64_t mixBits(uint64_t value) {
+        value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+        value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+        return value ^ (value >> 31);
+    }
+
+    unsigned pixelSeed(unsigned seed, int sampleOffset, int i, int j) {
+        uint64_t key = mixBits(seed + mixBits(static_cast<uint64_t>(sampleOffset) + mixBits(
+            (static_cast<uint64_t>(static_cast<uint32_t>(j)) << 32) | static_cast<uint32_t>(i))));
+        return static_cast<unsigned>(key >> 32);
+    }
+}
+
 void PartialProcessor::process() {
     auto& info = m_sceneInfo;
-    for (int j = info.heightRange.first; j <= info.heightRange.second; ++j) {
-        for (int i = info.widthRange.first; i <= info.widthRange.second; ++i) {
-            Vector3d color = Vector3d::zero();
-            // Sample near points randomly.
-            for (int s = 0; s < info.sampleCount; ++s) {
-                auto u = (double(i) + randomReal()) / static_cast<double>(info.fullSize.first - 1);
-                // Flip y-axis to make view-coord matches with NDC-coord.
-                auto v = (double(info.fullSize.second - 1 - j) + randomReal()) / static_cast<double>(info.fullSize.second - 1);
-                auto r = info.camera->getRay(u, v);
-                color += rayColor(r, info.shapeList, info.maxDepth, true);
-            }
-            // Flip y-axis to make view-coord matches with NDC-coord.
-            writeColor(i - info.widthRange.first, j - info.heightRange.first, color / info.sampleCount, true);
-        }
+    // Tiles for the chunk writer and for the final image are staged as linear RGB and handed over whole,
+    // in a buffer that every thread reuses for all of its tiles.
+    thread_local std::vector<float> staging = {};
+    if (info.tiles != nullptr || info.accumulation == nullptr) {
+        staging.assign(3 * m_partialWidth * m_partialHeight, 0.0f);
+        m_staging = staging.data();
     }
+
+    if (info.directLighting == DirectLightingMode::ReSTIR && info.lights != nullptr && !info.lights->empty()) {
+        processReSTIR();
+    }
+    else {
+        processPaths();
+    }
+
+    if (info.tiles != nullptr) {
+        info.tiles->writeChunk(info.widthRange.first, info.heightRange.first, m_partialWidth, m_partialHeight,
+                               m_staging);
+    }
+    else if (m_staging != nullptr) {
+        writeStaged();
+    }
+}
+
+void PartialProcessor::processPaths() {
+    auto& info = m_sceneInfo;
+    // Morton order keeps neighboring pixels, which mostly hit the same shapes, close in time.
+    bool stopped = false;
+    forEachMorton(m_partialWidth, m_partialHeight, [&](int x, int y) {
+        if (stopped || (stopped = cancelled())) return;
+
+        int i = x + info.widthRange.first;
+        int j = y + info.heightRange.first;
+        // Done before the checkpoint that this pass was resumed from.
+        if (info.accumulation != nullptr &&
+            info.accumulation->sampleCount(i, j) >= static_cast<uint32_t>(info.sampleOffset + info.sampleCount)) {
+            return;
+        }
+
+        defaultRandomEngine.seed(pixelSeed(info.seed, info.sampleOffset, i, j));
+        Vector3d color = Vector3d::zero();
+        double luminanceSquare = 0.0;
+        // Sample near points randomly.
+        for (int s = 0; s < info.sampleCount; ++s) {
+            auto sample = rayColor(primaryRay(i, j), info.shapeList, info.lights.get(), info.maxDepth, true);
+            color += sample;
+            luminanceSquare += luminance(sample) * luminance(sample);
+        }
+        storeColor(x, y, color, luminanceSquare, info.sampleCount);
+        if (info.progress != nullptr) {
+            info.progress->addSamples(info.sampleCount);
+        }
+    });
 }
 
-void PartialProcessor::writeToFullImage(std::vector<Vector3i>& fullImage) const {
+void PartialProcessor::processReSTIR() {
     auto& info = m_sceneInfo;
-    for (int i = 0; i < m_partialWidth; ++i) {
-        for (int j = 0; j < m_partialHeight; ++j) {
-            fullImage[info.widthRange.first + i + (info.heightRange.first + j) * info.fullSize.first]
-                = m_partialImage[i + j * m_partialWidth];
+    auto& lights = *info.lights;
+    const auto& settings = info.restir;
+
+    size_t pixelCount = m_partialWidth * m_partialHeight;
+    m_shadingPoints.assign(pixelCount, {});
+    m_reservoirs.assign(pixelCount, {});
+    std::vector<Reservoir> reused(pixelCount);
+    std::vector<Vector3d> colors(pixelCount, Vector3d::zero());
+    std::vector<double> luminanceSquares(pixelCount, 0.0);
+
+    auto forEachPixel = [&](const std::function<void(int, int, size_t)>& func) {
+        forEachMorton(m_partialWidth, m_partialHeight, [&](int x, int y) { func(x, y, x + y * m_partialWidth); });
+    };
+
+    int finishedCount = 0;
+    for (; finishedCount < info.sampleCount && !cancelled(); ++finishedCount) {
+        // Trace camera rays, then draw and validate the initial candidates of every pixel.
+        forEachPixel([&](int x, int y, size_t index) {
+            auto& point = m_shadingPoints[index];
+            point = {};
+            point.ray = primaryRay(x + info.widthRange.first, y + info.heightRange.first);
+            point.valid = closestHit(point.ray, info.shapeList, true, point.hit);
+            point.diffuse = point.valid && point.hit.material->diffuseAlbedo(point.albedo);
+
+            auto& reservoir = m_reservoirs[index];
+            reservoir = initialReservoir(point, lights, settings.candidateCount);
+            validateReservoir(reservoir, point, info.shapeList);
+
+            Reservoir history = {};
+            if (reprojectHistory(point, history)) {
+                history.M = std::min(history.M, static_cast<double>(settings.temporalMaxM * settings.candidateCount));
+
+                Reservoir merged = {};
+                combineReservoir(merged, reservoir, point, lights, randomReal());
+                combineReservoir(merged, history, point, lights, randomReal());
+                merged.finalize();
+                reservoir = merged;
+            }
+        });
+
+        // Spatial reuse from random neighbors inside the tile.
+        forEachPixel([&](int x, int y, size_t index) {
+            const auto& point = m_shadingPoints[index];
+            if (!point.diffuse) {
+                reused[index] = m_reservoirs[index];
+                return;
+            }
+
+            Reservoir merged = {};
+            combineReservoir(merged, m_reservoirs[index], point, lights, randomReal());
+            for (int k = 0; k < settings.spatialNeighbors; ++k) {
+                Vector3d offset = settings.spatialRadius * randomUnitDisk();
+                int nx = std::clamp(x + static_cast<int>(std::round(offset.x())), 0, m_partialWidth - 1);
+                int ny = std::clamp(y + static_cast<int>(std::round(offset.y())), 0, m_partialHeight - 1);
+                size_t neighbor = nx + ny * m_partialWidth;
+                if (neighbor == index || !similarSurface(point, m_shadingPoints[neighbor])) continue;
+
+                combineReservoir(merged, m_reservoirs[neighbor], point, lights, randomReal());
+            }
+            merged.finalize();
+            reused[index] = merged;
+        });
+
+        // Shade the primary hits with the resampled light and continue the path for indirect light.
+        forEachPixel([&](int, int, size_t index) {
+            const auto& point = m_shadingPoints[index];
+            if (!point.valid) {
+                colors[index] += skyColor(point.ray);
+                return;
+            }
+
+            Vector3d color = point.hit.material->emitted();
+            if (point.diffuse) {
+                color += shadeReservoir(reused[index], point, info.shapeList, lights);
+            }
+            Ray rayScattered = {};
+            Vector3d attenuation = {};
+            if (point.hit.material->scatter(point.ray, point.hit, attenuation, rayScattered)) {
+                color += attenuation * rayColor(rayScattered, info.shapeList, &lights,
+                                                info.maxDepth - 1, true, !point.diffuse);
+            }
+            colors[index] += color;
+            luminanceSquares[index] += luminance(color) * luminance(color);
+        });
+
+        std::swap(m_reservoirs, reused);
+        if (info.progress != nullptr) {
+            info.progress->addSamples(pixelCount);
         }
     }
+    if (finishedCount == 0) return;
+
+    forEachPixel([&](int x, int y, size_t index) {
+        if (info.reservoirOutput != nullptr) {
+            const auto& point = m_shadingPoints[index];
+            auto& entry = info.reservoirOutput->at(x + info.widthRange.first, y + info.heightRange.first);
+            entry.reservoir = m_reservoirs[index];
+            entry.normal = point.hit.normal;
+            entry.depth = point.diffuse ? (point.hit.position - info.camera->position()).length() : 0.0;
+        }
+        storeColor(x, y, colors[index], luminanceSquares[index], finishedCount);
+    });
+}
+
+bool PartialProcessor::reprojectHistory(const ShadingPoint& point, Reservoir& reservoir) const {
+    auto& info = m_sceneInfo;
+    if (info.reservoirHistory == nullptr || info.previousCamera == nullptr || !point.diffuse) return false;
+
+    // Inverse of the pixel mapping of primaryRay.
+    double s = 0.0, t = 0.0;
+    if (!info.previousCamera->project(point.hit.position, s, t)) return false;
+    double i = std::floor(s * (info.fullSize.first - 1));
+    double j = info.fullSize.second - 1 - std::floor(t * (info.fullSize.second - 1));
+    if (i < 0.0 || i >= info.fullSize.first || j < 0.0 || j >= info.fullSize.second) return false;
+
+    const auto& history = info.reservoirHistory->at(static_cast<int>(i), static_cast<int>(j));
+    double depth = (point.hit.position - info.previousCamera->position()).length();
+    if (!sameSurface(point, depth, history)) return false;
+
+    reservoir = history.reservoir;
+    return true;
+}
+
+Ray PartialProcessor::primaryRay(int i, int j) const {
+    auto& info = m_sceneInfo;
+    auto u = (double(i) + randomReal()) / static_cast<double>(info.fullSize.first - 1);
+    // Flip y-axis to make view-coord matches with NDC-coord.
+    auto v = (double(info.fullSize.second - 1 - j) + randomReal()) / static_cast<double>(info.fullSize.second - 1);
+    return info.camera->getRay(u, v);
 }
 
-void PartialProcessor::writeColor(int partialX, int partialY, Vector3i color) {
-    m_partialImage[partialX + partialY * m_partialWidth] = color;
+void PartialProcessor::storeColor(int partialX, int partialY, const Vector3d& colorSum, double luminanceSquareSum,
+                                  int sampleCount) {
+    auto& info = m_sceneInfo;
+    if (m_staging != nullptr) {
+        Vector3d color = colorSum / static_cast<double>(sampleCount);
+        float* rgb = m_staging + 3 * (partialX + partialY * m_partialWidth);
+        rgb[0] = static_cast<float>(color.r());
+        rgb[1] = static_cast<float>(color.g());
+        rgb[2] = static_cast<float>(color.b());
+        ++m_stagedCount;
+    }
+    else {
+        info.accumulation->add(partialX + info.widthRange.first, partialY + info.heightRange.first,
+                               colorSum, luminanceSquareSum, sampleCount);
+    }
 }
 
-void PartialProcessor::writeColor(int partialX, int partialY, Vector3d color, bool gammaCorrection) {
-    if (gammaCorrection) {
-        color = { sqrt(color.r()), sqrt(color.g()), sqrt(color.b()) }; // Simple gamma2 correction
+void PartialProcessor::writeStaged() {
+    auto& info = m_sceneInfo;
+    int x = info.widthRange.first, y = info.heightRange.first;
+    if (m_stagedCount == static_cast<size_t>(m_partialWidth) * m_partialHeight) {
+        // Tonemapped row by row into the framebuffer or mapped file.
+        info.output->writeTile(x, y, m_partialWidth, m_partialHeight, m_staging);
+        return;
     }
-    color *= 254.999;
-    Vector3i rgb = { static_cast<int>(color.r()), static_cast<int>(color.g()), static_cast<int>(color.b()) };
-    writeColor(partialX, partialY, rgb);
+
+    // Stopped early, pixels are finished in Morton order up to there and the rest stays untouched.
+    size_t left = m_stagedCount;
+    forEachMorton(m_partialWidth, m_partialHeight, [&](int i, int j) {
+        if (left == 0) return;
+        --left;
+        info.output->writeTile(x + i, y + j, 1, 1, m_staging + 3 * (i + j * m_partialWidth));
+    });
 }
 
+PartialSceneInfo tileSceneInfo(const PartialSceneInfo& sceneInfo, const Tile& tile) {
+    PartialSceneInfo info = sceneInfo;
+    info.widthRange = tile.widthRange;
+    info.heightRange = tile.heightRange;
+    return info;
+}
@@ -10,9 +10,16 @@
 #ifndef PARTIAL_PROCESSOR_H
 #define PARTIAL_PROCESSOR_H
 
+#include <atomic>
 #include <utility>
 
 #include "Camera/Camera.h"
+#include "Concurrency/AccumulationBuffer.h"
+#include "Concurrency/RenderProgress.h"
+#include "Concurrency/TileScheduler.h"
+#include "Exporter/TiledImage.h"
+#include "Light/LightBVH.h"
+#include "Light/ReSTIR.h"
 #include "Shape/Shape.h"
 
 #include "RayTracer/RayTracer.h"
@@ -23,8 +30,34 @@ struct PartialSceneInfo {
     std::pair<int, int> heightRange = {};
     std::shared_ptr<Camera> camera = nullptr;
     const std::vector<std::shared_ptr<Shape>>& shapeList;
+    std::shared_ptr<LightBVH> lights = nullptr;
     int maxDepth = 0;
     int sampleCount = 0;
+    // Samples of pixel (i, j) come from a random stream seeded by seed, sampleOffset (the samples it
+    // already has) and the pixel, so images do not depend on the thread count or the tile order, and a
+    // resumed render continues exactly where it stopped. The ReSTIR mode uses the worker streams.
+    unsigned seed = 0;
+    int sampleOffset = 0;
+
+    DirectLightingMode directLighting = DirectLightingMode::NextEvent;
+    ReSTIRSettings restir = {};
+    // Reservoirs of the previous frame, seen through previousCamera, enable temporal reuse when set. The
+    // final reservoirs of this frame go to reservoirOutput for the next one when that is set.
+    std::shared_ptr<const ReservoirBuffer> reservoirHistory = nullptr;
+    std::shared_ptr<Camera> previousCamera = nullptr;
+    std::shared_ptr<ReservoirBuffer> reservoirOutput = nullptr;
+
+    // Finished pixels are written straight into the final image, or added into a shared full-frame
+    // float buffer instead when accumulation is set, or the finished tile goes to tiles as one chunk
+    // when that is set, without any full-frame image.
+    ExporterManager* output = nullptr;
+    std::shared_ptr<AccumulationBuffer> accumulation = nullptr;
+    TiledImageWriter* tiles = nullptr;
+    // Checked between pixels, the samples finished so far are kept when it turns true or time is up.
+    const std::atomic<bool>* cancel = nullptr;
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    // Receives the finished camera samples when set.
+    RenderProgress* progress = nullptr;
 
     explicit PartialSceneInfo(const std::vector<std::shared_ptr<Shape>>& shapes) : shapeList(shapes) {}
 };
@@ -34,17 +67,37 @@ public:
     PartialProcessor(const PartialSceneInfo& sceneInfo, int ID) : m_sceneInfo(sceneInfo), m_ID(ID) {
         m_partialWidth = sceneInfo.widthRange.second - sceneInfo.widthRange.first + 1;
         m_partialHeight = sceneInfo.heightRange.second - sceneInfo.heightRange.first + 1;
-        m_partialImage.resize(m_partialWidth * m_partialHeight);
     }
 
     void process();
 
-    void writeToFullImage(std::vector<Vector3i>& fullImage) const;
+    inline const PartialSceneInfo& sceneInfo() const { return m_sceneInfo; }
 
 private:
-    void writeColor(int partialX, int partialY, Vector3i color);
+    // Camera ray through a random point of pixel (i, j) of the full image.
+    Ray primaryRay(int i, int j) const;
 
-    void writeColor(int partialX, int partialY, Vector3d color, bool gammaCorrection = true);
+    // Samples of one pixel after another.
+    void processPaths();
+
+    // Per-sample passes over the whole tile: G-buffer, candidates and temporal reuse, spatial reuse, shading.
+    void processReSTIR();
+
+    // History reservoir of the pixel the point was seen in by the previous camera, false when it is off
+    // screen or that pixel showed another surface.
+    bool reprojectHistory(const ShadingPoint& point, Reservoir& reservoir) const;
+
+    inline bool cancelled() const {
+        return (m_sceneInfo.cancel != nullptr && m_sceneInfo.cancel->load(std::memory_order_relaxed)) ||
+               std::chrono::steady_clock::now() >= m_sceneInfo.deadline;
+    }
+
+    // Hand sampleCount summed samples of a pixel to the accumulation buffer, or stage it for the tile
+    // writer or the output image.
+    void storeColor(int partialX, int partialY, const Vector3d& colorSum, double luminanceSquareSum, int sampleCount);
+
+    // Write the staged pixels into the output image.
+    void writeStaged();
 
 private:
     PartialSceneInfo m_sceneInfo;
@@ -54,7 +107,15 @@ private:
     int m_partialWidth = 0;
     int m_partialHeight = 0;
 
-    std::vector<Vector3i> m_partialImage = {};
+    // Tile-local buffers of the ReSTIR mode, indexed like the partial image.
+    std::vector<ShadingPoint> m_shadingPoints = {};
+    std::vector<Reservoir> m_reservoirs = {};
+    // Linear RGB of the tile when it is not accumulated, in a buffer owned by the thread.
+    float* m_staging = nullptr;
+    size_t m_stagedCount = 0;
 };
 
+// Copy of the full scene info restricted to the pixels of tile.
+PartialSceneInfo tileSceneInfo(const PartialSceneInfo& sceneInfo, const Tile& tile);
+
 #endif // PARTIAL_PROCESSOR_H
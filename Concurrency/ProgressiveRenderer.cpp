@@ -0,0 +1,187 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#include "ProgressiveRenderer.h"
+
+ProgressiveRenderer::ProgressiveRenderer(ThreadPool& pool, const PartialSceneInfo& sceneInfo, int tileSize)
+    : m_pool(pool), m_sceneInfo(sceneInfo), m_tileSize(tileSize) {
+    m_accumulation = std::make_shared<AccumulationBuffer>(sceneInfo.fullSize.first, sceneInfo.fullSize.second);
+    m_sceneInfo.accumulation = m_accumulation;
+    m_sceneInfo.progress = &m_progress;
+}
+
+ProgressiveRenderer::~ProgressiveRenderer() {
+    // In case that a preview is still being written.
+    if (m_preview.valid()) {
+        m_preview.wait();
+    }
+}
+
+void ProgressiveRenderer::resume(const std::string& filename, uint64_t renderHash) {
+    auto header = loadCheckpoint(filename, *m_accumulation, renderHash);
+    m_state = header.state;
+}
+
+ProgressiveResult ProgressiveRenderer::render(const ProgressiveSettings& settings) {
+    using Clock = std::chrono::steady_clock;
+
+    // A resumed render keeps the clock of the interrupted one running.
+    auto start = Clock::now() - std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(m_state.seconds));
+    auto deadline = Clock::time_point::max();
+    if (settings.timeBudget > 0.0) {
+        deadline = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(settings.timeBudget));
+    }
+    // Passes are sized to end before the deadline, cutting the last one short is only a safety net.
+    m_sceneInfo.deadline = deadline;
+
+    ProgressiveResult result = {};
+    if (m_state.finishedSampleCount > 0) {
+        result.estimatedError = m_accumulation->estimatedRelativeError();
+    }
+    auto lastCheckpoint = Clock::now();
+    auto& finishedSampleCount = m_state.finishedSampleCount;
+    while (finishedSampleCount < settings.totalSampleCount && !cancelled()) {
+        int sampleCount = std::min(settings.passSampleCount, settings.totalSampleCount - finishedSampleCount);
+
+        if (m_state.pendingSampleCount > 0) {
+            sampleCount = m_state.pendingSampleCount; // Finish the pass the checkpoint was taken in first.
+        }
+        else if (settings.timeBudget > 0.0) {
+            if (finishedSampleCount == 0) {
+                sampleCount = 1; // Measure the cost of one sample per pixel first.
+            }
+            else {
+                double secondsPerSample = m_state.passSeconds / finishedSampleCount;
+                double remaining = std::chrono::duration<double>(deadline - Clock::now()).count();
+                int affordable = static_cast<int>(remaining / secondsPerSample);
+                if (affordable < 1) break;
+                sampleCount = std::min(sampleCount, affordable);
+            }
+        }
+        if (settings.noiseTarget > 0.0 && m_state.pendingSampleCount == 0) {
+            if (finishedSampleCount == 0) {
+                sampleCount = std::max(sampleCount, std::min(2, settings.totalSampleCount)); // Variance needs two.
+            }
+            else {
+                // Error shrinks as 1 / sqrt(spp), do not render many more samples than the target needs.
+                double ratio = result.estimatedError / settings.noiseTarget;
+                int needed = static_cast<int>(std::ceil(finishedSampleCount * ratio * ratio)) - finishedSampleCount;
+                sampleCount = std::clamp(needed, 1, sampleCount);
+            }
+        }
+
+        auto passStart = Clock::now();
+        m_state.pendingSampleCount = sampleCount;
+        renderPass(sampleCount, settings.progressInterval);
+        m_state.passSeconds += std::chrono::duration<double>(Clock::now() - passStart).count();
+        // A pass cut short stays pending, its finished pixels are skipped when it is rendered again.
+        if (cancelled() || Clock::now() >= deadline) break;
+
+        m_state.pendingSampleCount = 0;
+        finishedSampleCount += sampleCount;
+        ++m_state.passCount;
+
+        result.estimatedError = m_accumulation->estimatedRelativeError();
+        std::cout << "Finished pass " << m_state.passCount << ", " << finishedSampleCount;
+        if (settings.totalSampleCount < std::numeric_limits<int>::max()) {
+            std::cout << " / " << settings.totalSampleCount;
+        }
+        std::cout << " spp, estimated error " << 100.0 * result.estimatedError << " %" << std::endl;
+
+        if (settings.noiseTarget > 0.0 && result.estimatedError <= settings.noiseTarget) break;
+
+        if (!settings.checkpointFile.empty() &&
+            std::chrono::duration<double>(Clock::now() - lastCheckpoint).count() >= settings.checkpointInterval) {
+            m_state.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            result.checkpointSeconds += writeCheckpoint(settings.checkpointFile, settings.renderHash);
+            lastCheckpoint = Clock::now();
+        }
+
+        if (!settings.previewFile.empty()) {
+            writePreview(settings.previewFile, settings.previewTonemap);
+        }
+    }
+
+    if (m_preview.valid()) {
+        m_preview.wait();
+    }
+
+    m_state.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    // The final state can be resumed with more samples, or after an interruption.
+    if (!settings.checkpointFile.empty()) {
+        result.checkpointSeconds += writeCheckpoint(settings.checkpointFile, settings.renderHash);
+    }
+
+    if (result.estimatedError == infinity || m_state.pendingSampleCount > 0) {
+        result.estimatedError = m_accumulation->estimatedRelativeError();
+    }
+    result.passCount = m_state.passCount;
+    result.averageSampleCount = static_cast<double>(m_accumulation->totalSampleCount()) /
+                                (static_cast<double>(m_accumulation->width()) * m_accumulation->height());
+    result.seconds = m_state.seconds;
+    return result;
+}
+
+double ProgressiveRenderer::writeCheckpoint(const std::string& filename, uint64_t renderHash) {
+    auto start = std::chrono::steady_clock::now();
+
+    CheckpointHeader header = {};
+    header.width = m_accumulation->width();
+    header.height = m_accumulation->height();
+    header.seed = m_sceneInfo.seed;
+    header.renderHash = renderHash;
+    header.state = m_state;
+    if (!saveCheckpoint(filename, header, *m_accumulation)) {
+        std::cout << "Failed to write checkpoint " << filename << std::endl;
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void ProgressiveRenderer::renderPass(int sampleCount, double progressInterval) {
+    m_sceneInfo.sampleOffset = m_state.finishedSampleCount;
+    m_sceneInfo.sampleCount = sampleCount;
+    TileScheduler scheduler(m_accumulation->width(), m_accumulation->height(), m_tileSize, m_pool.size(),
+                            m_pool.groupCount());
+
+    uint64_t pixelCount = static_cast<uint64_t>(m_accumulation->width()) * m_accumulation->height();
+    m_progress.start(pixelCount * sampleCount, m_pool.size());
+    // Tiles only add into the shared accumulation buffer, so their processors are dropped right away.
+    auto tasks = scheduler.dispatch(m_pool, m_progress, [this](const Tile& tile) {
+        PartialProcessor(tileSceneInfo(m_sceneInfo, tile), 0).process();
+    });
+    m_progress.wait(std::cout, progressInterval);
+    for (auto& task : tasks) {
+        task.get();
+    }
+}
+
+void ProgressiveRenderer::writePreview(const std::string& filename, const TonemapSettings& tonemap) {
+    // Never stall rendering for a snapshot, the next pass will write a newer one.
+    if (m_preview.valid() && m_preview.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return;
+    }
+
+    // Copying the sums is all the main thread does, resolving and tonemapping the frame happen on the
+    // pool while the next pass renders. The previous snapshot is done with, its storage is reused.
+    if (m_snapshot == nullptr) {
+        m_snapshot = std::make_shared<AccumulationBuffer>(*m_accumulation);
+    }
+    else {
+        *m_snapshot = *m_accumulation;
+    }
+
+    m_preview = m_pool.submit([snapshot = m_snapshot, filename, tonemap] {
+        auto type = ExporterManager::fileTypeOf(filename);
+        ExporterManager em = {};
+        em.startWrite(snapshot->width(), snapshot->height(), ExporterManager::isHdr(type));
+        em.setTonemap(tonemap);
+        snapshot->resolve(em);
+        em.endWrite(filename, type);
+    });
+}
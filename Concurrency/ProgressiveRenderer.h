@@ -0,0 +1,99 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#ifndef PROGRESSIVE_RENDERER_H
+#define PROGRESSIVE_RENDERER_H
+
+#include <future>
+
+#include "Concurrency/AccumulationBuffer.h"
+#include "Concurrency/Checkpoint.h"
+#include "Concurrency/PartialProcessor.h"
+#include "Concurrency/RenderProgress.h"
+#include "Concurrency/ThreadPool.h"
+#include "Concurrency/TileScheduler.h"
+#include "Exporter/ExporterManager.h"
+
+#include "RayTracer/RayTracer.h"
+
+struct ProgressiveSettings {
+    int totalSampleCount = 0;
+    // Upper bound of a pass, the budget and noise modes shrink passes to land on their goal.
+    int passSampleCount = 4;
+    // Wall-clock seconds for all passes, zero for no limit.
+    double timeBudget = 0.0;
+    // Stop once the estimated relative error of the image is below it, zero for no target.
+    double noiseTarget = 0.0;
+    // Snapshot written after every pass when not empty, skipped while the previous one is still writing.
+    std::string previewFile = {};
+    TonemapSettings previewTonemap = {};
+    // Seconds between progress reports within a pass, zero for none.
+    double progressInterval = 1.0;
+    // Written after a pass once checkpointInterval seconds have passed since the last one, and when
+    // the render ends for any reason. Not written when empty.
+    std::string checkpointFile = {};
+    double checkpointInterval = 300.0;
+    // Stored in the checkpoints, see renderHash.
+    uint64_t renderHash = 0;
+};
+
+struct ProgressiveResult {
+    int passCount = 0;
+    double averageSampleCount = 0.0;
+    double estimatedError = infinity;
+    double seconds = 0.0;
+    double checkpointSeconds = 0.0;
+};
+
+/*
+ * Renders the whole frame in passes of a few samples per pixel into a float accumulation buffer,
+ * so that the image is valid whenever the sceneInfo.cancel flag stops the render.
+ */
+class ProgressiveRenderer {
+public:
+    ProgressiveRenderer(ThreadPool& pool, const PartialSceneInfo& sceneInfo, int tileSize);
+
+    ~ProgressiveRenderer();
+
+    // Continue from a checkpoint of the same size and render hash, throws std::runtime_error if it does not fit.
+    void resume(const std::string& filename, uint64_t renderHash);
+
+    // The last pass may be partial if cancelled or out of time.
+    ProgressiveResult render(const ProgressiveSettings& settings);
+
+    inline const AccumulationBuffer& accumulation() const { return *m_accumulation; }
+
+private:
+    void renderPass(int sampleCount, double progressInterval);
+
+    void writePreview(const std::string& filename, const TonemapSettings& tonemap);
+
+    // Returns the seconds spent.
+    double writeCheckpoint(const std::string& filename, uint64_t renderHash);
+
+    inline bool cancelled() const { return m_sceneInfo.cancel != nullptr && m_sceneInfo.cancel->load(); }
+
+private:
+    ThreadPool& m_pool;
+
+    PartialSceneInfo m_sceneInfo;
+
+    std::shared_ptr<AccumulationBuffer> m_accumulation = nullptr;
+    ProgressiveState m_state = {};
+
+    RenderProgress m_progress = {};
+
+    int m_tileSize = 32;
+
+    std::future<void> m_preview = {};
+    // Copy of the accumulation buffer the pending preview is written from.
+    std::shared_ptr<AccumulationBuffer> m_snapshot = nullptr;
+};
+
+#endif // PROGRESSIVE_RENDERER_H
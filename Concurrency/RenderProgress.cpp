@@ -0,0 +1,60 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#include <iomanip>
+
+#include "RenderProgress.h"
+
+void RenderProgress::start(uint64_t sampleCount, size_t taskCount) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_totalSamples = sampleCount;
+    m_finishedSamples = 0;
+    m_pendingTasks = taskCount;
+    m_start = std::chrono::steady_clock::now();
+}
+
+void RenderProgress::finishTask() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        --m_pendingTasks;
+    }
+    m_taskFinished.notify_all();
+}
+
+void RenderProgress::wait(std::ostream& out, double interval) {
+    using Clock = std::chrono::steady_clock;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto done = [this] { return m_pendingTasks == 0; };
+    if (interval <= 0.0) {
+        m_taskFinished.wait(lock, done);
+        return;
+    }
+
+    auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(interval));
+    auto nextReport = m_start + period;
+    while (!m_taskFinished.wait_until(lock, nextReport, done)) {
+        nextReport += period;
+
+        double seconds = std::chrono::duration<double>(Clock::now() - m_start).count();
+        auto finished = static_cast<double>(finishedSamples());
+        double fraction = m_totalSamples > 0 ? finished / static_cast<double>(m_totalSamples) : 0.0;
+        double samplesPerSecond = finished / seconds;
+
+        out << "Progress " << std::fixed << std::setprecision(1) << 100.0 * fraction << " %, "
+            << std::setprecision(2) << samplesPerSecond * 1e-6 << " Msamples/s, ETA ";
+        if (samplesPerSecond > 0.0) {
+            out << std::setprecision(0) << (static_cast<double>(m_totalSamples) - finished) / samplesPerSecond << " s";
+        }
+        else {
+            out << "unknown";
+        }
+        out << std::defaultfloat << std::setprecision(6) << std::endl;
+    }
+}
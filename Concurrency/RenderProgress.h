@@ -0,0 +1,64 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#ifndef RENDER_PROGRESS_H
+#define RENDER_PROGRESS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+#include "RayTracer/RayTracer.h"
+
+/*
+ * Completed work of a batch of render tasks. Workers add finished camera samples to a relaxed atomic
+ * counter and only touch the lock when a whole task is done; the waiting thread sleeps in between and
+ * wakes on task completion or when the next report is due.
+ */
+class RenderProgress {
+public:
+    // Reset the counters for a batch of taskCount tasks rendering sampleCount camera samples in total.
+    void start(uint64_t sampleCount, size_t taskCount);
+
+    inline void addSamples(uint64_t count) { m_finishedSamples.fetch_add(count, std::memory_order_relaxed); }
+
+    void finishTask();
+
+    // Finishes a task when it goes out of scope, so that wait also returns after a task threw. The
+    // exception stays with the future of the task.
+    class TaskScope {
+    public:
+        explicit TaskScope(RenderProgress& progress) : m_progress(progress) {}
+        ~TaskScope() { m_progress.finishTask(); }
+
+        TaskScope(const TaskScope&) = delete;
+        TaskScope& operator=(const TaskScope&) = delete;
+
+    private:
+        RenderProgress& m_progress;
+    };
+
+    // Block until every task is finished, printing progress, throughput and ETA every interval seconds.
+    // A zero interval waits silently.
+    void wait(std::ostream& out, double interval);
+
+    inline uint64_t finishedSamples() const { return m_finishedSamples.load(std::memory_order_relaxed); }
+
+private:
+    uint64_t m_totalSamples = 0;
+    std::atomic<uint64_t> m_finishedSamples = 0;
+
+    std::mutex m_mutex;
+    std::condition_variable m_taskFinished;
+    size_t m_pendingTasks = 0; // Guarded by m_mutex.
+
+    std::chrono::steady_clock::time_point m_start = {};
+};
+
+#endif // RENDER_PROGRESS_H
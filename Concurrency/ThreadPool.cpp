@@ -0,0 +1,150 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#include "ThreadPool.h"
+
+namespace {
+    thread_local int currentWorkerIndex = -1;
+    thread_local const ThreadPool* currentWorkerPool = nullptr;
+}
+
+ThreadPool::ThreadPool(size_t threadCount, const std::function<void(size_t)>& workerStart,
+                       const std::vector<int>& workerGroups) {
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (size_t i = 0; i < threadCount; ++i) {
+        m_queues.push_back(std::make_unique<WorkQueue>());
+        m_groups.push_back(i < workerGroups.size() ? workerGroups[i] : 0);
+        m_groupCount = std::max(m_groupCount, m_groups.back() + 1);
+    }
+    m_stealOrder.resize(threadCount);
+    for (size_t thief = 0; thief < threadCount; ++thief) {
+        for (int pass = 0; pass < 2; ++pass) {
+            for (size_t offset = 1; offset < threadCount; ++offset) {
+                size_t victim = (thief + offset) % threadCount;
+                if ((m_groups[victim] == m_groups[thief]) == (pass == 0)) {
+                    m_stealOrder[thief].push_back(victim);
+                }
+            }
+        }
+    }
+    for (size_t i = 0; i < threadCount; ++i) {
+        m_threads.emplace_back([this, i, workerStart] { workerLoop(i, workerStart); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    // Finish everything queued so far, then let the workers leave.
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_stopping = true;
+    }
+    m_wakeUp.notify_all();
+
+    for (auto& thread : m_threads) {
+        thread.join();
+    }
+}
+
+int ThreadPool::currentWorker() {
+    return currentWorkerIndex;
+}
+
+int ThreadPool::currentGroup() const {
+    return (currentWorkerPool == this) ? m_groups[currentWorkerIndex] : 0;
+}
+
+void ThreadPool::push(Task task) {
+    // Tasks spawned by a worker stay local for cache reuse, outside ones are spread round-robin.
+    size_t index = (currentWorkerPool == this) ? currentWorkerIndex : m_nextQueue++ % m_queues.size();
+    m_pendingCount.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(m_queues[index]->mutex);
+        m_queues[index]->tasks.push_back(std::move(task));
+    }
+    // A worker counts itself as a sleeper before it checks the pending count, so either it sees the
+    // task or this sees it. Taking the lock keeps the notify out of the gap between its check and wait.
+    if (m_sleeperCount.load() > 0) {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_wakeUp.notify_one();
+    }
+}
+
+bool ThreadPool::popTask(size_t index, Task& task) {
+    auto& queue = *m_queues[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) return false;
+
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    return true;
+}
+
+bool ThreadPool::stealTask(size_t thief, Task& task) {
+    for (size_t victim : m_stealOrder[thief]) {
+        auto& queue = *m_queues[victim];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::runPendingTask() {
+    Task task = {};
+    size_t index = (currentWorkerPool == this) ? currentWorkerIndex : 0;
+    if (!popTask(index, task) && !stealTask(index, task)) return false;
+
+    m_pendingCount.fetch_sub(1);
+    task();
+    return true;
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& func) {
+    std::vector<std::future<void>> tasks;
+    tasks.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        tasks.push_back(submit([&func, i] { func(i); }));
+    }
+    for (auto& task : tasks) {
+        while (task.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            if (!runPendingTask()) {
+                task.wait();
+                break;
+            }
+        }
+        task.get();
+    }
+}
+
+void ThreadPool::workerLoop(size_t index, const std::function<void(size_t)>& workerStart) {
+    currentWorkerIndex = static_cast<int>(index);
+    currentWorkerPool = this;
+    if (workerStart) {
+        workerStart(index);
+    }
+
+    while (true) {
+        if (m_pendingCount.load() == 0) {
+            std::unique_lock<std::mutex> lock(m_sleepMutex);
+            m_sleeperCount.fetch_add(1);
+            m_wakeUp.wait(lock, [this] { return m_stopping || m_pendingCount.load() > 0; });
+            m_sleeperCount.fetch_sub(1);
+            if (m_pendingCount.load() == 0) return; // Stopping and drained.
+        }
+        if (!runPendingTask()) {
+            std::this_thread::yield(); // Counted but not queued yet.
+        }
+    }
+}
@@ -0,0 +1,99 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+
+#include "RayTracer/RayTracer.h"
+
+/*
+ * Fixed set of workers that live as long as the pool, each owning a deque of tasks. A worker pops
+ * its own newest task first and steals the oldest tasks of the others when it runs dry, trying the
+ * workers of its own group (NUMA node) before remote ones.
+ */
+class ThreadPool {
+public:
+    using Task = std::function<void()>;
+
+    // Zero threads means one per hardware thread. workerStart runs first on every worker, e.g. to seed RNGs.
+    // workerGroups[i] is the group of worker i, all workers share group 0 when empty.
+    explicit ThreadPool(size_t threadCount = 0, const std::function<void(size_t)>& workerStart = {},
+                        const std::vector<int>& workerGroups = {});
+
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    template<typename Func>
+    auto submit(Func&& func) -> std::future<std::invoke_result_t<Func>> {
+        using Result = std::invoke_result_t<Func>;
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Func>(func));
+        auto future = task->get_future();
+        push([task] { (*task)(); });
+        return future;
+    }
+
+    // Run func(i) for every i in [0, count) and wait, the calling thread helps instead of blocking.
+    void parallelFor(size_t count, const std::function<void(size_t)>& func);
+
+    // Run one queued task on the calling thread if there is any, for waiting without idling.
+    bool runPendingTask();
+
+    inline size_t size() const { return m_threads.size(); }
+
+    inline int groupCount() const { return m_groupCount; }
+
+    // Group of the calling worker, 0 when called from outside the pool.
+    int currentGroup() const;
+
+    // Index of the calling worker thread, -1 when called from outside the pool.
+    static int currentWorker();
+
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void push(Task task);
+
+    bool popTask(size_t index, Task& task);
+
+    bool stealTask(size_t thief, Task& task);
+
+    void workerLoop(size_t index, const std::function<void(size_t)>& workerStart);
+
+private:
+    std::vector<std::unique_ptr<WorkQueue>> m_queues = {};
+    std::vector<int> m_groups = {};
+    int m_groupCount = 1;
+    // Queues to steal from for every worker, local group first.
+    std::vector<std::vector<size_t>> m_stealOrder = {};
+    std::vector<std::thread> m_threads = {};
+
+    // Tasks counted before they are queued, so the count never drops below the number taken. Workers
+    // only lock to sleep, and a push only notifies when one is asleep.
+    std::atomic<size_t> m_pendingCount = 0;
+    std::atomic<size_t> m_sleeperCount = 0;
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wakeUp;
+    bool m_stopping = false; // Guarded by m_sleepMutex.
+
+    std::atomic<size_t> m_nextQueue = 0;
+};
+
+#endif // THREAD_POOL_H
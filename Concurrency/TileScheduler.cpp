@@ -0,0 +1,225 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#include <thread>
+
+#include "TileScheduler.h"
+
+namespace {
+    // Position of step d along the Hilbert curve filling an n x n grid, n a power of two.
+    void hilbertDecode(int n, int d, int& x, int& y) {
+        x = y = 0;
+        for (int s = 1; s < n; s *= 2) {
+            int rx = 1 & (d / 2);
+            int ry = 1 & (d ^ rx);
+            if (ry == 0) {
+                if (rx == 1) {
+                    x = s - 1 - x;
+                    y = s - 1 - y;
+                }
+                std::swap(x, y);
+            }
+            x += s * rx;
+            y += s * ry;
+            d /= 4;
+        }
+    }
+
+    inline int alignDown(int value, int alignment) {
+        return value / alignment * alignment;
+    }
+
+    // Cut length into count nearly equal spans starting at multiples of alignment, so that no span is
+    // much smaller than the others. Needs count <= length / alignment.
+    std::pair<int, int> span(int length, int count, int index, int alignment = 1) {
+        auto boundary = [&](int i) {
+            return i == count ? length : alignDown(length * i / count + alignment / 2, alignment);
+        };
+        return { boundary(index), boundary(index + 1) - 1 };
+    }
+
+    // Cell of the grid with the given first pixels that contains pixel.
+    inline int cellOf(const std::vector<int>& starts, int pixel) {
+        return static_cast<int>(std::upper_bound(starts.begin(), starts.end(), pixel) - starts.begin()) - 1;
+    }
+}
+
+TileScheduler::TileScheduler(int width, int height, int tileSize, size_t workerCount, int groupCount, int minTileSize)
+    : m_workerCount(std::max<size_t>(1, workerCount)), m_minTileSize(minTileSize),
+      m_segments(std::max(1, groupCount)) {
+    int countX = std::clamp((width + tileSize / 2) / tileSize, 1, std::max(1, width / ColumnAlignment));
+    int countY = std::max(1, (height + tileSize / 2) / tileSize);
+
+    int side = 1;
+    while (side < std::max(countX, countY)) side *= 2;
+
+    m_tiles.reserve(countX * countY);
+    for (int d = 0; d < side * side; ++d) {
+        int x = 0, y = 0;
+        hilbertDecode(side, d, x, y);
+        if (x < countX && y < countY) {
+            m_tiles.push_back({ span(width, countX, x, ColumnAlignment), span(height, countY, y) });
+        }
+    }
+
+    // Consecutive pieces of the curve are compact regions of the image.
+    for (size_t i = 0; i < m_segments.size(); ++i) {
+        m_segments[i].next = m_tiles.size() * i / m_segments.size();
+        m_segments[i].end = m_tiles.size() * (i + 1) / m_segments.size();
+    }
+
+    m_pixelPrefix.reserve(m_tiles.size() + 1);
+    m_pixelPrefix.push_back(0);
+    for (const auto& tile : m_tiles) {
+        m_pixelPrefix.push_back(m_pixelPrefix.back() + static_cast<uint64_t>(tile.width()) * tile.height());
+    }
+
+    for (int x = 0; x < countX; ++x) {
+        m_columnStarts.push_back(span(width, countX, x, ColumnAlignment).first);
+    }
+    for (int y = 0; y < countY; ++y) {
+        m_rowStarts.push_back(span(height, countY, y).first);
+    }
+    m_cellCosts = std::make_unique<std::atomic<float>[]>(countX * countY);
+    for (int i = 0; i < countX * countY; ++i) {
+        m_cellCosts[i].store(0.0f, std::memory_order_relaxed);
+    }
+}
+
+bool TileScheduler::next(Tile& tile, int group) {
+    while (true) {
+        // Own segment first, then steal from the others.
+        for (size_t i = 0; i < m_segments.size(); ++i) {
+            auto& segment = m_segments[(group + i) % m_segments.size()];
+            if (segment.next.load() >= segment.end) continue;
+
+            // Counted before the claim, so that nobody sees the segment used up before it.
+            m_claimedCount.fetch_add(1);
+            size_t index = segment.next.fetch_add(1);
+            if (index < segment.end) {
+                tile = m_tiles[index];
+                if (outlastsQueue(tile)) {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    splitTail(tile);
+                }
+            }
+            m_claimedCount.fetch_sub(1);
+            if (index < segment.end) return true;
+        }
+
+        // Only the split tail is left, which is short and rarely contended.
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_splitTiles.empty()) {
+                tile = m_splitTiles.back();
+                m_splitTiles.pop_back();
+                m_splitPixels.fetch_sub(static_cast<uint64_t>(tile.width()) * tile.height());
+                splitTail(tile);
+                return true;
+            }
+            if (m_claimedCount.load() == 0) {
+                if (m_firstIdle == std::chrono::steady_clock::time_point::max()) {
+                    m_firstIdle = std::chrono::steady_clock::now();
+                }
+                return false;
+            }
+        }
+        // Another worker is about to queue the halves of the last tiles.
+        std::this_thread::yield();
+    }
+}
+
+void TileScheduler::finish(const Tile& tile, std::chrono::steady_clock::duration elapsed) {
+    auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    uint64_t pixels = static_cast<uint64_t>(tile.width()) * tile.height();
+    m_finishedNanoseconds.fetch_add(static_cast<uint64_t>(std::max<int64_t>(0, nanoseconds)), std::memory_order_relaxed);
+    m_finishedPixels.fetch_add(pixels, std::memory_order_relaxed);
+
+    size_t cell = cellOf(m_columnStarts, tile.widthRange.first) +
+                  cellOf(m_rowStarts, tile.heightRange.first) * m_columnStarts.size();
+    m_cellCosts[cell].store(static_cast<float>(1e-9 * nanoseconds / pixels), std::memory_order_relaxed);
+}
+
+double TileScheduler::pixelCost(const Tile& tile) const {
+    int cellX = cellOf(m_columnStarts, tile.widthRange.first);
+    int cellY = cellOf(m_rowStarts, tile.heightRange.first);
+    int countX = static_cast<int>(m_columnStarts.size()), countY = static_cast<int>(m_rowStarts.size());
+
+    double sum = 0.0;
+    int count = 0;
+    for (int y = std::max(0, cellY - 1); y <= std::min(countY - 1, cellY + 1); ++y) {
+        for (int x = std::max(0, cellX - 1); x <= std::min(countX - 1, cellX + 1); ++x) {
+            float cost = m_cellCosts[x + y * countX].load(std::memory_order_relaxed);
+            if (cost > 0.0f) {
+                sum += cost;
+                ++count;
+            }
+        }
+    }
+    return count > 0 ? sum / count : meanPixelCost();
+}
+
+double TileScheduler::meanPixelCost() const {
+    uint64_t pixels = m_finishedPixels.load(std::memory_order_relaxed);
+    return pixels > 0 ? 1e-9 * m_finishedNanoseconds.load(std::memory_order_relaxed) / pixels : 1.0;
+}
+
+double TileScheduler::queuedCost() const {
+    uint64_t pixels = m_splitPixels.load(std::memory_order_relaxed);
+    for (const auto& segment : m_segments) {
+        size_t next = std::min(segment.next.load(std::memory_order_relaxed), segment.end);
+        pixels += m_pixelPrefix[segment.end] - m_pixelPrefix[next];
+    }
+    return pixels * meanPixelCost();
+}
+
+void TileScheduler::splitTail(Tile& tile) {
+    while (outlastsQueue(tile)) {
+        Tile half = tile;
+        int middleX = alignDown(tile.widthRange.first + tile.width() / 2, ColumnAlignment);
+        if (tile.width() >= tile.height() && tile.width() >= 2 * m_minTileSize && middleX > tile.widthRange.first) {
+            tile.widthRange.second = middleX - 1;
+            half.widthRange.first = middleX;
+        }
+        else if (tile.height() >= 2 * m_minTileSize) {
+            int middle = tile.heightRange.first + tile.height() / 2;
+            tile.heightRange.second = middle - 1;
+            half.heightRange.first = middle;
+        }
+        else {
+            return;
+        }
+        m_splitTiles.push_back(half);
+        m_splitPixels.fetch_add(static_cast<uint64_t>(half.width()) * half.height());
+    }
+}
+
+std::vector<std::future<void>> TileScheduler::dispatch(ThreadPool& pool, RenderProgress& progress,
+                                                       const std::function<void(const Tile&)>& func) {
+    std::vector<std::future<void>> workers;
+    workers.reserve(pool.size());
+    for (size_t i = 0; i < pool.size(); ++i) {
+        workers.push_back(pool.submit([this, &pool, &progress, func] {
+            RenderProgress::TaskScope task(progress);
+            int group = pool.currentGroup();
+            Tile tile = {};
+            while (next(tile, group)) {
+                auto start = std::chrono::steady_clock::now();
+                func(tile);
+                finish(tile, std::chrono::steady_clock::now() - start);
+            }
+        }));
+    }
+    return workers;
+}
+
+std::chrono::steady_clock::time_point TileScheduler::firstIdle() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_firstIdle;
+}
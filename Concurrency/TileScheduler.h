@@ -0,0 +1,146 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#ifndef TILE_SCHEDULER_H
+#define TILE_SCHEDULER_H
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <utility>
+
+#include "Concurrency/RenderProgress.h"
+#include "Concurrency/ThreadPool.h"
+
+#include "RayTracer/RayTracer.h"
+
+// Inclusive pixel ranges of a rectangle of the full image.
+struct Tile {
+    std::pair<int, int> widthRange = {};
+    std::pair<int, int> heightRange = {};
+
+    inline int width() const { return widthRange.second - widthRange.first + 1; }
+    inline int height() const { return heightRange.second - heightRange.first + 1; }
+};
+
+// Inverse of bit interleaving, x takes the even bits of code and y the odd ones.
+inline void mortonDecode(uint32_t code, int& x, int& y) {
+    auto compact = [](uint32_t v) {
+        v &= 0x55555555u;
+        v = (v | (v >> 1)) & 0x33333333u;
+        v = (v | (v >> 2)) & 0x0f0f0f0fu;
+        v = (v | (v >> 4)) & 0x00ff00ffu;
+        v = (v | (v >> 8)) & 0x0000ffffu;
+        return static_cast<int>(v);
+    };
+    x = compact(code);
+    y = compact(code >> 1);
+}
+
+// Visit the pixels of a width x height rectangle in Morton order, func(x, y) gets local coordinates.
+template<typename Func>
+inline void forEachMorton(int width, int height, Func&& func) {
+    uint32_t side = 1;
+    while (side < static_cast<uint32_t>(std::max(width, height))) side <<= 1;
+
+    for (uint32_t code = 0; code < side * side; ++code) {
+        int x = 0, y = 0;
+        mortonDecode(code, x, y);
+        if (x < width && y < height) {
+            func(x, y);
+        }
+    }
+}
+
+/*
+ * Hands out tiles of about tileSize pixels to any number of workers. Tiles follow a Hilbert curve over
+ * the image, so that consecutive tiles touch the same part of the scene. A tile that would take longer
+ * than the workers' share of the work still queued is halved down to minTileSize, which keeps all
+ * workers busy until the end. Its time is estimated from the finished tiles around it.
+ * With several worker groups (NUMA nodes) the curve is cut into one segment per group, and a group
+ * only takes tiles of another segment once its own is used up.
+ */
+class TileScheduler {
+public:
+    // Tile columns start at multiples of it: 64 pixels of the 3-byte framebuffer are 192 bytes, three
+    // whole cache lines, and so are the 12-byte float and 4-byte counter rows of the same pixels. Neighboring
+    // tiles then never write into the same line of an aligned row.
+    constexpr static int ColumnAlignment = 64;
+
+    TileScheduler(int width, int height, int tileSize, size_t workerCount, int groupCount = 1, int minTileSize = 8);
+
+    // Thread-safe, returns false when the frame has no work left.
+    bool next(Tile& tile, int group = 0);
+
+    // Thread-safe, the time a tile of next took feeds the cost estimates of later splits.
+    void finish(const Tile& tile, std::chrono::steady_clock::duration elapsed);
+
+    // Run func(tile) on every worker of the pool until the tiles run out, taking tiles of the worker's
+    // group first. Every worker finishes one task of the progress, which must be started with pool.size() tasks,
+    // also when func throws; the exception is rethrown by the get of its future.
+    std::vector<std::future<void>> dispatch(ThreadPool& pool, RenderProgress& progress,
+                                            const std::function<void(const Tile&)>& func);
+
+    inline size_t tileCount() const { return m_tiles.size(); }
+
+    // When the first worker found no work left, max() while all are still busy.
+    std::chrono::steady_clock::time_point firstIdle();
+
+private:
+    // Range of m_tiles owned by one group, padded against false sharing of the cursors.
+    struct alignas(64) Segment {
+        size_t end = 0;
+        std::atomic<size_t> next = 0;
+    };
+
+    // Seconds per pixel of the finished tiles around tile, or of all finished tiles when none of those is
+    // done. Without any finished tile every pixel costs 1.
+    double pixelCost(const Tile& tile) const;
+
+    double meanPixelCost() const;
+
+    // Estimated time of the tiles not handed out yet from all segments and the split tail.
+    double queuedCost() const;
+
+    inline bool outlastsQueue(const Tile& tile) const {
+        return tile.width() * tile.height() * pixelCost(tile) > queuedCost() / m_workerCount;
+    }
+
+    // Halve tile while it outlasts the queued work, queue the cut-off halves. Needs m_mutex.
+    void splitTail(Tile& tile);
+
+private:
+    size_t m_workerCount = 1;
+    int m_minTileSize = 8;
+
+    std::vector<Tile> m_tiles = {};
+    std::vector<Segment> m_segments;
+    // Pixels of m_tiles before each index.
+    std::vector<uint64_t> m_pixelPrefix = {};
+
+    // First column and row of the cells of the initial tile grid, and the seconds per pixel of the tile
+    // last finished in each cell, zero before.
+    std::vector<int> m_columnStarts = {};
+    std::vector<int> m_rowStarts = {};
+    std::unique_ptr<std::atomic<float>[]> m_cellCosts = nullptr;
+    std::atomic<uint64_t> m_finishedNanoseconds = 0;
+    std::atomic<uint64_t> m_finishedPixels = 0;
+
+    // Tiles taken from a segment and not split yet: a worker that finds no tile left must wait for the
+    // halves they may still queue.
+    std::atomic<size_t> m_claimedCount = 0;
+
+    std::mutex m_mutex;
+    std::vector<Tile> m_splitTiles = {}; // Guarded by m_mutex.
+    std::atomic<uint64_t> m_splitPixels = 0; // Changed under m_mutex.
+    std::chrono::steady_clock::time_point m_firstIdle = std::chrono::steady_clock::time_point::max();
+};
+
+#endif // TILE_SCHEDULER_H
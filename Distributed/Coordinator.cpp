@@ -0,0 +1,155 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#include <poll.h>
+
+#include "Coordinator.h"
+
+Coordinator::Coordinator(const RenderOptions& options, unsigned seed) : m_options(options), m_seed(seed) {
+    // A single consumer, so only the very last tile gets split.
+    TileScheduler scheduler(options.imageWidth, options.imageHeight(), options.tileSize, 1);
+    Tile tile = {};
+    while (scheduler.next(tile)) {
+        m_queue.push_back(static_cast<int>(m_tiles.size()));
+        m_tiles.push_back({ tile });
+    }
+}
+
+void Coordinator::run(const std::string& address, ExporterManager& em) {
+    Socket listener = Socket::listen(address);
+    std::cout << "Serving " << m_tiles.size() << " tiles on " << address << std::endl;
+
+    size_t lastReported = 0;
+    while (m_doneCount < m_tiles.size()) {
+        std::vector<pollfd> fds = { { listener.fd(), POLLIN, 0 } };
+        for (const auto& [fd, client] : m_clients) {
+            fds.push_back({ fd, POLLIN, 0 });
+        }
+        if (::poll(fds.data(), fds.size(), 1000) < 0) continue; // Interrupted by a signal.
+
+        if (fds[0].revents & POLLIN) {
+            Socket socket = listener.accept();
+            if (socket.valid()) {
+                int fd = socket.fd();
+                m_clients[fd] = { std::move(socket) };
+            }
+        }
+        for (size_t i = 1; i < fds.size() && m_doneCount < m_tiles.size(); ++i) {
+            if (fds[i].revents == 0) continue;
+
+            auto& client = m_clients[fds[i].fd];
+            Message message = {};
+            if (!receiveMessage(client.socket, message) || !handleMessage(client, message, em)) {
+                dropClient(fds[i].fd);
+            }
+        }
+
+        if (m_doneCount * 10 / m_tiles.size() > lastReported * 10 / m_tiles.size()) {
+            std::cout << "Received " << m_doneCount << " / " << m_tiles.size() << " tiles from "
+                      << m_clients.size() << " workers" << std::endl;
+            lastReported = m_doneCount;
+        }
+    }
+    std::cout << "All tiles received, " << m_workerCount << " workers joined." << std::endl;
+    // Workers see the connection close and stop.
+    m_clients.clear();
+}
+
+bool Coordinator::handleMessage(Client& client, const Message& message, ExporterManager& em) {
+    switch (message.type) {
+        case MessageType::Hello: {
+            ByteReader reader(message.payload);
+            if (reader.get<uint32_t>() != protocolVersion) {
+                std::cout << "Dropping a worker of another protocol version." << std::endl;
+                return false;
+            }
+            ++m_workerCount;
+            return sendMessage(client.socket, MessageType::Job, encodeJob(m_options, m_seed));
+        }
+        case MessageType::RequestTile: {
+            int id = takeTile(client);
+            if (id >= 0) {
+                client.tiles.insert(id);
+                return sendMessage(client.socket, MessageType::Tile, encodeTile(id, m_tiles[id].tile));
+            }
+            return sendMessage(client.socket, m_doneCount == m_tiles.size() ? MessageType::Done : MessageType::Wait);
+        }
+        case MessageType::TileResult: {
+            // Results are written without bounds checks, so they have to cover exactly the tile issued. That
+            // is checked before the buffer is allocated, sizes sent by a broken worker are never trusted.
+            int id = tileResultId(message.payload);
+            std::unique_ptr<AccumulationBuffer> buffer = nullptr;
+            if (id < 0 || id >= static_cast<int>(m_tiles.size()) || client.tiles.count(id) == 0 ||
+                !decodeTileResult(message.payload, m_tiles[id].tile, buffer)) {
+                std::cout << "Dropping a worker that sent a result for a tile it was not issued." << std::endl;
+                return false;
+            }
+            auto& state = m_tiles[id];
+            client.tiles.erase(id);
+
+            if (!state.done) {
+                buffer->resolve(em);
+                em.markWritten(buffer->originX(), buffer->originY(), buffer->width(), buffer->height());
+                state.done = true;
+                ++m_doneCount;
+            }
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+int Coordinator::takeTile(const Client& client) {
+    auto now = std::chrono::steady_clock::now();
+    while (!m_queue.empty()) {
+        int id = m_queue.front();
+        m_queue.pop_front();
+
+        auto& state = m_tiles[id];
+        state.queued = false;
+        if (!state.done) {
+            state.issuedAt = now;
+            return id;
+        }
+    }
+
+    // Speculatively duplicate the most overdue tile of another worker.
+    if (m_options.tileTimeout <= 0.0) return -1;
+
+    int overdue = -1;
+    for (int id = 0; id < static_cast<int>(m_tiles.size()); ++id) {
+        const auto& state = m_tiles[id];
+        double age = std::chrono::duration<double>(now - state.issuedAt).count();
+        if (state.done || age < m_options.tileTimeout || client.tiles.count(id) > 0) continue;
+        if (overdue < 0 || state.issuedAt < m_tiles[overdue].issuedAt) {
+            overdue = id;
+        }
+    }
+    if (overdue >= 0) {
+        m_tiles[overdue].issuedAt = now;
+    }
+    return overdue;
+}
+
+void Coordinator::dropClient(int fd) {
+    auto& client = m_clients[fd];
+    size_t requeued = 0;
+    // Back to the front, the frame cannot finish without them.
+    for (int id : client.tiles) {
+        auto& state = m_tiles[id];
+        if (!state.done && !state.queued) {
+            state.queued = true;
+            m_queue.push_front(id);
+            ++requeued;
+        }
+    }
+    std::cout << "Lost a worker, re-issuing " << requeued << " tiles." << std::endl;
+    m_clients.erase(fd);
+}
@@ -0,0 +1,70 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#ifndef COORDINATOR_H
+#define COORDINATOR_H
+
+#include <deque>
+#include <map>
+#include <set>
+
+#include "Concurrency/TileScheduler.h"
+#include "Distributed/Protocol.h"
+#include "Distributed/Socket.h"
+#include "Exporter/ExporterManager.h"
+#include "RayTracer/RenderOptions.h"
+
+#include "RayTracer/RayTracer.h"
+
+/*
+ * Serves the tiles of one frame to any number of worker processes and writes the results into the
+ * image. Tiles of a worker that disconnects go back to the front of the queue, and with a tile timeout
+ * a tile that is overdue is handed out once more to an idle worker, the first result wins.
+ */
+class Coordinator {
+public:
+    Coordinator(const RenderOptions& options, unsigned seed);
+
+    // Blocks until every tile is back. em must have been started with the image size.
+    void run(const std::string& address, ExporterManager& em);
+
+private:
+    struct Client {
+        Socket socket;
+        std::set<int> tiles = {}; // Handed out and not returned yet.
+    };
+
+    struct TileState {
+        Tile tile = {};
+        bool done = false;
+        bool queued = true;
+        std::chrono::steady_clock::time_point issuedAt = {};
+    };
+
+    // False when the client has to be dropped.
+    bool handleMessage(Client& client, const Message& message, ExporterManager& em);
+
+    // Next tile for a requesting client, -1 if there is none right now.
+    int takeTile(const Client& client);
+
+    void dropClient(int fd);
+
+private:
+    RenderOptions m_options = {};
+    unsigned m_seed = 0;
+
+    std::vector<TileState> m_tiles = {};
+    std::deque<int> m_queue = {};
+    size_t m_doneCount = 0;
+
+    std::map<int, Client> m_clients = {};
+    size_t m_workerCount = 0;
+};
+
+#endif // COORDINATOR_H
@@ -0,0 +1,123 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#include <poll.h>
+#include <sys/socket.h>
+
+#include "Exporter/stb_image_write.h"
+
+#include "PreviewServer.h"
+
+namespace {
+    // Share of one core that grabbing, encoding and sending frames may take.
+    constexpr double MaxDutyCycle = 0.02;
+
+    constexpr int JpegQuality = 80;
+
+    // Longest sleep between checks of finish().
+    constexpr int PollMilliseconds = 100;
+
+    // Longest a send to a viewer may block before the viewer is dropped, so that one which stopped
+    // reading cannot hold up the previews, nor finish() at the end of the render.
+    constexpr double SendTimeout = 1.0;
+
+    // Sent to every viewer up front, whatever it asked for. Each frame then replaces the previous one.
+    const std::string StreamHeader = "HTTP/1.0 200 OK\r\n"
+                                     "Content-Type: multipart/x-mixed-replace; boundary=frame\r\n"
+                                     "Cache-Control: no-cache\r\n"
+                                     "Connection: close\r\n\r\n";
+}
+
+PreviewServer::PreviewServer(const std::string& address, size_t imageWidth, size_t imageHeight, FrameSource source,
+                             size_t maxWidth, double interval)
+    : m_listener(Socket::listen(address)), m_source(std::move(source)), m_interval(interval) {
+    m_width = std::max<size_t>(1, std::min(imageWidth, maxWidth));
+    m_height = std::max<size_t>(1, imageHeight * m_width / imageWidth);
+    m_rgb.resize(3 * m_width * m_height);
+    m_thread = std::thread([this] { run(); });
+}
+
+PreviewServer::~PreviewServer() {
+    finish();
+}
+
+void PreviewServer::finish() {
+    if (m_thread.joinable()) {
+        m_finishing = true;
+        m_thread.join();
+    }
+}
+
+void PreviewServer::run() {
+    using Clock = std::chrono::steady_clock;
+    auto nextFrame = Clock::now();
+    char discarded[4096];
+
+    while (true) {
+        bool finishing = m_finishing.load();
+        auto now = Clock::now();
+        if (finishing || now >= nextFrame) {
+            if (!m_viewers.empty()) {
+                sendFrame();
+            }
+            if (finishing) break;
+
+            double cost = std::chrono::duration<double>(Clock::now() - now).count();
+            nextFrame = now + std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>(std::max(m_interval, cost / MaxDutyCycle)));
+        }
+
+        // Wait for viewers coming and going until the next frame is due.
+        std::vector<pollfd> fds = { { m_listener.fd(), POLLIN, 0 } };
+        for (const auto& viewer : m_viewers) {
+            fds.push_back({ viewer.fd(), POLLIN, 0 });
+        }
+        auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(nextFrame - Clock::now()).count();
+        if (::poll(fds.data(), fds.size(), static_cast<int>(std::clamp<long long>(wait, 0, PollMilliseconds))) <= 0) {
+            continue;
+        }
+
+        // Requests are read and ignored, a viewer is gone once its side is closed.
+        for (size_t i = fds.size() - 1; i > 0; --i) {
+            if (fds[i].revents != 0 && ::recv(fds[i].fd, discarded, sizeof(discarded), 0) <= 0) {
+                m_viewers.erase(m_viewers.begin() + static_cast<std::ptrdiff_t>(i - 1));
+            }
+        }
+        if (fds[0].revents & POLLIN) {
+            Socket viewer = m_listener.accept();
+            if (viewer.valid() && viewer.setSendTimeout(SendTimeout) &&
+                viewer.sendAll(StreamHeader.data(), StreamHeader.size())) {
+                m_viewers.push_back(std::move(viewer));
+                nextFrame = Clock::now(); // Something to look at right away.
+            }
+        }
+    }
+    m_viewers.clear();
+}
+
+void PreviewServer::sendFrame() {
+    m_source(m_width, m_height, m_rgb.data());
+
+    m_jpeg.clear();
+    stbi_write_jpg_to_func([](void* context, void* data, int size) {
+        auto& jpeg = *static_cast<std::vector<unsigned char>*>(context);
+        jpeg.insert(jpeg.end(), static_cast<unsigned char*>(data), static_cast<unsigned char*>(data) + size);
+    }, &m_jpeg, static_cast<int>(m_width), static_cast<int>(m_height), 3, m_rgb.data(), JpegQuality);
+
+    std::string header = "--frame\r\nContent-Type: image/jpeg\r\nContent-Length: " + std::to_string(m_jpeg.size()) +
+                         "\r\n\r\n";
+    // Blocking sends, but a viewer whose window stays full for SendTimeout is dropped.
+    for (size_t i = m_viewers.size(); i > 0; --i) {
+        auto& viewer = m_viewers[i - 1];
+        if (!viewer.sendAll(header.data(), header.size()) || !viewer.sendAll(m_jpeg.data(), m_jpeg.size()) ||
+            !viewer.sendAll("\r\n", 2)) {
+            m_viewers.erase(m_viewers.begin() + static_cast<std::ptrdiff_t>(i - 1));
+        }
+    }
+}
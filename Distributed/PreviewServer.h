@@ -0,0 +1,63 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#ifndef PREVIEW_SERVER_H
+#define PREVIEW_SERVER_H
+
+#include <atomic>
+#include <thread>
+
+#include "Distributed/Socket.h"
+
+#include "RayTracer/RayTracer.h"
+
+/*
+ * Live preview of a render in progress, a motion JPEG stream over HTTP that browsers, curl or ffplay
+ * show as it comes, e.g. http://localhost:8080/ for the address localhost:8080. Runs on a thread of
+ * its own: accepts viewers, and while any are connected grabs a downscaled frame from the source every
+ * interval seconds, encodes and sends it. The interval stretches whenever a frame takes longer than
+ * MaxDutyCycle of it, so previews never cost more than a few percent of one core.
+ */
+class PreviewServer {
+public:
+    // Fill the width x height 8-bit RGB pixels of rgb from the image so far.
+    using FrameSource = std::function<void(size_t width, size_t height, uint8_t* rgb)>;
+
+    // Listens on address (see Socket) right away and throws std::runtime_error when it cannot. Frames
+    // are at most maxWidth wide and keep the aspect ratio of the image.
+    PreviewServer(const std::string& address, size_t imageWidth, size_t imageHeight, FrameSource source,
+                  size_t maxWidth = 640, double interval = 0.5);
+
+    ~PreviewServer();
+
+    // Send a last frame of the finished image to the viewers, then close everything.
+    void finish();
+
+private:
+    void run();
+
+    // Grab, encode and send one frame, dropping viewers that are gone.
+    void sendFrame();
+
+private:
+    Socket m_listener = {};
+    std::vector<Socket> m_viewers = {};
+
+    FrameSource m_source = nullptr;
+    size_t m_width = 0, m_height = 0;
+    double m_interval = 0.5;
+
+    std::vector<uint8_t> m_rgb = {};
+    std::vector<unsigned char> m_jpeg = {};
+
+    std::atomic<bool> m_finishing = false;
+    std::thread m_thread = {};
+};
+
+#endif // PREVIEW_SERVER_H
@@ -0,0 +1,180 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#include <sstream>
+
+#ifdef RAYTRACER_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "Protocol.h"
+
+namespace {
+    // Larger than any tile result, guards against reading garbage as a size.
+    constexpr uint32_t maxPayloadSize = 1u << 30;
+}
+
+bool sendMessage(Socket& socket, MessageType type, const std::vector<char>& payload) {
+    uint32_t header[2] = { static_cast<uint32_t>(type), static_cast<uint32_t>(payload.size()) };
+    return socket.sendAll(header, sizeof(header)) && (payload.empty() || socket.sendAll(payload.data(), payload.size()));
+}
+
+bool receiveMessage(Socket& socket, Message& message) {
+    uint32_t header[2] = {};
+    if (!socket.receiveAll(header, sizeof(header)) || header[1] > maxPayloadSize) return false;
+
+    message.type = static_cast<MessageType>(header[0]);
+    message.payload.resize(header[1]);
+    return message.payload.empty() || socket.receiveAll(message.payload.data(), message.payload.size());
+}
+
+std::vector<char> encodeJob(const RenderOptions& options, unsigned seed) {
+    ByteWriter writer = {};
+    writer.put<double>(options.aspectRatio);
+    writer.put<int32_t>(options.imageWidth);
+    writer.put<int32_t>(options.maxDepth);
+    writer.put<int32_t>(options.sampleCount);
+    writer.putString(options.scene);
+    writer.put<int32_t>(options.lightCount);
+    writer.put<uint64_t>(options.generator.sphereCount);
+    writer.put<double>(options.generator.density);
+    for (double weight : options.generator.materialMix) {
+        writer.put<double>(weight);
+    }
+    writer.put<int32_t>(options.generator.clusterCount);
+    writer.put<int32_t>(options.generator.paletteSize);
+    writer.put<uint32_t>(static_cast<uint32_t>(options.directLighting));
+    writer.put<int32_t>(options.restir.candidateCount);
+    writer.put<int32_t>(options.restir.spatialNeighbors);
+    writer.put<int32_t>(options.restir.spatialRadius);
+    writer.put<int32_t>(options.restir.temporalMaxM);
+    writer.put<uint32_t>(seed);
+    return std::move(writer.bytes());
+}
+
+bool decodeJob(const std::vector<char>& payload, RenderOptions& options, unsigned& seed) {
+    ByteReader reader(payload);
+    options.aspectRatio = reader.get<double>();
+    options.imageWidth = reader.get<int32_t>();
+    options.maxDepth = reader.get<int32_t>();
+    options.sampleCount = reader.get<int32_t>();
+    options.scene = reader.getString();
+    options.lightCount = reader.get<int32_t>();
+    options.generator.sphereCount = reader.get<uint64_t>();
+    options.generator.density = reader.get<double>();
+    for (double& weight : options.generator.materialMix) {
+        weight = reader.get<double>();
+    }
+    options.generator.clusterCount = reader.get<int32_t>();
+    options.generator.paletteSize = reader.get<int32_t>();
+    options.directLighting = static_cast<DirectLightingMode>(reader.get<uint32_t>());
+    options.restir.candidateCount = reader.get<int32_t>();
+    options.restir.spatialNeighbors = reader.get<int32_t>();
+    options.restir.spatialRadius = reader.get<int32_t>();
+    options.restir.temporalMaxM = reader.get<int32_t>();
+    seed = reader.get<uint32_t>();
+    return reader.ok();
+}
+
+std::vector<char> encodeTile(int id, const Tile& tile) {
+    ByteWriter writer = {};
+    writer.put<int32_t>(id);
+    writer.put<int32_t>(tile.widthRange.first);
+    writer.put<int32_t>(tile.widthRange.second);
+    writer.put<int32_t>(tile.heightRange.first);
+    writer.put<int32_t>(tile.heightRange.second);
+    return std::move(writer.bytes());
+}
+
+bool decodeTile(const std::vector<char>& payload, int& id, Tile& tile) {
+    ByteReader reader(payload);
+    id = reader.get<int32_t>();
+    tile.widthRange.first = reader.get<int32_t>();
+    tile.widthRange.second = reader.get<int32_t>();
+    tile.heightRange.first = reader.get<int32_t>();
+    tile.heightRange.second = reader.get<int32_t>();
+    return reader.ok() && tile.width() > 0 && tile.height() > 0;
+}
+
+std::vector<char> encodeTileResult(int id, const AccumulationBuffer& buffer) {
+    std::ostringstream raw;
+    buffer.write(raw);
+    std::string data = raw.str();
+
+    bool compressed = false;
+#ifdef RAYTRACER_HAVE_ZLIB
+    // Fastest level, sample counts and the float exponents shrink well already.
+    std::string deflated(compressBound(data.size()), '\0');
+    uLongf deflatedSize = deflated.size();
+    if (compress2(reinterpret_cast<Bytef*>(deflated.data()), &deflatedSize,
+                  reinterpret_cast<const Bytef*>(data.data()), data.size(), Z_BEST_SPEED) == Z_OK &&
+        deflatedSize < data.size()) {
+        deflated.resize(deflatedSize);
+        compressed = true;
+    }
+#endif
+
+    ByteWriter writer = {};
+    writer.put<int32_t>(id);
+    writer.put<int32_t>(buffer.originX());
+    writer.put<int32_t>(buffer.originY());
+    writer.put<int32_t>(buffer.width());
+    writer.put<int32_t>(buffer.height());
+    writer.put<uint8_t>(compressed ? 1 : 0);
+    writer.put<uint64_t>(data.size());
+#ifdef RAYTRACER_HAVE_ZLIB
+    writer.putBytes(compressed ? deflated : data);
+#else
+    writer.putBytes(data);
+#endif
+    return std::move(writer.bytes());
+}
+
+int tileResultId(const std::vector<char>& payload) {
+    ByteReader reader(payload);
+    int id = reader.get<int32_t>();
+    return reader.ok() ? id : -1;
+}
+
+bool decodeTileResult(const std::vector<char>& payload, const Tile& tile, std::unique_ptr<AccumulationBuffer>& buffer) {
+    ByteReader reader(payload);
+    reader.get<int32_t>(); // Id, see tileResultId.
+    int originX = reader.get<int32_t>();
+    int originY = reader.get<int32_t>();
+    int width = reader.get<int32_t>();
+    int height = reader.get<int32_t>();
+    bool compressed = reader.get<uint8_t>() != 0;
+    auto rawSize = reader.get<uint64_t>();
+    // Sums, sample counts and squared luminance sums, 20 bytes per pixel, see AccumulationBuffer::write.
+    if (!reader.ok() || originX != tile.widthRange.first || originY != tile.heightRange.first ||
+        width != tile.width() || height != tile.height() ||
+        rawSize != 20 * static_cast<uint64_t>(width) * static_cast<uint64_t>(height) || rawSize > maxPayloadSize) {
+        return false;
+    }
+
+    std::string data = reader.getBytes(payload.size() - (sizeof(int32_t) * 5 + sizeof(uint8_t) + sizeof(uint64_t)));
+    if (compressed) {
+#ifdef RAYTRACER_HAVE_ZLIB
+        std::string inflated(rawSize, '\0');
+        uLongf inflatedSize = inflated.size();
+        if (uncompress(reinterpret_cast<Bytef*>(inflated.data()), &inflatedSize,
+                       reinterpret_cast<const Bytef*>(data.data()), data.size()) != Z_OK || inflatedSize != rawSize) {
+            return false;
+        }
+        data = std::move(inflated);
+#else
+        return false;
+#endif
+    }
+    if (data.size() != rawSize) return false;
+
+    buffer = std::make_unique<AccumulationBuffer>(width, height, originX, originY);
+    std::istringstream in(data);
+    return buffer->read(in);
+}
@@ -0,0 +1,132 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <cstring>
+
+#include "Concurrency/AccumulationBuffer.h"
+#include "Concurrency/TileScheduler.h"
+#include "Distributed/Socket.h"
+#include "RayTracer/RenderOptions.h"
+
+#include "RayTracer/RayTracer.h"
+
+/*
+ * Coordinator/worker conversation, every message is a 32-bit type and a 32-bit payload size followed by
+ * the payload, all in native byte order:
+ *
+ *   worker                       coordinator
+ *   Hello(version)          ->
+ *                           <-   Job(render options, seed)
+ *   RequestTile             ->
+ *                           <-   Tile(id, ranges) | Wait | Done
+ *   TileResult(id, floats)  ->   (no answer)
+ *
+ * A worker keeps one tile requested per render thread and answers each with a TileResult.
+ */
+enum class MessageType : uint32_t {
+    Hello = 1,
+    Job,
+    RequestTile,
+    Tile,
+    Wait,
+    Done,
+    TileResult
+};
+
+constexpr uint32_t protocolVersion = 4;
+
+struct Message {
+    MessageType type = MessageType::Hello;
+    std::vector<char> payload = {};
+};
+
+bool sendMessage(Socket& socket, MessageType type, const std::vector<char>& payload = {});
+
+// False when the peer is gone or sent garbage.
+bool receiveMessage(Socket& socket, Message& message);
+
+class ByteWriter {
+public:
+    template<typename T>
+    inline void put(T value) {
+        size_t offset = m_bytes.size();
+        m_bytes.resize(offset + sizeof(T));
+        std::memcpy(m_bytes.data() + offset, &value, sizeof(T));
+    }
+
+    inline void putString(const std::string& value) {
+        put<uint32_t>(static_cast<uint32_t>(value.size()));
+        m_bytes.insert(m_bytes.end(), value.begin(), value.end());
+    }
+
+    inline void putBytes(const std::string& value) { m_bytes.insert(m_bytes.end(), value.begin(), value.end()); }
+
+    inline std::vector<char>& bytes() { return m_bytes; }
+
+private:
+    std::vector<char> m_bytes = {};
+};
+
+// Reads past the end yield zeros and clear ok().
+class ByteReader {
+public:
+    explicit ByteReader(const std::vector<char>& bytes) : m_bytes(bytes) {}
+
+    template<typename T>
+    inline T get() {
+        T value = {};
+        if (m_offset + sizeof(T) > m_bytes.size()) {
+            m_ok = false;
+            return value;
+        }
+        std::memcpy(&value, m_bytes.data() + m_offset, sizeof(T));
+        m_offset += sizeof(T);
+        return value;
+    }
+
+    inline std::string getString() { return getBytes(get<uint32_t>()); }
+
+    inline std::string getBytes(size_t size) {
+        if (m_offset + size > m_bytes.size()) {
+            m_ok = false;
+            return {};
+        }
+        std::string value(m_bytes.data() + m_offset, size);
+        m_offset += size;
+        return value;
+    }
+
+    inline bool ok() const { return m_ok; }
+
+private:
+    const std::vector<char>& m_bytes;
+    size_t m_offset = 0;
+    bool m_ok = true;
+};
+
+// Everything a worker needs to build the same scene and sample it the same way.
+std::vector<char> encodeJob(const RenderOptions& options, unsigned seed);
+bool decodeJob(const std::vector<char>& payload, RenderOptions& options, unsigned& seed);
+
+std::vector<char> encodeTile(int id, const Tile& tile);
+bool decodeTile(const std::vector<char>& payload, int& id, Tile& tile);
+
+// Float sums and sample counts of a tile, deflated when zlib is available.
+std::vector<char> encodeTileResult(int id, const AccumulationBuffer& buffer);
+
+// Id of the tile a result is for, -1 for a short payload. Look the issued tile up by it before decoding.
+int tileResultId(const std::vector<char>& payload);
+
+// False unless the result covers exactly tile and its sizes agree, checked before anything is allocated.
+bool decodeTileResult(const std::vector<char>& payload, const Tile& tile, std::unique_ptr<AccumulationBuffer>& buffer);
+
+#endif // PROTOCOL_H
@@ -0,0 +1,149 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#include <condition_variable>
+#include <mutex>
+#include <stdexcept>
+
+#include "RenderWorker.h"
+
+#include "Concurrency/PartialProcessor.h"
+#include "Concurrency/ThreadPool.h"
+#include "Distributed/Protocol.h"
+#include "Light/LightBVH.h"
+#include "Scene/SceneLoader.h"
+
+void runRenderWorker(const std::string& address, size_t threadCount) {
+    Socket socket = Socket::connect(address);
+
+    ByteWriter hello = {};
+    hello.put<uint32_t>(protocolVersion);
+    Message message = {};
+    if (!sendMessage(socket, MessageType::Hello, hello.bytes()) || !receiveMessage(socket, message) ||
+        message.type != MessageType::Job) {
+        throw std::runtime_error("Coordinator at " + address + " did not send a job.");
+    }
+
+    RenderOptions options = {};
+    unsigned seed = 0;
+    if (!decodeJob(message.payload, options, seed)) {
+        throw std::runtime_error("Coordinator at " + address + " sent a broken job.");
+    }
+
+    // Render threads queue encoded results, this thread does all the talking. Declared before the pool,
+    // which finishes its tasks when destroyed. A tile that failed queues an empty result.
+    std::mutex resultsMutex;
+    std::condition_variable resultReady;
+    std::vector<std::vector<char>> results = {};
+
+    ThreadPool pool(threadCount, [seed](size_t index) {
+        std::seed_seq sequence = { seed, static_cast<unsigned>(index + 1) };
+        defaultRandomEngine.seed(sequence);
+    });
+
+    // Same seed, same scene as the coordinator and every other worker.
+    defaultRandomEngine.seed(seed);
+    std::shared_ptr<Camera> camera = nullptr;
+    std::vector<std::shared_ptr<Shape>> shapeList = {};
+    loadScene(options, seed, camera, shapeList, nullptr, &pool);
+    buildHierarchies(shapeList, &pool);
+
+    PartialSceneInfo sceneInfo(shapeList);
+    sceneInfo.fullSize = { options.imageWidth, options.imageHeight() };
+    sceneInfo.camera = camera;
+    sceneInfo.lights = std::make_shared<LightBVH>(shapeList);
+    sceneInfo.maxDepth = options.maxDepth;
+    sceneInfo.sampleCount = options.sampleCount;
+    sceneInfo.directLighting = options.directLighting;
+    sceneInfo.restir = options.restir;
+    sceneInfo.seed = seed;
+
+    std::cout << "Joined " << address << ", rendering " << options.scene << " on " << pool.size() << " threads."
+              << std::endl;
+
+    // The scene is declared after the pool, so nothing may leave this function while tiles are in flight:
+    // failures are only recorded here and thrown once every tile is back.
+    std::string failure = {};
+    size_t inFlight = 0, renderedCount = 0;
+    bool finished = false, connected = true;
+    while (connected && (!finished || inFlight > 0)) {
+        while (!finished && inFlight < pool.size()) {
+            if (!sendMessage(socket, MessageType::RequestTile) || !receiveMessage(socket, message)) {
+                finished = true;
+                connected = false;
+                break;
+            }
+            if (message.type == MessageType::Wait) break;
+            if (message.type != MessageType::Tile) {
+                finished = true;
+                break;
+            }
+
+            int id = -1;
+            Tile tile = {};
+            if (!decodeTile(message.payload, id, tile)) {
+                failure = "Coordinator at " + address + " sent a broken tile.";
+                finished = true;
+                break;
+            }
+            ++inFlight;
+            pool.submit([&, id, tile] {
+                std::vector<char> result = {};
+                try {
+                    PartialSceneInfo info = tileSceneInfo(sceneInfo, tile);
+                    auto buffer = std::make_shared<AccumulationBuffer>(tile.width(), tile.height(),
+                                                                       tile.widthRange.first, tile.heightRange.first);
+                    info.accumulation = buffer;
+                    PartialProcessor(info, id).process();
+                    result = encodeTileResult(id, *buffer);
+                }
+                catch (const std::exception& e) {
+                    std::lock_guard<std::mutex> lock(resultsMutex);
+                    std::cout << "Tile " << id << " failed: " << e.what() << std::endl;
+                }
+                std::lock_guard<std::mutex> lock(resultsMutex);
+                results.push_back(std::move(result));
+                resultReady.notify_one();
+            });
+        }
+
+        // Also the back-off while the coordinator has nothing to hand out.
+        std::vector<std::vector<char>> ready = {};
+        {
+            std::unique_lock<std::mutex> lock(resultsMutex);
+            resultReady.wait_for(lock, std::chrono::milliseconds(100), [&] { return !results.empty(); });
+            std::swap(ready, results);
+        }
+        for (const auto& result : ready) {
+            --inFlight;
+            if (result.empty()) {
+                // Leaving drops the connection, the coordinator hands the tiles of this worker to others.
+                failure = "Rendering a tile failed.";
+                finished = true;
+                continue;
+            }
+            ++renderedCount;
+            if (connected && !sendMessage(socket, MessageType::TileResult, result)) {
+                connected = false;
+            }
+        }
+    }
+
+    // Tiles still rendering reference the scene, wait for them before leaving.
+    while (inFlight > 0) {
+        std::unique_lock<std::mutex> lock(resultsMutex);
+        resultReady.wait(lock, [&] { return !results.empty(); });
+        inFlight -= results.size();
+        results.clear();
+    }
+    std::cout << "Rendered " << renderedCount << " tiles." << std::endl;
+    if (!failure.empty()) {
+        throw std::runtime_error(failure);
+    }
+}
@@ -0,0 +1,19 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#ifndef RENDER_WORKER_H
+#define RENDER_WORKER_H
+
+#include "RayTracer/RayTracer.h"
+
+// Join the coordinator at address, build the scene of its job once and render the tiles it hands out on
+// threadCount threads (zero for all hardware threads) until the frame is done or the coordinator is gone.
+void runRenderWorker(const std::string& address, size_t threadCount);
+
+#endif // RENDER_WORKER_H
@@ -0,0 +1,202 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "Socket.h"
+
+namespace {
+    constexpr const char* unixPrefix = "unix:";
+    constexpr const char* tcpPrefix = "tcp:";
+
+    bool startsWith(const std::string& text, const std::string& prefix) {
+        return text.compare(0, prefix.size(), prefix) == 0;
+    }
+
+    std::runtime_error socketError(const std::string& what, const std::string& address) {
+        return std::runtime_error(what + " " + address + ": " + std::strerror(errno));
+    }
+
+    sockaddr_un unixAddress(const std::string& path, const std::string& address) {
+        sockaddr_un result = {};
+        result.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(result.sun_path)) {
+            throw std::runtime_error("Socket path too long: " + address);
+        }
+        std::strcpy(result.sun_path, path.c_str());
+        return result;
+    }
+
+    // Resolve "host:port", an empty host listens on all interfaces.
+    addrinfo* resolve(const std::string& hostPort, bool passive, const std::string& address) {
+        auto colon = hostPort.find_last_of(':');
+        if (colon == std::string::npos) {
+            throw std::runtime_error("Expected host:port, got " + address);
+        }
+        std::string host = hostPort.substr(0, colon);
+        std::string port = hostPort.substr(colon + 1);
+
+        addrinfo hints = {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = passive ? AI_PASSIVE : 0;
+        addrinfo* result = nullptr;
+        int status = getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &result);
+        if (status != 0) {
+            throw std::runtime_error("Cannot resolve " + address + ": " + gai_strerror(status));
+        }
+        return result;
+    }
+
+    void setNoDelay(int fd) {
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    }
+}
+
+Socket::~Socket() {
+    close();
+}
+
+Socket::Socket(Socket&& other) noexcept : m_fd(other.m_fd), m_unixPath(std::move(other.m_unixPath)) {
+    other.m_fd = -1;
+    other.m_unixPath.clear();
+}
+
+Socket& Socket::operator=(Socket&& other) noexcept {
+    if (this != &other) {
+        close();
+        m_fd = other.m_fd;
+        m_unixPath = std::move(other.m_unixPath);
+        other.m_fd = -1;
+        other.m_unixPath.clear();
+    }
+    return *this;
+}
+
+Socket Socket::listen(const std::string& address) {
+    Socket result = {};
+    if (startsWith(address, unixPrefix)) {
+        std::string path = address.substr(std::strlen(unixPrefix));
+        auto socketAddress = unixAddress(path, address);
+        ::unlink(path.c_str()); // Left over by a killed coordinator.
+
+        result.m_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (result.m_fd < 0 || ::bind(result.m_fd, reinterpret_cast<sockaddr*>(&socketAddress), sizeof(socketAddress)) != 0) {
+            throw socketError("Cannot bind", address);
+        }
+        result.m_unixPath = path;
+    }
+    else {
+        std::string hostPort = startsWith(address, tcpPrefix) ? address.substr(std::strlen(tcpPrefix)) : address;
+        addrinfo* info = resolve(hostPort, true, address);
+        result.m_fd = ::socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+        int on = 1;
+        if (result.m_fd >= 0) {
+            setsockopt(result.m_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        }
+        bool bound = result.m_fd >= 0 && ::bind(result.m_fd, info->ai_addr, info->ai_addrlen) == 0;
+        freeaddrinfo(info);
+        if (!bound) {
+            throw socketError("Cannot bind", address);
+        }
+    }
+
+    if (::listen(result.m_fd, SOMAXCONN) != 0) {
+        throw socketError("Cannot listen on", address);
+    }
+    return result;
+}
+
+Socket Socket::connect(const std::string& address) {
+    Socket result = {};
+    if (startsWith(address, unixPrefix)) {
+        auto socketAddress = unixAddress(address.substr(std::strlen(unixPrefix)), address);
+        result.m_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (result.m_fd < 0 || ::connect(result.m_fd, reinterpret_cast<sockaddr*>(&socketAddress), sizeof(socketAddress)) != 0) {
+            throw socketError("Cannot connect to", address);
+        }
+        return result;
+    }
+
+    std::string hostPort = startsWith(address, tcpPrefix) ? address.substr(std::strlen(tcpPrefix)) : address;
+    addrinfo* info = resolve(hostPort, false, address);
+    for (addrinfo* candidate = info; candidate != nullptr; candidate = candidate->ai_next) {
+        result.m_fd = ::socket(candidate->ai_family, candidate->ai_socktype, candidate->ai_protocol);
+        if (result.m_fd >= 0 && ::connect(result.m_fd, candidate->ai_addr, candidate->ai_addrlen) == 0) break;
+        result.close();
+    }
+    freeaddrinfo(info);
+    if (!result.valid()) {
+        throw socketError("Cannot connect to", address);
+    }
+    setNoDelay(result.m_fd);
+    return result;
+}
+
+Socket Socket::accept() const {
+    int fd = ::accept(m_fd, nullptr, nullptr);
+    if (fd >= 0 && m_unixPath.empty()) {
+        setNoDelay(fd);
+    }
+    return Socket(fd);
+}
+
+bool Socket::setSendTimeout(double seconds) {
+    timeval timeout = {};
+    timeout.tv_sec = static_cast<time_t>(seconds);
+    timeout.tv_usec = static_cast<suseconds_t>((seconds - static_cast<double>(timeout.tv_sec)) * 1e6);
+    return setsockopt(m_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) == 0;
+}
+
+bool Socket::sendAll(const void* data, size_t size) {
+    auto bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        // No SIGPIPE when the peer is gone, the caller handles the failure.
+        ssize_t sent = ::send(m_fd, bytes, size, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent <= 0) return false;
+        bytes += sent;
+        size -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+bool Socket::receiveAll(void* data, size_t size) {
+    auto bytes = static_cast<char*>(data);
+    while (size > 0) {
+        ssize_t received = ::recv(m_fd, bytes, size, 0);
+        if (received < 0 && errno == EINTR) continue;
+        if (received <= 0) return false;
+        bytes += received;
+        size -= static_cast<size_t>(received);
+    }
+    return true;
+}
+
+void Socket::close() {
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+    if (!m_unixPath.empty()) {
+        ::unlink(m_unixPath.c_str());
+        m_unixPath.clear();
+    }
+}
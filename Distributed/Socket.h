@@ -0,0 +1,58 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#ifndef SOCKET_H
+#define SOCKET_H
+
+#include "RayTracer/RayTracer.h"
+
+/*
+ * Blocking stream socket, TCP or Unix domain. Addresses are "unix:/path/to/socket", "tcp:host:port" or
+ * just "host:port". Setting up throws std::runtime_error, transfers return false once the peer is gone.
+ */
+class Socket {
+public:
+    Socket() = default;
+
+    explicit Socket(int fd) : m_fd(fd) {}
+
+    ~Socket();
+
+    Socket(Socket&& other) noexcept;
+    Socket& operator=(Socket&& other) noexcept;
+
+    Socket(const Socket&) = delete;
+    Socket& operator=(const Socket&) = delete;
+
+    static Socket listen(const std::string& address);
+
+    static Socket connect(const std::string& address);
+
+    // Next pending connection of a listening socket.
+    Socket accept() const;
+
+    // Sends blocked for longer than seconds fail instead, so that sendAll gives up on a peer that stopped reading.
+    bool setSendTimeout(double seconds);
+
+    bool sendAll(const void* data, size_t size);
+
+    bool receiveAll(void* data, size_t size);
+
+    void close();
+
+    inline int fd() const { return m_fd; }
+    inline bool valid() const { return m_fd >= 0; }
+
+private:
+    int m_fd = -1;
+    // Path of a listening Unix socket, removed again on close.
+    std::string m_unixPath = {};
+};
+
+#endif // SOCKET_H
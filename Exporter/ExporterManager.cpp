@@ -7,73 +7,336 @@
  * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
 */
 
+#include <charconv>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "Concurrency/ThreadPool.h"
+
 #include "ExporterManager.h"
+#include "HdrExporter.h"
+#include "TiledImage.h"
 
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h"
 
+namespace {
+    // Bytes of P3 text formatted before each write, keeps the text buffer small for any image size.
+    constexpr size_t TextChunkSize = 1 << 20;
+
+    // Side of the chunks of tiled images written from the framebuffer, readers decode regions in these steps.
+    constexpr size_t TiledChunkSize = 64;
+}
+
 ExporterManager::~ExporterManager() {
     // In case that forget to release file handle.
     if (m_fout != nullptr) {
         m_fout->close();
         m_fout.reset(nullptr);
     }
+    unmap();
 }
 
-void ExporterManager::startWrite(size_t width, size_t height) {
+ExporterManager::FileType ExporterManager::fileTypeOf(const std::string& filename, bool asciiPpm) {
+    auto dot = filename.find_last_of('.');
+    std::string extension = dot == std::string::npos ? "" : filename.substr(dot);
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    if (extension == ".ppm") {
+        return asciiPpm ? PPM_ASCII : PPM;
+    }
+    if (extension == ".pfm") {
+        return PFM;
+    }
+    if (extension == ".hdr") {
+        return HDR;
+    }
+    if (extension == ".exr") {
+        return EXR;
+    }
+    if (extension == ".rtt") {
+        return TILED;
+    }
+    return PNG;
+}
+
+void ExporterManager::startWrite(size_t width, size_t height, bool keepRadiance) {
     m_width = width;
     m_height = height;
-    m_buffer.resize(width * height);
+    m_buffer.resize(3 * width * height);
+    m_radiance.resize(keepRadiance ? 3 * width * height : 0);
+    m_png.reset();
+    unmap();
+}
+
+bool ExporterManager::startMappedWrite(const std::string& filename, FileType type, size_t width, size_t height) {
+    startWrite(0, 0);
+    m_buffer.shrink_to_fit();
+    m_radiance.shrink_to_fit();
+    if (type != PPM && type != PFM) {
+        return false;
+    }
+
+    std::string header = (type == PPM ? "P6\n" : "PF\n") + std::to_string(width) + ' ' + std::to_string(height) +
+                         (type == PPM ? "\n255\n" : "\n-1.0\n");
+    size_t pixelSize = type == PPM ? 3 : 3 * sizeof(float);
+    size_t size = header.size() + pixelSize * width * height;
+
+    // A sparse file of the final size, blocks get allocated as tiles are written.
+    int fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    void* map = MAP_FAILED;
+    if (::ftruncate(fd, static_cast<off_t>(size)) == 0) {
+        map = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ::close(fd); // The mapping keeps the file open.
+    if (map == MAP_FAILED) {
+        return false;
+    }
+
+    m_width = width;
+    m_height = height;
+    m_map = static_cast<unsigned char*>(map);
+    m_mapSize = size;
+    m_mapHeaderSize = header.size();
+    m_mapPixelSize = pixelSize;
+    m_mapType = type;
+    std::memcpy(m_map, header.data(), header.size());
+    return true;
+}
+
+void ExporterManager::unmap() {
+    if (m_map != nullptr) {
+        ::munmap(m_map, m_mapSize);
+        m_map = nullptr;
+    }
+}
+
+void ExporterManager::streamPng() {
+#ifdef RAYTRACER_HAVE_ZLIB
+    m_png = std::make_unique<PngEncoder>(m_width, m_height);
+    m_stripPixels = std::make_unique<std::atomic<size_t>[]>(m_png->stripCount());
+    m_stripTaken = std::make_unique<std::atomic<bool>[]>(m_png->stripCount());
+    for (size_t i = 0; i < m_png->stripCount(); ++i) {
+        m_stripPixels[i] = 0;
+        m_stripTaken[i] = false;
+    }
+#endif
+}
+
+void ExporterManager::markWritten(size_t x, size_t y, size_t width, size_t height) {
+    if (m_map != nullptr) {
+        // Dropping the pages of a shared file mapping keeps their data in the page cache, from where the
+        // kernel writes it back. Pages shared with tiles still in flight simply fault in again.
+        static const size_t pageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        for (size_t j = y; j < y + height; ++j) {
+            size_t begin = mappedOffset(x, j) / pageSize * pageSize;
+            size_t end = std::min(m_mapSize, (mappedOffset(x + width - 1, j) + m_mapPixelSize + pageSize - 1) / pageSize * pageSize);
+            ::madvise(m_map + begin, end - begin, MADV_DONTNEED);
+        }
+        return;
+    }
+    if (m_png == nullptr || height == 0) {
+        return;
+    }
+    size_t stripHeight = m_png->stripHeight();
+    for (size_t strip = y / stripHeight; strip <= (y + height - 1) / stripHeight; ++strip) {
+        size_t first = std::max(y, strip * stripHeight);
+        size_t last = std::min({ y + height, (strip + 1) * stripHeight, m_height });
+        size_t stripRows = std::min((strip + 1) * stripHeight, m_height) - strip * stripHeight;
+        if (m_stripPixels[strip].fetch_add(width * (last - first)) + width * (last - first) == m_width * stripRows) {
+            tryEncodeStrip(strip);
+            tryEncodeStrip(strip + 1);
+        }
+    }
+}
+
+void ExporterManager::rgbRow(size_t row, unsigned char* rgb) const {
+    std::memcpy(rgb, m_buffer.data() + 3 * row * m_width, 3 * m_width);
+}
+
+void ExporterManager::tryEncodeStrip(size_t index) {
+#ifdef RAYTRACER_HAVE_ZLIB
+    auto complete = [this](size_t strip) {
+        size_t stripHeight = m_png->stripHeight();
+        size_t stripRows = std::min((strip + 1) * stripHeight, m_height) - strip * stripHeight;
+        return m_stripPixels[strip].load() == m_width * stripRows;
+    };
+    if (index < m_png->stripCount() && complete(index) && (index == 0 || complete(index - 1)) &&
+        !m_stripTaken[index].exchange(true)) {
+        m_png->encodeStrip(index, [this](size_t row, unsigned char* rgb) { rgbRow(row, rgb); });
+    }
+#endif
 }
 
 bool ExporterManager::endWrite(const std::string& filename, FileType type) {
+    if (m_map != nullptr) {
+        unmap(); // Everything is in the file already.
+        return true;
+    }
+    if (isHdr(type) && m_radiance.size() != 3 * m_width * m_height) {
+        return false; // Not kept by startWrite.
+    }
+
     switch (type) {
         case PPM: {
-            m_fout = std::make_unique<std::ofstream>(filename);
+            m_fout = std::make_unique<std::ofstream>(filename, std::ios::binary);
+
+            auto& fout = *m_fout;
+            if (!fout.is_open()) {
+                return false;
+            }
+
+            // The framebuffer is the P6 payload already.
+            fout << "P6\n" << m_width << ' ' << m_height << "\n255\n";
+            fout.write(reinterpret_cast<const char*>(m_buffer.data()), static_cast<std::streamsize>(m_buffer.size()));
+            bool written = fout.good();
+
+            m_fout->close();
+            m_fout.reset(nullptr);
+
+            return written;
+        }
+        case PPM_ASCII: {
+            m_fout = std::make_unique<std::ofstream>(filename, std::ios::binary);
 
             auto& fout = *m_fout;
             if (!fout.is_open()) {
                 return false;
             }
 
-            fout << "P3\n" <<  m_width << ' ' << m_height << "\n255\n";
-            for (int j = 0; j < m_height; ++j) {
-                for (int i = 0; i < m_width; ++i) {
-                    fout << m_buffer[i + j * m_width] << '\n';
+            // Same text as streaming every pixel, but formatted with to_chars into a chunk buffer.
+            fout << "P3\n" << m_width << ' ' << m_height << "\n255\n";
+            std::vector<char> text(TextChunkSize + 64);
+            char* end = text.data();
+            for (size_t i = 0; i < m_buffer.size(); ++i) {
+                end = std::to_chars(end, text.data() + text.size(), static_cast<int>(m_buffer[i])).ptr;
+                *end++ = i % 3 == 2 ? '\n' : ' ';
+                if (static_cast<size_t>(end - text.data()) >= TextChunkSize) {
+                    fout.write(text.data(), end - text.data());
+                    end = text.data();
                 }
             }
+            fout.write(text.data(), end - text.data());
+            bool written = fout.good();
 
             m_fout->close();
             m_fout.reset(nullptr);
 
-            return true;
+            return written;
         }
         case PNG: {
-            std::vector<unsigned char> buffer(m_width * m_height * 4); // RGBA
-            for (size_t i = 0; i < m_buffer.size(); ++i) {
-                buffer[4 * i] = m_buffer[i].r();
-                buffer[4 * i + 1] = m_buffer[i].g();
-                buffer[4 * i + 2] = m_buffer[i].b();
-                buffer[4 * i + 3] = 255;
+#ifdef RAYTRACER_HAVE_ZLIB
+            // Strips that were not streamed are encoded now, in parallel when there is a pool.
+            if (m_png == nullptr) {
+                streamPng();
             }
-            stbi_write_png(filename.c_str(), m_width, m_height, 4, buffer.data(), 0);
-
-            return true;
+            std::vector<size_t> remaining = {};
+            for (size_t i = 0; i < m_png->stripCount(); ++i) {
+                if (!m_stripTaken[i].exchange(true)) {
+                    remaining.push_back(i);
+                }
+            }
+            auto encode = [this, &remaining](size_t i) {
+                m_png->encodeStrip(remaining[i], [this](size_t row, unsigned char* rgb) { rgbRow(row, rgb); });
+            };
+            if (m_pool != nullptr && remaining.size() > 1) {
+                m_pool->parallelFor(remaining.size(), encode);
+            }
+            else {
+                for (size_t i = 0; i < remaining.size(); ++i) {
+                    encode(i);
+                }
+            }
+            bool written = m_png->write(filename);
+            m_png.reset();
+            return written;
+#else
+            return stbi_write_png(filename.c_str(), m_width, m_height, 3, m_buffer.data(), 0) != 0;
+#endif
+        }
+        case PFM:
+            return writePfm(filename, m_radiance.data(), m_width, m_height);
+        case HDR:
+            return writeRgbe(filename, m_radiance.data(), m_width, m_height);
+        case EXR:
+            return writeExr(filename, m_radiance.data(), m_width, m_height);
+        case TILED: {
+            TiledImageWriter writer = {};
+            if (!writer.open(filename, m_width, m_height)) {
+                return false;
+            }
+            // One chunk per TiledChunkSize square, a row of them per task.
+            size_t columns = (m_width + TiledChunkSize - 1) / TiledChunkSize;
+            size_t rows = (m_height + TiledChunkSize - 1) / TiledChunkSize;
+            auto writeRow = [&](size_t row) {
+                std::vector<float> chunk = {};
+                size_t y = row * TiledChunkSize;
+                size_t height = std::min(TiledChunkSize, m_height - y);
+                for (size_t column = 0; column < columns; ++column) {
+                    size_t x = column * TiledChunkSize;
+                    size_t width = std::min(TiledChunkSize, m_width - x);
+                    chunk.resize(3 * width * height);
+                    for (size_t j = 0; j < height; ++j) {
+                        std::memcpy(chunk.data() + 3 * j * width, m_radiance.data() + 3 * (x + (y + j) * m_width),
+                                    3 * width * sizeof(float));
+                    }
+                    writer.writeChunk(x, y, width, height, chunk.data());
+                }
+            };
+            if (m_pool != nullptr) {
+                m_pool->parallelFor(rows, writeRow);
+            }
+            else {
+                for (size_t row = 0; row < rows; ++row) {
+                    writeRow(row);
+                }
+            }
+            return writer.close();
         }
         default:
             return false;
     }
 }
 
-void ExporterManager::writeColor(size_t x, size_t y, Vector3i color) {
-    m_buffer[x + y * m_width] = color;
+void ExporterManager::writeTile(size_t x, size_t y, size_t width, size_t height, const float* rgb) {
+    for (size_t j = 0; j < height; ++j) {
+        const float* row = rgb + 3 * j * width;
+        if (!m_radiance.empty()) {
+            std::memcpy(m_radiance.data() + 3 * (x + (y + j) * m_width), row, 3 * width * sizeof(float));
+        }
+        if (m_map != nullptr) {
+            if (m_mapType == PFM) {
+                std::memcpy(m_map + mappedOffset(x, y + j), row, 3 * width * sizeof(float));
+            }
+            else {
+                tonemapRow(row, width, x, y + j, m_tonemap, m_map + mappedOffset(x, y + j));
+            }
+        }
+        else {
+            tonemapRow(row, width, x, y + j, m_tonemap, m_buffer.data() + 3 * (x + (y + j) * m_width));
+        }
+    }
 }
 
-void ExporterManager::writeColor(size_t x, size_t y, Vector3d color, bool gammaCorrection) {
-    if (gammaCorrection) {
-        color = { sqrt(color.r()), sqrt(color.g()), sqrt(color.b()) }; // Simple gamma2 correction
+void ExporterManager::preview(size_t width, size_t height, uint8_t* rgb) const {
+    for (size_t j = 0; j < height; ++j) {
+        size_t y = (2 * j + 1) * m_height / (2 * height);
+        for (size_t i = 0; i < width; ++i, rgb += 3) {
+            size_t x = (2 * i + 1) * m_width / (2 * width);
+            if (m_map == nullptr) {
+                std::memcpy(rgb, m_buffer.data() + 3 * (x + y * m_width), 3);
+            }
+            else if (m_mapType == PFM) {
+                tonemapRow(reinterpret_cast<const float*>(m_map + mappedOffset(x, y)), 1, x, y, m_tonemap, rgb);
+            }
+            else {
+                std::memcpy(rgb, m_map + mappedOffset(x, y), 3);
+            }
+        }
     }
-    color *= 254.999;
-    Vector3i rgb = { static_cast<int>(color.r()), static_cast<int>(color.g()), static_cast<int>(color.b()) };
-    writeColor(x, y, rgb);
 }
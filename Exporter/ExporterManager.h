@@ -10,32 +10,118 @@
 #ifndef EXPORTER_MANAGER_H
 #define EXPORTER_MANAGER_H
 
+#include <atomic>
+
+#include "Exporter/PngEncoder.h"
+#include "Exporter/Tonemap.h"
+
 #include "RayTracer/RayTracer.h"
 
+class ThreadPool;
+
 class ExporterManager {
 public:
     using FileType = int;
-    constexpr static FileType PPM = 0;
+    constexpr static FileType PPM = 0; // Binary P6.
     constexpr static FileType PNG = 1;
+    constexpr static FileType PPM_ASCII = 2; // Plain P3, about 4 times larger and much slower to write.
+    // Linear float images, written from the radiance kept by startWrite.
+    constexpr static FileType PFM = 3;
+    constexpr static FileType HDR = 4; // Radiance RGBE.
+    constexpr static FileType EXR = 5; // Half float OpenEXR.
+    constexpr static FileType TILED = 6; // Chunked float tiles, see TiledImage.h.
+
+    // Final 8-bit RGB, 3 bytes per pixel. Cache-line aligned, render threads write their tiles into it
+    // concurrently. Tile columns start every TileScheduler::ColumnAlignment pixels, a whole number of
+    // cache lines, so two tiles share a line only where a row does not start on one.
+    using Buffer = std::vector<uint8_t, AlignedAllocator<uint8_t>>;
+    // Linear RGB floats per pixel, before gamma and clamping.
+    using RadianceBuffer = std::vector<float, AlignedAllocator<float>>;
 
 public:
     ~ExporterManager();
 
-    void startWrite(size_t width, size_t height);
+    // Pick the file type from the extension of filename: .ppm, .pfm, .hdr, .exr, .rtt, and PNG for any other.
+    static FileType fileTypeOf(const std::string& filename, bool asciiPpm = false);
+
+    static inline bool isHdr(FileType type) { return type == PFM || type == HDR || type == EXR || type == TILED; }
+
+    // The float radiance of every pixel is kept as well when keepRadiance is set, the HDR types need it.
+    void startWrite(size_t width, size_t height, bool keepRadiance = false);
+
+    // Write straight into filename through a shared memory mapping instead of a framebuffer, for images
+    // larger than memory. Binary PPM or PFM only. Pixels land at their final place in the file, and
+    // markWritten unmaps finished tiles so that only tiles in flight stay resident. endWrite then just
+    // unmaps the rest. Returns false if the file cannot be created.
+    bool startMappedWrite(const std::string& filename, FileType type, size_t width, size_t height);
 
     bool endWrite(const std::string& filename, FileType type);
 
-    void writeColor(size_t x, size_t y, Vector3i color);
+    // Linear RGB of a rectangle, 3 floats per pixel with rows top first. Kept as radiance when asked for,
+    // and tonemapped into the final 8-bit pixels row by row.
+    void writeTile(size_t x, size_t y, size_t width, size_t height, const float* rgb);
+
+    inline void writeColor(size_t x, size_t y, const Vector3d& color) {
+        float rgb[3] = { static_cast<float>(color.r()), static_cast<float>(color.g()), static_cast<float>(color.b()) };
+        writeTile(x, y, 1, 1, rgb);
+    }
+
+    // Point-sampled width x height 8-bit RGB of the image so far, for live previews. Reads while tiles are
+    // being written, a pixel caught halfway only shows in that one preview.
+    void preview(size_t width, size_t height, uint8_t* rgb) const;
+
+    // Applies to the pixels written from then on.
+    inline void setTonemap(const TonemapSettings& settings) { m_tonemap = settings; }
 
-    void writeColor(size_t x, size_t y, Vector3d color, bool gammaCorrection = true);
+    inline Buffer& buffer() { return m_buffer; }
 
-    inline std::vector<Vector3i>& buffer() { return m_buffer; }
+    inline RadianceBuffer& radiance() { return m_radiance; }
+
+    // Encode the strips of a PNG as soon as markWritten has seen all their pixels, on the thread that
+    // reports the last one, so that endWrite(PNG) is left with stitching. Call after startWrite.
+    void streamPng();
+
+    // Thread-safe, the pixels of the rectangle are final. Encodes completed PNG strips when streaming,
+    // releases the pages of the rectangle when mapped.
+    void markWritten(size_t x, size_t y, size_t width, size_t height);
+
+    // endWrite(PNG) spreads the strips not encoded yet over pool, with the calling thread helping.
+    inline void setThreadPool(ThreadPool* pool) { m_pool = pool; }
+
+private:
+    // Clamped 8-bit RGB of a row, the PNG encoder reads rows through it.
+    void rgbRow(size_t row, unsigned char* rgb) const;
+
+    // Encode strip index unless taken already, once it and the strip above (for filtering) are complete.
+    void tryEncodeStrip(size_t index);
+
+    // Offset of pixel (x, y) in the mapped file, PFM rows go from the bottom up.
+    inline size_t mappedOffset(size_t x, size_t y) const {
+        size_t row = m_mapType == PFM ? m_height - 1 - y : y;
+        return m_mapHeaderSize + m_mapPixelSize * (x + row * m_width);
+    }
+
+    void unmap();
 
 private:
     std::unique_ptr<std::ofstream> m_fout = nullptr;
 
     size_t m_width = 0, m_height = 0;
-    std::vector<Vector3i> m_buffer = {};
+    Buffer m_buffer = {};
+    RadianceBuffer m_radiance = {}; // Empty unless kept.
+    TonemapSettings m_tonemap = {};
+
+    ThreadPool* m_pool = nullptr;
+    std::unique_ptr<PngEncoder> m_png = nullptr;
+    std::unique_ptr<std::atomic<size_t>[]> m_stripPixels = nullptr; // Pixels marked written per strip.
+    std::unique_ptr<std::atomic<bool>[]> m_stripTaken = nullptr;
+
+    // Destination file when mapped, null otherwise.
+    unsigned char* m_map = nullptr;
+    size_t m_mapSize = 0;
+    size_t m_mapHeaderSize = 0;
+    size_t m_mapPixelSize = 0;
+    FileType m_mapType = PPM;
 };
 
 #endif // EXPORTER_MANAGER_H
\ No newline at end of file
@@ -0,0 +1,272 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#include <cstring>
+
+#if defined(__F16C__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#ifdef RAYTRACER_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "HdrExporter.h"
+
+namespace {
+    inline uint32_t bitsOf(float value) {
+        uint32_t bits = 0;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    inline float floatOf(uint32_t bits) {
+        float value = 0.0f;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    // Constants of the conversion, see floatToHalf below.
+    constexpr uint32_t F32Infinity = 255u << 23;
+    constexpr uint32_t F16Overflow = (127u + 16u) << 23; // 65536, rounds to infinity from here on.
+    constexpr uint32_t F16MinNormal = 113u << 23;        // 2^-14, smaller values become denormals.
+    constexpr uint32_t DenormMagic = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+    constexpr uint32_t RebiasRound = 0xc8000fffu;        // ((15 - 127) << 23) + 0xfff, wraps around.
+
+    // Branch-free apart from the selects, rounds to nearest even by adding 0xfff plus the lowest kept bit.
+    inline uint16_t floatToHalf(float value) {
+        uint32_t f = bitsOf(value);
+        uint32_t sign = f & 0x80000000u;
+        f ^= sign;
+
+        uint32_t half = 0;
+        if (f >= F16Overflow) {
+            half = f > F32Infinity ? 0x7e00u : 0x7c00u;
+        }
+        else if (f < F16MinNormal) {
+            // The float adder aligns the mantissa and rounds it for us.
+            half = bitsOf(floatOf(f) + floatOf(DenormMagic)) - DenormMagic;
+        }
+        else {
+            uint32_t mantissaOdd = (f >> 13) & 1u;
+            half = (f + RebiasRound + mantissaOdd) >> 13;
+        }
+        return static_cast<uint16_t>(half | (sign >> 16));
+    }
+
+#if !defined(__F16C__) && defined(__SSE2__)
+    // The scalar conversion above on 4 lanes, the selects become masks. Magnitudes are below 2^31, so
+    // the signed compares of SSE2 are fine.
+    inline __m128i floatToHalf4(__m128 value, __m128i& sign) {
+        __m128i f = _mm_castps_si128(value);
+        sign = _mm_and_si128(f, _mm_set1_epi32(static_cast<int>(0x80000000u)));
+        f = _mm_xor_si128(f, sign);
+
+        __m128i overflow = _mm_cmpgt_epi32(f, _mm_set1_epi32(static_cast<int>(F16Overflow - 1)));
+        __m128i nan = _mm_cmpgt_epi32(f, _mm_set1_epi32(static_cast<int>(F32Infinity)));
+        __m128i infinityOrNan = _mm_or_si128(_mm_set1_epi32(0x7c00), _mm_and_si128(nan, _mm_set1_epi32(0x0200)));
+
+        __m128i denormal = _mm_cmplt_epi32(f, _mm_set1_epi32(static_cast<int>(F16MinNormal)));
+        __m128 magic = _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(DenormMagic)));
+        __m128i denormalHalf = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(f), magic)),
+                                             _mm_set1_epi32(static_cast<int>(DenormMagic)));
+
+        __m128i mantissaOdd = _mm_and_si128(_mm_srli_epi32(f, 13), _mm_set1_epi32(1));
+        __m128i normalHalf = _mm_add_epi32(f, _mm_set1_epi32(static_cast<int>(RebiasRound)));
+        normalHalf = _mm_srli_epi32(_mm_add_epi32(normalHalf, mantissaOdd), 13);
+
+        __m128i half = _mm_or_si128(_mm_and_si128(denormal, denormalHalf), _mm_andnot_si128(denormal, normalHalf));
+        return _mm_or_si128(_mm_and_si128(overflow, infinityOrNan), _mm_andnot_si128(overflow, half));
+    }
+#endif
+
+    void appendBytes(std::vector<char>& out, const void* data, size_t size) {
+        const char* bytes = static_cast<const char*>(data);
+        out.insert(out.end(), bytes, bytes + size);
+    }
+
+    template<typename T>
+    void append(std::vector<char>& out, T value) {
+        appendBytes(out, &value, sizeof(T));
+    }
+
+    // Name, type, size and value of an EXR header attribute.
+    void appendAttribute(std::vector<char>& out, const char* name, const char* type, const void* value, int32_t size) {
+        appendBytes(out, name, std::strlen(name) + 1);
+        appendBytes(out, type, std::strlen(type) + 1);
+        append(out, size);
+        appendBytes(out, value, size);
+    }
+
+    bool writeFile(const std::string& filename, const std::string& header, const void* data, size_t size) {
+        std::ofstream fout(filename, std::ios::binary);
+        if (!fout.is_open()) {
+            return false;
+        }
+        fout.write(header.data(), static_cast<std::streamsize>(header.size()));
+        fout.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+        return fout.good();
+    }
+
+#ifdef RAYTRACER_HAVE_ZLIB
+    // EXR ZIP block: bytes split into even and odd halves, delta coded, then deflated at the fastest
+    // level, which is 3 times faster than the default for 4 % more bytes on rendered noise. Returns false
+    // when that does not make the block smaller, the block is stored raw then.
+    bool zipBlock(const std::vector<char>& raw, std::vector<char>& packed) {
+        std::vector<unsigned char> shuffled(raw.size());
+        size_t half = (raw.size() + 1) / 2;
+        for (size_t i = 0; i < raw.size(); ++i) {
+            shuffled[i % 2 == 0 ? i / 2 : half + i / 2] = static_cast<unsigned char>(raw[i]);
+        }
+        for (size_t i = shuffled.size() - 1; i > 0; --i) {
+            shuffled[i] = static_cast<unsigned char>(shuffled[i] - shuffled[i - 1] + 128);
+        }
+
+        uLongf packedSize = compressBound(static_cast<uLong>(shuffled.size()));
+        packed.resize(packedSize);
+        if (compress2(reinterpret_cast<Bytef*>(packed.data()), &packedSize, shuffled.data(),
+                      static_cast<uLong>(shuffled.size()), Z_BEST_SPEED) != Z_OK ||
+            packedSize >= raw.size()) {
+            return false;
+        }
+        packed.resize(packedSize);
+        return true;
+    }
+#endif
+}
+
+void floatToHalf(const float* src, uint16_t* dst, size_t count) {
+    size_t i = 0;
+#if defined(__F16C__)
+    for (; i + 8 <= count; i += 8) {
+        __m128i low = _mm_cvtps_ph(_mm_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+        __m128i high = _mm_cvtps_ph(_mm_loadu_ps(src + i + 4), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi64(low, high));
+    }
+#elif defined(__SSE2__)
+    for (; i + 8 <= count; i += 8) {
+        __m128i lowSign, highSign;
+        __m128i low = floatToHalf4(_mm_loadu_ps(src + i), lowSign);
+        __m128i high = floatToHalf4(_mm_loadu_ps(src + i + 4), highSign);
+        // Halves are at most 0x7e00 and fit the signed saturation, the arithmetic shift turns a sign into
+        // 0xffff8000, which saturates to exactly 0x8000.
+        __m128i halves = _mm_packs_epi32(low, high);
+        __m128i signs = _mm_packs_epi32(_mm_srai_epi32(lowSign, 16), _mm_srai_epi32(highSign, 16));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_or_si128(halves, signs));
+    }
+#endif
+    for (; i < count; ++i) {
+        dst[i] = floatToHalf(src[i]);
+    }
+}
+
+bool writePfm(const std::string& filename, const float* radiance, size_t width, size_t height) {
+    // Rows go from the bottom up, a negative scale means little-endian.
+    std::vector<float> rows(3 * width * height);
+    for (size_t j = 0; j < height; ++j) {
+        std::memcpy(rows.data() + 3 * width * j, radiance + 3 * width * (height - 1 - j), 3 * width * sizeof(float));
+    }
+    std::string header = "PF\n" + std::to_string(width) + ' ' + std::to_string(height) + "\n-1.0\n";
+    return writeFile(filename, header, rows.data(), rows.size() * sizeof(float));
+}
+
+bool writeRgbe(const std::string& filename, const float* radiance, size_t width, size_t height) {
+    std::vector<unsigned char> pixels(4 * width * height);
+    for (size_t i = 0; i < width * height; ++i) {
+        const float* rgb = radiance + 3 * i;
+        unsigned char* rgbe = pixels.data() + 4 * i;
+        float maxComponent = std::max({ rgb[0], rgb[1], rgb[2] });
+        if (!(maxComponent > 1e-32f)) {
+            std::memset(rgbe, 0, 4);
+            continue;
+        }
+        int exponent = 0;
+        float scale = std::frexp(maxComponent, &exponent) * 256.0f / maxComponent;
+        for (int c = 0; c < 3; ++c) {
+            rgbe[c] = static_cast<unsigned char>(std::clamp(rgb[c] * scale, 0.0f, 255.0f));
+        }
+        rgbe[3] = static_cast<unsigned char>(std::clamp(exponent + 128, 0, 255));
+    }
+    std::string header = "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y " + std::to_string(height) +
+                         " +X " + std::to_string(width) + "\n";
+    return writeFile(filename, header, pixels.data(), pixels.size());
+}
+
+bool writeExr(const std::string& filename, const float* radiance, size_t width, size_t height, bool zip) {
+#ifndef RAYTRACER_HAVE_ZLIB
+    zip = false;
+#endif
+    const int32_t blockHeight = zip ? 16 : 1;
+    const uint8_t compression = zip ? 3 : 0; // ZIP_COMPRESSION or NO_COMPRESSION.
+    const size_t blockCount = (height + blockHeight - 1) / blockHeight;
+
+    std::vector<char> header = {};
+    append<int32_t>(header, 20000630); // Magic number.
+    append<int32_t>(header, 2);        // Version 2, single-part scanline image.
+
+    // Channels are stored in alphabetical order.
+    std::vector<char> channels = {};
+    for (const char* name : { "B", "G", "R" }) {
+        appendBytes(channels, name, 2);
+        append<int32_t>(channels, 1); // HALF
+        append<uint32_t>(channels, 0); // pLinear and reserved bytes.
+        append<int32_t>(channels, 1);
+        append<int32_t>(channels, 1);
+    }
+    channels.push_back('\0');
+    appendAttribute(header, "channels", "chlist", channels.data(), static_cast<int32_t>(channels.size()));
+    appendAttribute(header, "compression", "compression", &compression, 1);
+    int32_t window[4] = { 0, 0, static_cast<int32_t>(width) - 1, static_cast<int32_t>(height) - 1 };
+    appendAttribute(header, "dataWindow", "box2i", window, sizeof(window));
+    appendAttribute(header, "displayWindow", "box2i", window, sizeof(window));
+    uint8_t lineOrder = 0; // INCREASING_Y
+    appendAttribute(header, "lineOrder", "lineOrder", &lineOrder, 1);
+    float one = 1.0f;
+    appendAttribute(header, "pixelAspectRatio", "float", &one, sizeof(one));
+    float center[2] = { 0.0f, 0.0f };
+    appendAttribute(header, "screenWindowCenter", "v2f", center, sizeof(center));
+    appendAttribute(header, "screenWindowWidth", "float", &one, sizeof(one));
+    header.push_back('\0');
+
+    // Chunks follow the offset table, each is its first scanline, its size and the block data.
+    std::vector<char> chunks = {};
+    std::vector<uint64_t> offsets = {};
+    uint64_t chunkStart = header.size() + blockCount * sizeof(uint64_t);
+
+    std::vector<float> planar(3 * width);
+    std::vector<char> block = {};
+    std::vector<char> packed = {};
+    for (size_t first = 0; first < height; first += blockHeight) {
+        size_t last = std::min(height, first + blockHeight);
+        block.resize(3 * width * (last - first) * sizeof(uint16_t));
+        for (size_t j = first; j < last; ++j) {
+            const float* row = radiance + 3 * width * j;
+            for (size_t i = 0; i < width; ++i) {
+                planar[i] = row[3 * i + 2];
+                planar[width + i] = row[3 * i + 1];
+                planar[2 * width + i] = row[3 * i];
+            }
+            floatToHalf(planar.data(), reinterpret_cast<uint16_t*>(block.data()) + 3 * width * (j - first), 3 * width);
+        }
+
+        const std::vector<char>* data = &block;
+#ifdef RAYTRACER_HAVE_ZLIB
+        if (zip && zipBlock(block, packed)) {
+            data = &packed;
+        }
+#endif
+        offsets.push_back(chunkStart + chunks.size());
+        append<int32_t>(chunks, static_cast<int32_t>(first));
+        append<int32_t>(chunks, static_cast<int32_t>(data->size()));
+        chunks.insert(chunks.end(), data->begin(), data->end());
+    }
+
+    appendBytes(header, offsets.data(), offsets.size() * sizeof(uint64_t));
+    return writeFile(filename, std::string(header.begin(), header.end()), chunks.data(), chunks.size());
+}
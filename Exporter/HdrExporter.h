@@ -0,0 +1,36 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#ifndef HDR_EXPORTER_H
+#define HDR_EXPORTER_H
+
+#include <cstdint>
+
+#include "RayTracer/RayTracer.h"
+
+/*
+ * Writers of linear float images, for grading and compositing without re-rendering. The radiance is
+ * 3 floats (RGB) per pixel with the top row first. All files are little-endian like the host.
+ */
+
+// Portable float map, 32-bit float RGB.
+bool writePfm(const std::string& filename, const float* radiance, size_t width, size_t height);
+
+// Radiance .hdr, shared-exponent RGBE in flat (not run-length encoded) scanlines.
+bool writeRgbe(const std::string& filename, const float* radiance, size_t width, size_t height);
+
+// Single-part scanline OpenEXR with half float R, G, B channels, ZIP compressed in blocks of 16
+// scanlines when zip is set and zlib is available, uncompressed otherwise.
+bool writeExr(const std::string& filename, const float* radiance, size_t width, size_t height, bool zip = true);
+
+// IEEE half floats rounded to nearest even, overflow goes to infinity and NaN stays NaN.
+// Converts 8 values per step with SSE2 where available.
+void floatToHalf(const float* src, uint16_t* dst, size_t count);
+
+#endif // HDR_EXPORTER_H
@@ -0,0 +1,179 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#ifdef RAYTRACER_HAVE_ZLIB
+
+#include <cstring>
+
+#include <zlib.h>
+
+#include "PngEncoder.h"
+
+namespace {
+    // Filtered bytes per strip, small enough to spread 4K frames over tens of threads and large enough
+    // that restarting the deflate window at every strip costs well below 1 % of the file size.
+    constexpr size_t StripBytes = 256 * 1024;
+
+    constexpr int CompressionLevel = 3;
+
+    inline int paeth(int a, int b, int c) {
+        int p = a + b - c;
+        int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+        return pa <= pb && pa <= pc ? a : (pb <= pc ? b : c);
+    }
+
+    // Filter a row with all five PNG filters and keep the one of smallest absolute signed sum, the
+    // usual heuristic of libpng and stb. out gets the filter type byte and the filtered row.
+    void filterRow(const unsigned char* row, const unsigned char* above, size_t size, unsigned char* out,
+                   std::vector<unsigned char>& scratch) {
+        constexpr size_t Bpp = 3;
+        scratch.resize(5 * size);
+        unsigned char* none = scratch.data();
+        unsigned char* sub = none + size;
+        unsigned char* up = sub + size;
+        unsigned char* average = up + size;
+        unsigned char* paethed = average + size;
+
+        // One plain loop per filter, the first pixel has no left neighbor.
+        std::memcpy(none, row, size);
+        for (size_t i = 0; i < Bpp; ++i) {
+            sub[i] = row[i];
+            up[i] = static_cast<unsigned char>(row[i] - above[i]);
+            average[i] = static_cast<unsigned char>(row[i] - (above[i] >> 1));
+            paethed[i] = static_cast<unsigned char>(row[i] - above[i]);
+        }
+        for (size_t i = Bpp; i < size; ++i) {
+            sub[i] = static_cast<unsigned char>(row[i] - row[i - Bpp]);
+        }
+        for (size_t i = Bpp; i < size; ++i) {
+            up[i] = static_cast<unsigned char>(row[i] - above[i]);
+        }
+        for (size_t i = Bpp; i < size; ++i) {
+            average[i] = static_cast<unsigned char>(row[i] - ((row[i - Bpp] + above[i]) >> 1));
+        }
+        for (size_t i = Bpp; i < size; ++i) {
+            paethed[i] = static_cast<unsigned char>(row[i] - paeth(row[i - Bpp], above[i], above[i - Bpp]));
+        }
+
+        int bestType = 0;
+        uint32_t bestCost = std::numeric_limits<uint32_t>::max();
+        for (int type = 0; type < 5; ++type) {
+            const unsigned char* filtered = scratch.data() + type * size;
+            uint32_t cost = 0;
+            for (size_t i = 0; i < size; ++i) {
+                cost += static_cast<uint32_t>(std::abs(static_cast<signed char>(filtered[i])));
+            }
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestType = type;
+            }
+        }
+        out[0] = static_cast<unsigned char>(bestType);
+        std::memcpy(out + 1, scratch.data() + bestType * size, size);
+    }
+
+    void appendBigEndian(std::vector<unsigned char>& out, uint32_t value) {
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            out.push_back(static_cast<unsigned char>(value >> shift));
+        }
+    }
+
+    void writeChunk(std::ofstream& fout, const char* type, const unsigned char* data, size_t size) {
+        std::vector<unsigned char> header = {};
+        appendBigEndian(header, static_cast<uint32_t>(size));
+        header.insert(header.end(), type, type + 4);
+        uLong crc = crc32(0L, header.data() + 4, 4);
+        if (size > 0) {
+            crc = crc32(crc, data, static_cast<uInt>(size));
+        }
+        std::vector<unsigned char> footer = {};
+        appendBigEndian(footer, static_cast<uint32_t>(crc));
+
+        fout.write(reinterpret_cast<const char*>(header.data()), static_cast<std::streamsize>(header.size()));
+        fout.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(size));
+        fout.write(reinterpret_cast<const char*>(footer.data()), static_cast<std::streamsize>(footer.size()));
+    }
+}
+
+PngEncoder::PngEncoder(size_t width, size_t height) : m_width(width), m_height(height) {
+    m_stripHeight = std::max<size_t>(1, StripBytes / (3 * width + 1));
+    m_strips.resize((height + m_stripHeight - 1) / m_stripHeight);
+}
+
+void PngEncoder::encodeStrip(size_t index, const RowSource& rows) {
+    size_t rowSize = 3 * m_width;
+    size_t first = index * m_stripHeight;
+    size_t last = std::min(m_height, first + m_stripHeight);
+
+    std::vector<unsigned char> filtered((last - first) * (rowSize + 1));
+    std::vector<unsigned char> above(rowSize, 0), row(rowSize), scratch = {};
+    if (first > 0) {
+        rows(first - 1, above.data());
+    }
+    for (size_t j = first; j < last; ++j) {
+        rows(j, row.data());
+        filterRow(row.data(), above.data(), rowSize, filtered.data() + (j - first) * (rowSize + 1), scratch);
+        std::swap(row, above);
+    }
+
+    // Raw deflate without zlib framing. Every strip but the last ends with a sync flush, which closes
+    // the last block on a byte boundary without marking it final, so the segments can be concatenated.
+    z_stream stream = {};
+    deflateInit2(&stream, CompressionLevel, Z_DEFLATED, -15, 8, Z_FILTERED);
+    auto& strip = m_strips[index];
+    strip.deflated.resize(deflateBound(&stream, static_cast<uLong>(filtered.size())) + 16);
+    stream.next_in = filtered.data();
+    stream.avail_in = static_cast<uInt>(filtered.size());
+    stream.next_out = strip.deflated.data();
+    stream.avail_out = static_cast<uInt>(strip.deflated.size());
+    deflate(&stream, index + 1 == m_strips.size() ? Z_FINISH : Z_SYNC_FLUSH);
+    strip.deflated.resize(stream.total_out);
+    strip.deflated.shrink_to_fit(); // Held until write, the bound is about the size of the raw rows.
+    deflateEnd(&stream);
+
+    strip.adler = static_cast<uint32_t>(adler32(adler32(0L, Z_NULL, 0), filtered.data(), static_cast<uInt>(filtered.size())));
+    strip.filteredSize = filtered.size();
+    strip.encoded = true;
+}
+
+bool PngEncoder::write(const std::string& filename) const {
+    std::ofstream fout(filename, std::ios::binary);
+    if (!fout.is_open()) {
+        return false;
+    }
+
+    static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    fout.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+    std::vector<unsigned char> header = {};
+    appendBigEndian(header, static_cast<uint32_t>(m_width));
+    appendBigEndian(header, static_cast<uint32_t>(m_height));
+    header.insert(header.end(), { 8, 2, 0, 0, 0 }); // 8-bit RGB, deflate, adaptive filtering, no interlace.
+    writeChunk(fout, "IHDR", header.data(), header.size());
+
+    // One IDAT per strip, the zlib header goes in front of the first and the checksum behind the last.
+    static const unsigned char zlibHeader[2] = { 0x78, 0x9c };
+    writeChunk(fout, "IDAT", zlibHeader, sizeof(zlibHeader));
+    uLong adler = adler32(0L, Z_NULL, 0);
+    for (const auto& strip : m_strips) {
+        if (!strip.encoded) {
+            return false;
+        }
+        writeChunk(fout, "IDAT", strip.deflated.data(), strip.deflated.size());
+        adler = adler32_combine(adler, strip.adler, static_cast<z_off_t>(strip.filteredSize));
+    }
+    std::vector<unsigned char> checksum = {};
+    appendBigEndian(checksum, static_cast<uint32_t>(adler));
+    writeChunk(fout, "IDAT", checksum.data(), checksum.size());
+
+    writeChunk(fout, "IEND", nullptr, 0);
+    return fout.good();
+}
+
+#endif // RAYTRACER_HAVE_ZLIB
@@ -0,0 +1,56 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#ifndef PNG_ENCODER_H
+#define PNG_ENCODER_H
+
+#include <atomic>
+
+#include "RayTracer/RayTracer.h"
+
+/*
+ * 8-bit RGB PNG encoder that filters and deflates horizontal strips of the image independently, so
+ * that strips can be encoded on any threads, in any order and as soon as their rows are final. Each
+ * strip becomes its own raw deflate segment ending on a byte boundary, write() stitches them into one
+ * zlib stream behind a single header and combines their Adler-32 checksums. Needs zlib.
+ */
+class PngEncoder {
+public:
+    // Fills the 3 * width bytes of an image row.
+    using RowSource = std::function<void(size_t row, unsigned char* rgb)>;
+
+    PngEncoder(size_t width, size_t height);
+
+    inline size_t stripCount() const { return m_strips.size(); }
+
+    inline size_t stripHeight() const { return m_stripHeight; }
+
+    // Thread-safe for distinct strips. Reads the rows of the strip and the row above it, for filtering.
+    void encodeStrip(size_t index, const RowSource& rows);
+
+    inline bool encoded(size_t index) const { return m_strips[index].encoded; }
+
+    // Needs every strip encoded.
+    bool write(const std::string& filename) const;
+
+private:
+    struct Strip {
+        std::vector<unsigned char> deflated = {};
+        uint32_t adler = 0;
+        size_t filteredSize = 0;
+        bool encoded = false;
+    };
+
+private:
+    size_t m_width = 0, m_height = 0;
+    size_t m_stripHeight = 1;
+    std::vector<Strip> m_strips = {};
+};
+
+#endif // PNG_ENCODER_H
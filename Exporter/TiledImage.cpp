@@ -0,0 +1,419 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#include <cstring>
+#include <stdexcept>
+
+#ifdef RAYTRACER_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "ExporterManager.h"
+#include "TiledImage.h"
+
+namespace {
+    constexpr char FileMagic[8] = { 'R', 'T', 'T', 'I', 'L', 'E', 'S', '\0' };
+    constexpr char IndexMagic[8] = { 'R', 'T', 'I', 'N', 'D', 'E', 'X', '\0' };
+    constexpr uint32_t FormatVersion = 1;
+
+    constexpr size_t FileHeaderSize = sizeof(FileMagic) + 3 * sizeof(uint32_t);
+    constexpr size_t ChunkHeaderSize = 4 * sizeof(uint32_t) + sizeof(uint8_t) + 2 * sizeof(uint64_t);
+    constexpr size_t TrailerSize = sizeof(uint64_t) + sizeof(IndexMagic);
+
+    constexpr uint8_t RawChunk = 0;
+    constexpr uint8_t DeflatedChunk = 1;
+
+    // Rows per band when converting, bounds the decoded floats to a few chunk rows.
+    constexpr size_t ConvertBandRows = 256;
+    // Side of the chunks of a converted tiled image, as ExporterManager writes them.
+    constexpr size_t ConvertChunkSize = 64;
+    // Types without a writer that takes rows are converted through a whole framebuffer, 15 bytes per
+    // pixel with the radiance kept for HDR types, so their crops are limited to 4 GB of it.
+    constexpr size_t MaxBufferedConvertPixels = size_t(1) << 28;
+
+    template<typename T>
+    void put(std::string& out, T value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template<typename T>
+    T get(const char*& in) {
+        T value = {};
+        std::memcpy(&value, in, sizeof(T));
+        in += sizeof(T);
+        return value;
+    }
+
+    // Bytes of the floats grouped by significance, then byte deltas: exponents and high mantissa bytes
+    // of neighboring pixels are close, so the planes turn into long runs of small values for deflate.
+    std::string shuffleFloats(const float* values, size_t count) {
+        const auto* bytes = reinterpret_cast<const unsigned char*>(values);
+        std::string shuffled(count * sizeof(float), '\0');
+        for (size_t i = 0; i < count; ++i) {
+            for (size_t b = 0; b < sizeof(float); ++b) {
+                shuffled[b * count + i] = static_cast<char>(bytes[i * sizeof(float) + b]);
+            }
+        }
+        for (size_t i = shuffled.size() - 1; i > 0; --i) {
+            shuffled[i] = static_cast<char>(shuffled[i] - shuffled[i - 1]);
+        }
+        return shuffled;
+    }
+
+    void unshuffleFloats(std::string& shuffled, float* values, size_t count) {
+        for (size_t i = 1; i < shuffled.size(); ++i) {
+            shuffled[i] = static_cast<char>(shuffled[i] + shuffled[i - 1]);
+        }
+        auto* bytes = reinterpret_cast<unsigned char*>(values);
+        for (size_t i = 0; i < count; ++i) {
+            for (size_t b = 0; b < sizeof(float); ++b) {
+                bytes[i * sizeof(float) + b] = static_cast<unsigned char>(shuffled[b * count + i]);
+            }
+        }
+    }
+
+    bool overlaps(const TiledChunk& chunk, const ImageRegion& region) {
+        return chunk.x < region.x + region.width && region.x < chunk.x + chunk.width &&
+               chunk.y < region.y + region.height && region.y < chunk.y + chunk.height;
+    }
+}
+
+TiledImageWriter::~TiledImageWriter() {
+    close();
+}
+
+bool TiledImageWriter::open(const std::string& filename, size_t width, size_t height, bool compress) {
+    close();
+    m_fout = std::make_unique<std::ofstream>(filename, std::ios::binary);
+    if (!m_fout->is_open()) {
+        m_fout.reset(nullptr);
+        return false;
+    }
+
+    std::string header(FileMagic, sizeof(FileMagic));
+    put<uint32_t>(header, FormatVersion);
+    put<uint32_t>(header, static_cast<uint32_t>(width));
+    put<uint32_t>(header, static_cast<uint32_t>(height));
+    m_fout->write(header.data(), static_cast<std::streamsize>(header.size()));
+
+    m_index.clear();
+    m_end = header.size();
+    m_compress = compress;
+    return m_fout->good();
+}
+
+void TiledImageWriter::writeChunk(size_t x, size_t y, size_t width, size_t height, const float* rgb) {
+    size_t count = 3 * width * height;
+    size_t rawSize = count * sizeof(float);
+    uint8_t compression = RawChunk;
+    std::string stored = {};
+#ifdef RAYTRACER_HAVE_ZLIB
+    if (m_compress) {
+        std::string shuffled = shuffleFloats(rgb, count);
+        uLongf storedSize = compressBound(static_cast<uLong>(shuffled.size()));
+        stored.resize(storedSize);
+        if (compress2(reinterpret_cast<Bytef*>(stored.data()), &storedSize,
+                      reinterpret_cast<const Bytef*>(shuffled.data()), static_cast<uLong>(shuffled.size()),
+                      Z_BEST_SPEED) == Z_OK && storedSize < rawSize) {
+            stored.resize(storedSize);
+            compression = DeflatedChunk;
+        }
+    }
+#endif
+    if (compression == RawChunk) {
+        stored.assign(reinterpret_cast<const char*>(rgb), rawSize);
+    }
+
+    TiledChunk chunk = { static_cast<uint32_t>(x), static_cast<uint32_t>(y),
+                         static_cast<uint32_t>(width), static_cast<uint32_t>(height), 0 };
+    std::string header = {};
+    put<uint32_t>(header, chunk.x);
+    put<uint32_t>(header, chunk.y);
+    put<uint32_t>(header, chunk.width);
+    put<uint32_t>(header, chunk.height);
+    put<uint8_t>(header, compression);
+    put<uint64_t>(header, rawSize);
+    put<uint64_t>(header, stored.size());
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_fout == nullptr) return;
+    chunk.offset = m_end;
+    m_fout->write(header.data(), static_cast<std::streamsize>(header.size()));
+    m_fout->write(stored.data(), static_cast<std::streamsize>(stored.size()));
+    m_end += header.size() + stored.size();
+    m_index.push_back(chunk);
+}
+
+bool TiledImageWriter::close() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_fout == nullptr) {
+        return false;
+    }
+
+    std::string index = {};
+    put<uint64_t>(index, m_index.size());
+    for (const auto& chunk : m_index) {
+        put<uint32_t>(index, chunk.x);
+        put<uint32_t>(index, chunk.y);
+        put<uint32_t>(index, chunk.width);
+        put<uint32_t>(index, chunk.height);
+        put<uint64_t>(index, chunk.offset);
+    }
+    put<uint64_t>(index, m_end);
+    index.append(IndexMagic, sizeof(IndexMagic));
+    m_fout->write(index.data(), static_cast<std::streamsize>(index.size()));
+
+    bool written = m_fout->good();
+    m_fout->close();
+    m_fout.reset(nullptr);
+    m_index.clear();
+    return written;
+}
+
+TiledImageReader::TiledImageReader(const std::string& filename) : m_fin(filename, std::ios::binary), m_filename(filename) {
+    if (!m_fin.is_open()) {
+        throw std::runtime_error("Cannot read " + filename + ".");
+    }
+    m_fin.seekg(0, std::ios::end);
+    auto fileSize = static_cast<uint64_t>(m_fin.tellg());
+    m_fin.seekg(0);
+
+    char header[FileHeaderSize] = {};
+    m_fin.read(header, sizeof(header));
+    const char* in = header + sizeof(FileMagic);
+    if (!m_fin || std::memcmp(header, FileMagic, sizeof(FileMagic)) != 0 || get<uint32_t>(in) != FormatVersion) {
+        throw std::runtime_error(filename + " is no tiled image.");
+    }
+    m_width = get<uint32_t>(in);
+    m_height = get<uint32_t>(in);
+
+    // The index is found through the trailer at the very end.
+    char trailer[TrailerSize] = {};
+    if (fileSize >= FileHeaderSize + TrailerSize) {
+        m_fin.seekg(static_cast<std::streamoff>(fileSize - TrailerSize));
+        m_fin.read(trailer, sizeof(trailer));
+    }
+    in = trailer;
+    uint64_t indexOffset = get<uint64_t>(in);
+    if (!m_fin || std::memcmp(in, IndexMagic, sizeof(IndexMagic)) != 0 || indexOffset < FileHeaderSize ||
+        indexOffset + sizeof(uint64_t) + TrailerSize > fileSize) {
+        m_fin.clear();
+        walkChunks(fileSize);
+        return;
+    }
+
+    constexpr size_t EntrySize = 4 * sizeof(uint32_t) + sizeof(uint64_t);
+    std::string index(fileSize - TrailerSize - indexOffset, '\0');
+    m_fin.seekg(static_cast<std::streamoff>(indexOffset));
+    m_fin.read(index.data(), static_cast<std::streamsize>(index.size()));
+    in = index.data();
+    uint64_t count = get<uint64_t>(in);
+    if (!m_fin || count != (index.size() - sizeof(uint64_t)) / EntrySize) {
+        throw std::runtime_error(filename + " has a damaged chunk index.");
+    }
+    m_index.resize(count);
+    for (auto& chunk : m_index) {
+        chunk.x = get<uint32_t>(in);
+        chunk.y = get<uint32_t>(in);
+        chunk.width = get<uint32_t>(in);
+        chunk.height = get<uint32_t>(in);
+        chunk.offset = get<uint64_t>(in);
+    }
+}
+
+void TiledImageReader::walkChunks(uint64_t fileSize) {
+    uint64_t offset = FileHeaderSize;
+    while (offset + ChunkHeaderSize <= fileSize) {
+        char header[ChunkHeaderSize] = {};
+        m_fin.seekg(static_cast<std::streamoff>(offset));
+        m_fin.read(header, sizeof(header));
+        const char* in = header;
+        TiledChunk chunk = {};
+        chunk.x = get<uint32_t>(in);
+        chunk.y = get<uint32_t>(in);
+        chunk.width = get<uint32_t>(in);
+        chunk.height = get<uint32_t>(in);
+        chunk.offset = offset;
+        in += sizeof(uint8_t) + sizeof(uint64_t);
+        uint64_t storedSize = get<uint64_t>(in);
+        if (!m_fin || chunk.width == 0 || chunk.height == 0 || storedSize > fileSize - offset - ChunkHeaderSize) {
+            break;
+        }
+        m_index.push_back(chunk);
+        offset += ChunkHeaderSize + storedSize;
+    }
+    m_fin.clear();
+}
+
+void TiledImageReader::readRegion(const ImageRegion& region, float* rgb) {
+    std::fill(rgb, rgb + 3 * region.width * region.height, 0.0f);
+
+    std::vector<float> pixels = {};
+    std::string stored = {};
+    for (const auto& chunk : m_index) {
+        if (!overlaps(chunk, region)) continue;
+
+        char header[ChunkHeaderSize] = {};
+        m_fin.seekg(static_cast<std::streamoff>(chunk.offset));
+        m_fin.read(header, sizeof(header));
+        const char* in = header + 4 * sizeof(uint32_t);
+        auto compression = get<uint8_t>(in);
+        auto rawSize = get<uint64_t>(in);
+        auto storedSize = get<uint64_t>(in);
+        size_t count = 3 * static_cast<size_t>(chunk.width) * chunk.height;
+        if (!m_fin || rawSize != count * sizeof(float) || chunk.x + chunk.width > m_width ||
+            chunk.y + chunk.height > m_height || storedSize > rawSize || (compression == RawChunk && storedSize != rawSize)) {
+            throw std::runtime_error(m_filename + " has a damaged chunk at offset " + std::to_string(chunk.offset) + ".");
+        }
+        stored.resize(storedSize);
+        m_fin.read(stored.data(), static_cast<std::streamsize>(storedSize));
+        if (!m_fin) {
+            throw std::runtime_error(m_filename + " ends inside the chunk at offset " + std::to_string(chunk.offset) + ".");
+        }
+
+        pixels.resize(count);
+        if (compression == RawChunk) {
+            std::memcpy(pixels.data(), stored.data(), rawSize);
+        }
+        else {
+#ifdef RAYTRACER_HAVE_ZLIB
+            std::string shuffled(rawSize, '\0');
+            uLongf inflatedSize = static_cast<uLongf>(rawSize);
+            if (compression != DeflatedChunk ||
+                uncompress(reinterpret_cast<Bytef*>(shuffled.data()), &inflatedSize,
+                           reinterpret_cast<const Bytef*>(stored.data()), static_cast<uLong>(stored.size())) != Z_OK ||
+                inflatedSize != rawSize) {
+                throw std::runtime_error(m_filename + " has a damaged chunk at offset " + std::to_string(chunk.offset) + ".");
+            }
+            unshuffleFloats(shuffled, pixels.data(), count);
+#else
+            throw std::runtime_error(m_filename + " has compressed chunks, which need zlib.");
+#endif
+        }
+
+        // Copy the overlap row by row.
+        size_t left = std::max<size_t>(chunk.x, region.x);
+        size_t right = std::min<size_t>(chunk.x + chunk.width, region.x + region.width);
+        size_t top = std::max<size_t>(chunk.y, region.y);
+        size_t bottom = std::min<size_t>(chunk.y + chunk.height, region.y + region.height);
+        for (size_t y = top; y < bottom; ++y) {
+            std::memcpy(rgb + 3 * ((y - region.y) * region.width + left - region.x),
+                        pixels.data() + 3 * ((y - chunk.y) * chunk.width + left - chunk.x),
+                        3 * (right - left) * sizeof(float));
+        }
+    }
+}
+
+namespace {
+    // Read the crop a band of bandRows rows at a time, func gets the top row of the band within the crop,
+    // its height and its floats.
+    void forEachBand(TiledImageReader& reader, const ImageRegion& crop, size_t bandRows,
+                     const std::function<void(size_t, size_t, const float*)>& func) {
+        std::vector<float> band = {};
+        for (size_t top = 0; top < crop.height; top += bandRows) {
+            ImageRegion rows = { crop.x, crop.y + top, crop.width, std::min(bandRows, crop.height - top) };
+            band.resize(3 * rows.width * rows.height);
+            reader.readRegion(rows, band.data());
+            func(top, rows.height, band.data());
+        }
+    }
+
+#ifdef RAYTRACER_HAVE_ZLIB
+    // Bands are whole PNG strips, each encoded as soon as its rows are tonemapped. Only the last row of
+    // the band before is kept for filtering the first strip of the next.
+    bool convertToPng(TiledImageReader& reader, const ImageRegion& crop, const std::string& output,
+                      const TonemapSettings& tonemap) {
+        PngEncoder png(crop.width, crop.height);
+        size_t stripHeight = png.stripHeight();
+        size_t bandRows = std::max<size_t>(1, ConvertBandRows / stripHeight) * stripHeight;
+        size_t rowSize = 3 * crop.width;
+        std::vector<uint8_t> rgb(bandRows * rowSize), above(rowSize);
+        forEachBand(reader, crop, bandRows, [&](size_t top, size_t height, const float* band) {
+            for (size_t j = 0; j < height; ++j) {
+                tonemapRow(band + j * rowSize, crop.width, 0, top + j, tonemap, rgb.data() + j * rowSize);
+            }
+            auto rows = [&](size_t row, unsigned char* out) {
+                std::memcpy(out, row < top ? above.data() : rgb.data() + (row - top) * rowSize, rowSize);
+            };
+            for (size_t strip = top / stripHeight; strip * stripHeight < top + height; ++strip) {
+                png.encodeStrip(strip, rows);
+            }
+            std::memcpy(above.data(), rgb.data() + (height - 1) * rowSize, rowSize);
+        });
+        return png.write(output);
+    }
+#endif
+}
+
+bool convertTiledImage(const std::string& filename, const std::string& output, int fileType, const ImageRegion& region,
+                       const TonemapSettings& tonemap) {
+    TiledImageReader reader(filename);
+    ImageRegion crop = region;
+    if (crop.width == 0 || crop.height == 0) {
+        crop = { 0, 0, reader.width(), reader.height() };
+    }
+    if (crop.x + crop.width > reader.width() || crop.y + crop.height > reader.height()) {
+        throw std::runtime_error("Region exceeds the " + std::to_string(reader.width()) + "x" +
+                                 std::to_string(reader.height()) + " image of " + filename + ".");
+    }
+
+    // Bands go straight into the writers that take rows: mapped PPM and PFM files, PNG strips and the
+    // chunks of a tiled image.
+    switch (fileType) {
+        case ExporterManager::PPM:
+        case ExporterManager::PFM: {
+            ExporterManager em = {};
+            if (!em.startMappedWrite(output, fileType, crop.width, crop.height)) {
+                return false;
+            }
+            em.setTonemap(tonemap);
+            forEachBand(reader, crop, ConvertBandRows, [&](size_t top, size_t height, const float* band) {
+                em.writeTile(0, top, crop.width, height, band);
+                em.markWritten(0, top, crop.width, height);
+            });
+            return em.endWrite(output, fileType);
+        }
+#ifdef RAYTRACER_HAVE_ZLIB
+        case ExporterManager::PNG:
+            return convertToPng(reader, crop, output, tonemap);
+#endif
+        case ExporterManager::TILED: {
+            TiledImageWriter writer = {};
+            if (!writer.open(output, crop.width, crop.height)) {
+                return false;
+            }
+            std::vector<float> chunk = {};
+            forEachBand(reader, crop, ConvertChunkSize, [&](size_t top, size_t height, const float* band) {
+                for (size_t x = 0; x < crop.width; x += ConvertChunkSize) {
+                    size_t width = std::min(ConvertChunkSize, crop.width - x);
+                    chunk.resize(3 * width * height);
+                    for (size_t j = 0; j < height; ++j) {
+                        std::memcpy(chunk.data() + 3 * j * width, band + 3 * (x + j * crop.width), 3 * width * sizeof(float));
+                    }
+                    writer.writeChunk(x, top, width, height, chunk.data());
+                }
+            });
+            return writer.close();
+        }
+        default:
+            break;
+    }
+
+    if (crop.width * crop.height > MaxBufferedConvertPixels) {
+        throw std::runtime_error("A " + std::to_string(crop.width) + "x" + std::to_string(crop.height) +
+                                 " crop is too large for this output type, convert to PPM, PFM, PNG or .rtt or crop it.");
+    }
+    ExporterManager em = {};
+    em.startWrite(crop.width, crop.height, ExporterManager::isHdr(fileType));
+    em.setTonemap(tonemap);
+    forEachBand(reader, crop, ConvertBandRows, [&](size_t top, size_t height, const float* band) {
+        em.writeTile(0, top, crop.width, height, band);
+    });
+    return em.endWrite(output, fileType);
+}
@@ -0,0 +1,104 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#ifndef TILED_IMAGE_H
+#define TILED_IMAGE_H
+
+#include <cstdint>
+#include <mutex>
+
+#include "Exporter/Tonemap.h"
+
+#include "RayTracer/RayTracer.h"
+
+/*
+ * Tiled image (.rtt), linear float RGB stored as independent rectangular chunks with an index, so that
+ * tiles can be written in any order as they finish and a region can be read without decoding the rest.
+ * All values are little-endian like the host:
+ *
+ *   "RTTILES\0", uint32 version, uint32 width, uint32 height
+ *   chunk*:  uint32 x, y, width, height, uint8 compression, uint64 raw size, uint64 stored size, data
+ *   index:   uint64 count, then uint32 x, y, width, height, uint64 chunk offset per chunk
+ *   trailer: uint64 index offset, "RTINDEX\0"
+ *
+ * Chunk data is 3 floats per pixel with the top row first. Compressed chunks have the floats split into
+ * byte planes, each byte stored as the difference to the one before, and deflated. Chunks later in the
+ * file win where they overlap earlier ones. Files of interrupted renders lack the index and the trailer,
+ * readers then find the chunks by walking the file.
+ */
+
+struct ImageRegion {
+    size_t x = 0, y = 0;
+    size_t width = 0, height = 0; // Zero for the whole image.
+};
+
+struct TiledChunk {
+    uint32_t x = 0, y = 0;
+    uint32_t width = 0, height = 0;
+    uint64_t offset = 0; // Of the chunk header.
+};
+
+class TiledImageWriter {
+public:
+    ~TiledImageWriter();
+
+    // Create filename for an image of width x height, false if it cannot be created. Chunks are
+    // deflated when compress is set and zlib is available.
+    bool open(const std::string& filename, size_t width, size_t height, bool compress = true);
+
+    // Thread-safe. rgb holds 3 floats per pixel of the rectangle, rows top first. The chunk is
+    // compressed on the calling thread and appended in the order of the calls.
+    void writeChunk(size_t x, size_t y, size_t width, size_t height, const float* rgb);
+
+    // Append the index and the trailer, false if anything failed to write.
+    bool close();
+
+private:
+    std::mutex m_mutex = {};
+    std::unique_ptr<std::ofstream> m_fout = nullptr;
+    std::vector<TiledChunk> m_index = {};
+    uint64_t m_end = 0;
+    bool m_compress = true;
+};
+
+class TiledImageReader {
+public:
+    // Throws std::runtime_error when filename cannot be read or is no tiled image.
+    explicit TiledImageReader(const std::string& filename);
+
+    inline size_t width() const { return m_width; }
+
+    inline size_t height() const { return m_height; }
+
+    inline const std::vector<TiledChunk>& chunks() const { return m_index; }
+
+    // Fill the 3 floats per pixel of the region, rows top first, zero where no chunk covers it. Only the
+    // chunks overlapping the region are read and decoded. Throws std::runtime_error on damaged chunks.
+    void readRegion(const ImageRegion& region, float* rgb);
+
+private:
+    // Index of a file without trailer, from the chunk headers up to the first damaged one.
+    void walkChunks(uint64_t fileSize);
+
+private:
+    std::ifstream m_fin = {};
+    std::string m_filename = {};
+    size_t m_width = 0, m_height = 0;
+    std::vector<TiledChunk> m_index = {};
+};
+
+// Write the region (the whole image by default) of the tiled image filename to output, as any file
+// type of ExporterManager, reading a band of rows at a time. Binary PPM, PFM, PNG (with zlib) and tiled
+// outputs take the bands as they come, in memory bounded by a band. The other types are written from a
+// whole framebuffer, which is limited to 2^28 pixels. Throws std::runtime_error like the reader, and for
+// larger crops of those types.
+bool convertTiledImage(const std::string& filename, const std::string& output, int fileType,
+                       const ImageRegion& region = {}, const TonemapSettings& tonemap = {});
+
+#endif // TILED_IMAGE_H
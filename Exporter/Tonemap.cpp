@@ -0,0 +1,136 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#include <cstring>
+
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+
+#include "Tonemap.h"
+
+namespace {
+    // Larger values are white under every operator, and the ACES polynomial stays finite below it.
+    constexpr float MaxInput = 65504.0f;
+
+    // Linear part of the sRGB curve below it.
+    constexpr float SrgbLinearEnd = 0.0031308f;
+
+    // Minimax fit of 1.055 c^(1 / 2.4) - 0.055 on [SrgbLinearEnd, 1] by c^(1/2), c^(1/4), c^(1/8) and c,
+    // within 0.012 of an 8-bit step, so square roots are all it takes.
+    constexpr float SrgbRoot2 = 0.64236957f;
+    constexpr float SrgbRoot4 = 0.71210577f;
+    constexpr float SrgbRoot8 = -0.33686797f;
+    constexpr float SrgbLinear = -0.01756423f;
+
+    // Thresholds of the 4x4 Bayer matrix, (index + 0.5) / 16.
+    constexpr float Bayer[4][4] = {
+        { 0.5f / 16, 8.5f / 16, 2.5f / 16, 10.5f / 16 },
+        { 12.5f / 16, 4.5f / 16, 14.5f / 16, 6.5f / 16 },
+        { 3.5f / 16, 11.5f / 16, 1.5f / 16, 9.5f / 16 },
+        { 15.5f / 16, 7.5f / 16, 13.5f / 16, 5.5f / 16 }
+    };
+
+    // The scalar path mirrors the SSE2 one operation by operation, so both give the same bytes.
+    inline float toneMap(float c, ToneMapping toneMapping) {
+        c = c > 0.0f ? std::min(c, MaxInput) : 0.0f; // NaN fails the comparison and becomes 0, like in _mm_max_ps.
+        switch (toneMapping) {
+            case ToneMapping::Reinhard:
+                return c / (c + 1.0f);
+            case ToneMapping::Aces:
+                return std::min((c * (c * 2.51f + 0.03f)) / (c * (c * 2.43f + 0.59f) + 0.14f), 1.0f);
+            default:
+                return std::min(c, 1.0f);
+        }
+    }
+
+    inline float encode(float c, TransferCurve curve) {
+        if (curve == TransferCurve::Gamma2) {
+            return std::sqrt(c);
+        }
+        float root2 = std::sqrt(c);
+        float root4 = std::sqrt(root2);
+        float root8 = std::sqrt(root4);
+        float curved = root2 * SrgbRoot2 + root4 * SrgbRoot4 + root8 * SrgbRoot8 + c * SrgbLinear;
+        return c <= SrgbLinearEnd ? c * 12.92f : curved;
+    }
+
+    inline uint8_t quantize(float value, float threshold) {
+        return static_cast<uint8_t>(std::min(static_cast<int>(value * 255.0f + threshold), 255));
+    }
+
+#ifdef __SSE2__
+    inline __m128 toneMap4(__m128 c, ToneMapping toneMapping) {
+        const __m128 one = _mm_set1_ps(1.0f);
+        c = _mm_min_ps(_mm_max_ps(c, _mm_setzero_ps()), _mm_set1_ps(MaxInput));
+        switch (toneMapping) {
+            case ToneMapping::Reinhard:
+                return _mm_div_ps(c, _mm_add_ps(c, one));
+            case ToneMapping::Aces: {
+                __m128 numerator = _mm_mul_ps(c, _mm_add_ps(_mm_mul_ps(c, _mm_set1_ps(2.51f)), _mm_set1_ps(0.03f)));
+                __m128 denominator = _mm_add_ps(_mm_mul_ps(c, _mm_add_ps(_mm_mul_ps(c, _mm_set1_ps(2.43f)),
+                                                                         _mm_set1_ps(0.59f))), _mm_set1_ps(0.14f));
+                return _mm_min_ps(_mm_div_ps(numerator, denominator), one);
+            }
+            default:
+                return _mm_min_ps(c, one);
+        }
+    }
+
+    inline __m128 encode4(__m128 c, TransferCurve curve) {
+        if (curve == TransferCurve::Gamma2) {
+            return _mm_sqrt_ps(c);
+        }
+        __m128 root2 = _mm_sqrt_ps(c);
+        __m128 root4 = _mm_sqrt_ps(root2);
+        __m128 root8 = _mm_sqrt_ps(root4);
+        __m128 curved = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(root2, _mm_set1_ps(SrgbRoot2)),
+                                                         _mm_mul_ps(root4, _mm_set1_ps(SrgbRoot4))),
+                                              _mm_mul_ps(root8, _mm_set1_ps(SrgbRoot8))),
+                                   _mm_mul_ps(c, _mm_set1_ps(SrgbLinear)));
+        __m128 linear = _mm_mul_ps(c, _mm_set1_ps(12.92f));
+        __m128 isLinear = _mm_cmple_ps(c, _mm_set1_ps(SrgbLinearEnd));
+        return _mm_or_ps(_mm_and_ps(isLinear, linear), _mm_andnot_ps(isLinear, curved));
+    }
+
+    inline __m128i quantize4(__m128 value, __m128 threshold) {
+        return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, _mm_set1_ps(255.0f)), threshold));
+    }
+#endif
+}
+
+void tonemapRow(const float* rgb, size_t count, size_t x, size_t y, const TonemapSettings& settings, uint8_t* out) {
+    // Thresholds of the 4 pixels from x on, repeated for the channels: the Bayer row repeats every 4
+    // pixels, which are 12 floats or three vectors.
+    float thresholds[12] = {};
+    for (size_t k = 0; k < 12; ++k) {
+        thresholds[k] = settings.dither ? Bayer[y % 4][(x + k / 3) % 4] : 0.5f;
+    }
+
+    size_t i = 0;
+    size_t floatCount = 3 * count;
+#ifdef __SSE2__
+    __m128 threshold0 = _mm_loadu_ps(thresholds);
+    __m128 threshold1 = _mm_loadu_ps(thresholds + 4);
+    __m128 threshold2 = _mm_loadu_ps(thresholds + 8);
+    for (; i + 12 <= floatCount; i += 12) {
+        __m128i q0 = quantize4(encode4(toneMap4(_mm_loadu_ps(rgb + i), settings.toneMapping), settings.curve), threshold0);
+        __m128i q1 = quantize4(encode4(toneMap4(_mm_loadu_ps(rgb + i + 4), settings.toneMapping), settings.curve), threshold1);
+        __m128i q2 = quantize4(encode4(toneMap4(_mm_loadu_ps(rgb + i + 8), settings.toneMapping), settings.curve), threshold2);
+        // Saturating packs clamp to [0, 255], the 4 bytes of the zero vector are dropped.
+        __m128i bytes = _mm_packus_epi16(_mm_packs_epi32(q0, q1), _mm_packs_epi32(q2, _mm_setzero_si128()));
+        alignas(16) uint8_t packed[16];
+        _mm_store_si128(reinterpret_cast<__m128i*>(packed), bytes);
+        std::memcpy(out + i, packed, 12);
+    }
+#endif
+    for (; i < floatCount; ++i) {
+        out[i] = quantize(encode(toneMap(rgb[i], settings.toneMapping), settings.curve), thresholds[i % 12]);
+    }
+}
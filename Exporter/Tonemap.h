@@ -0,0 +1,40 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#ifndef TONEMAP_H
+#define TONEMAP_H
+
+#include <cstdint>
+
+#include "RayTracer/RayTracer.h"
+
+enum class ToneMapping {
+    Clamp,    // Everything above 1 is white.
+    Reinhard, // c / (1 + c), keeps detail in highlights at the cost of contrast.
+    Aces      // Narkowicz's fit of the ACES filmic curve.
+};
+
+enum class TransferCurve {
+    Gamma2, // Square root, the look of all images rendered so far.
+    Srgb
+};
+
+struct TonemapSettings {
+    ToneMapping toneMapping = ToneMapping::Clamp;
+    TransferCurve curve = TransferCurve::Gamma2;
+    // 4x4 ordered dither instead of rounding, breaks up banding in smooth gradients.
+    bool dither = false;
+};
+
+// Turn count pixels of linear RGB floats, the row of an image starting at pixel (x, y), into 8-bit RGB.
+// Negative and NaN values become black. The position only matters for the dither pattern. Converts
+// 4 pixels per step with SSE2 where available, doing the same arithmetic as the scalar path.
+void tonemapRow(const float* rgb, size_t count, size_t x, size_t y, const TonemapSettings& settings, uint8_t* out);
+
+#endif // TONEMAP_H
@@ -0,0 +1,93 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#include "DirectLighting.h"
+
+namespace {
+    // Orthonormal basis around unit vector n, see Duff et al. 2017.
+    inline void coordinateSystem(const Vector3d& n, Vector3d& t, Vector3d& b) {
+        double sign = std::copysign(1.0, n.z());
+        double a = -1.0 / (sign + n.z());
+        double c = n.x() * n.y() * a;
+        t = { 1.0 + sign * n.x() * n.x() * a, sign * c, -sign * n.x() };
+        b = { c, sign + n.y() * n.y() * a, -n.y() };
+    }
+}
+
+bool sampleSphereLight(const Vector3d& center, double radius, const Vector3d& p, double u1, double u2,
+                       LightPointSample& result) {
+    Vector3d toCenter = center - p;
+    double d2 = toCenter.length2();
+    double r = radius;
+    if (d2 <= r * r) return false; // Inside the emitter.
+
+    double sin2ThetaMax = r * r / d2;
+    double sinThetaMax = sqrt(sin2ThetaMax);
+    double cosThetaMax = sqrt(std::max(0.0, 1.0 - sin2ThetaMax));
+    double oneMinusCosThetaMax = 1.0 - cosThetaMax;
+
+    double cosTheta = 1.0 - u1 * oneMinusCosThetaMax;
+    double sin2Theta = 1.0 - cosTheta * cosTheta;
+    // Tiny or distant lights (under 1.5 degrees), avoid cancellation in 1 - cos.
+    if (sin2ThetaMax < 0.00068523) {
+        sin2Theta = sin2ThetaMax * u1;
+        cosTheta = sqrt(1.0 - sin2Theta);
+        oneMinusCosThetaMax = 0.5 * sin2ThetaMax;
+    }
+
+    // Angle at the sphere center between -toCenter and the sampled surface point.
+    double cosAlpha = sin2Theta / sinThetaMax + cosTheta * sqrt(std::max(0.0, 1.0 - sin2Theta / sin2ThetaMax));
+    double sinAlpha = sqrt(std::max(0.0, 1.0 - cosAlpha * cosAlpha));
+    double phi = 2.0 * pi * u2;
+
+    Vector3d w = -toCenter / sqrt(d2), t = {}, b = {};
+    coordinateSystem(w, t, b);
+    Vector3d normal = sinAlpha * cos(phi) * t + sinAlpha * sin(phi) * b + cosAlpha * w;
+
+    result.position = center + r * normal;
+    result.normal = normal;
+    result.pdf = 1.0 / (2.0 * pi * oneMinusCosThetaMax);
+    return true;
+}
+
+bool occluded(const Ray& r, double tMax, const std::vector<std::shared_ptr<Shape>>& shapeList) {
+    HitResult hit = {};
+    for (const auto& shape : shapeList) {
+        if (shape->hit(r, 0.001, tMax, hit)) return true;
+    }
+    return false;
+}
+
+Vector3d sampleDirectLight(const HitResult& hit, const Vector3d& albedo,
+                           const std::vector<std::shared_ptr<Shape>>& shapeList, const LightBVH& lights) {
+    LightSampleIndex index = {};
+    if (!lights.sample(hit.position, hit.normal, randomReal(), index)) {
+        return Vector3d::zero();
+    }
+
+    const auto& light = lights.light(index.light);
+    LightPointSample point = {};
+    if (!sampleSphereLight(light.center, light.radius, hit.position, randomReal(), randomReal(), point)) {
+        return Vector3d::zero();
+    }
+
+    Vector3d toLight = point.position - hit.position;
+    double distance = toLight.length();
+    Vector3d wi = toLight / distance;
+    double cosTheta = dot(hit.normal, wi);
+    if (cosTheta <= 0.0) return Vector3d::zero();
+
+    // Stop just before the sampled point so the light does not shadow itself.
+    if (occluded(Ray(hit.position, wi), distance * (1.0 - 1e-4), shapeList)) {
+        return Vector3d::zero();
+    }
+
+    // Lambertian BRDF is albedo / pi.
+    return light.emission * albedo * (cosTheta / (pi * point.pdf * index.pmf));
+}
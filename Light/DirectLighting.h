@@ -0,0 +1,42 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#ifndef DIRECT_LIGHTING_H
+#define DIRECT_LIGHTING_H
+
+#include "Light/LightBVH.h"
+#include "Ray/Ray.h"
+#include "Shape/Shape.h"
+#include "Shape/Sphere.h"
+
+#include "RayTracer/RayTracer.h"
+
+enum class DirectLightingMode {
+    NextEvent, // One light sample per diffuse hit.
+    ReSTIR     // Reservoir resampling with spatial (and temporal) reuse at primary hits.
+};
+
+struct LightPointSample {
+    Vector3d position = {};
+    Vector3d normal = {};
+    double pdf = 0.0; // With respect to solid angle at the shading point.
+};
+
+// Sample the part of a sphere visible from p uniformly over the cone it subtends.
+bool sampleSphereLight(const Vector3d& center, double radius, const Vector3d& p, double u1, double u2,
+                       LightPointSample& result);
+
+// Any-hit test for shadow rays, everything up to tMax blocks the light.
+bool occluded(const Ray& r, double tMax, const std::vector<std::shared_ptr<Shape>>& shapeList);
+
+// One-sample estimate of the light reaching a diffuse point directly from emissive spheres.
+Vector3d sampleDirectLight(const HitResult& hit, const Vector3d& albedo,
+                           const std::vector<std::shared_ptr<Shape>>& shapeList, const LightBVH& lights);
+
+#endif // DIRECT_LIGHTING_H
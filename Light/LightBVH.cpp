@@ -0,0 +1,299 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#include "Material/Material.h"
+
+#include "LightBVH.h"
+
+namespace {
+    inline double safeSqrt(double x) { return sqrt(std::max(0.0, x)); }
+
+    inline Vector3d minVec3d(const Vector3d& a, const Vector3d& b) {
+        return { std::min(a.x(), b.x()), std::min(a.y(), b.y()), std::min(a.z(), b.z()) };
+    }
+
+    inline Vector3d maxVec3d(const Vector3d& a, const Vector3d& b) {
+        return { std::max(a.x(), b.x()), std::max(a.y(), b.y()), std::max(a.z(), b.z()) };
+    }
+
+    // cos(max(0, a - b)) and sin(max(0, a - b)) from the sines and cosines of a and b.
+    inline double cosSubClamped(double sinA, double cosA, double sinB, double cosB) {
+        return cosA > cosB ? 1.0 : cosA * cosB + sinA * sinB;
+    }
+
+    inline double sinSubClamped(double sinA, double cosA, double sinB, double cosB) {
+        return cosA > cosB ? 0.0 : sinA * cosB - cosA * sinB;
+    }
+
+    // Rodrigues' rotation of v around unit axis k.
+    inline Vector3d rotate(const Vector3d& v, const Vector3d& k, double theta) {
+        return cos(theta) * v + sin(theta) * cross(k, v) + (dot(k, v) * (1.0 - cos(theta))) * k;
+    }
+
+    inline double surfaceArea(const LightBounds& b) {
+        Vector3d d = b.pMax - b.pMin;
+        return 2.0 * (d.x() * d.y() + d.y() * d.z() + d.z() * d.x());
+    }
+
+    // Solid angle measure of a normal cone widened by the emission angle, see SAOH by Conty & Kulla.
+    inline double orientationMeasure(const LightBounds& b) {
+        double thetaO = acos(std::clamp(b.cosThetaO, -1.0, 1.0));
+        double thetaE = acos(std::clamp(b.cosThetaE, -1.0, 1.0));
+        double thetaW = std::min(thetaO + thetaE, pi);
+        double sinThetaO = safeSqrt(1.0 - b.cosThetaO * b.cosThetaO);
+        return 2.0 * pi * (1.0 - b.cosThetaO) +
+               0.5 * pi * (2.0 * thetaW * sinThetaO - cos(thetaO - 2.0 * thetaW) - 2.0 * thetaO * sinThetaO + b.cosThetaO);
+    }
+
+    LightBounds sphereLightBounds(const Vector3d& center, double radius, const Vector3d& emission) {
+        LightBounds bounds = {};
+        Vector3d r = { radius, radius, radius };
+        bounds.pMin = center - r;
+        bounds.pMax = center + r;
+        // A sphere emits in every direction from its surface: power = pi * area * L.
+        bounds.phi = luminance(emission) * pi * 4.0 * pi * radius * radius;
+        bounds.cosThetaO = -1.0;
+        bounds.cosThetaE = 0.0;
+        return bounds;
+    }
+}
+
+double LightBounds::importance(const Vector3d& p, const Vector3d& n) const {
+    Vector3d pc = centroid();
+    Vector3d toPoint = p - pc;
+    double d2 = toPoint.length2();
+    double radius2 = 0.25 * (pMax - pMin).length2();
+    // Keep the estimate bounded when p is close to or inside the cluster.
+    double clampedD2 = std::max(d2, sqrt(radius2));
+
+    // Angle subtended by the bounding sphere of the cluster.
+    if (d2 <= radius2) {
+        return phi / clampedD2;
+    }
+    double sin2ThetaB = radius2 / d2;
+    double cosThetaB = safeSqrt(1.0 - sin2ThetaB);
+    double sinThetaB = sqrt(sin2ThetaB);
+
+    // Angle between the emission axis and the point, shrunk by the cone and the subtended angle.
+    Vector3d wp = toPoint / sqrt(d2);
+    double cosThetaW = dot(w, wp);
+    double sinThetaW = safeSqrt(1.0 - cosThetaW * cosThetaW);
+    double sinThetaO = safeSqrt(1.0 - cosThetaO * cosThetaO);
+    double cosThetaX = cosSubClamped(sinThetaW, cosThetaW, sinThetaO, cosThetaO);
+    double sinThetaX = sinSubClamped(sinThetaW, cosThetaW, sinThetaO, cosThetaO);
+    double cosThetaP = cosSubClamped(sinThetaX, cosThetaX, sinThetaB, cosThetaB);
+    if (cosThetaP <= cosThetaE) return 0.0;
+
+    // Lambert's cosine at the receiver, again relaxed by the subtended angle.
+    double cosThetaI = dot(-wp, n);
+    double sinThetaI = safeSqrt(1.0 - cosThetaI * cosThetaI);
+    double cosThetaPI = cosSubClamped(sinThetaI, cosThetaI, sinThetaB, cosThetaB);
+
+    return std::max(0.0, phi * cosThetaP * cosThetaPI / clampedD2);
+}
+
+LightBounds unite(const LightBounds& a, const LightBounds& b) {
+    if (a.phi == 0.0) return b;
+    if (b.phi == 0.0) return a;
+
+    LightBounds result = {};
+    result.pMin = minVec3d(a.pMin, b.pMin);
+    result.pMax = maxVec3d(a.pMax, b.pMax);
+    result.phi = a.phi + b.phi;
+    result.cosThetaE = std::min(a.cosThetaE, b.cosThetaE);
+
+    // Smallest cone containing both normal cones, spheres already cover all directions.
+    if (a.cosThetaO <= -1.0 || b.cosThetaO <= -1.0) {
+        result.w = a.w;
+        result.cosThetaO = -1.0;
+        return result;
+    }
+    double thetaA = acos(std::clamp(a.cosThetaO, -1.0, 1.0));
+    double thetaB = acos(std::clamp(b.cosThetaO, -1.0, 1.0));
+    double thetaD = acos(std::clamp(dot(a.w, b.w), -1.0, 1.0));
+    if (std::min(thetaD + thetaB, pi) <= thetaA) {
+        result.w = a.w;
+        result.cosThetaO = a.cosThetaO;
+    }
+    else if (std::min(thetaD + thetaA, pi) <= thetaB) {
+        result.w = b.w;
+        result.cosThetaO = b.cosThetaO;
+    }
+    else {
+        double thetaO = 0.5 * (thetaA + thetaD + thetaB);
+        Vector3d axis = cross(a.w, b.w);
+        if (thetaO >= pi || axis.length2() == 0.0) {
+            result.w = a.w;
+            result.cosThetaO = -1.0;
+        }
+        else {
+            result.w = rotate(a.w, normalize(axis), thetaO - thetaA);
+            result.cosThetaO = cos(thetaO);
+        }
+    }
+    return result;
+}
+
+void LightBVH::build(const std::vector<std::shared_ptr<Shape>>& shapeList) {
+    m_lights.clear();
+    m_nodes.clear();
+
+    auto addLight = [this](const Vector3d& center, double radius, const Vector3d& emission) {
+        m_lights.push_back({ center, radius, emission, sphereLightBounds(center, radius, emission) });
+    };
+    for (const auto& shape : shapeList) {
+        if (auto set = dynamic_cast<const SphereSet*>(shape.get())) {
+            // Emission per table entry, the spheres of a set are too many to ask their materials.
+            std::vector<Vector3d> emissions(set->materials().size());
+            bool anyEmitter = false;
+            for (size_t m = 0; m < emissions.size(); ++m) {
+                emissions[m] = set->materials()[m] != nullptr ? set->materials()[m]->emitted() : Vector3d::zero();
+                anyEmitter = anyEmitter || luminance(emissions[m]) > 0.0;
+            }
+            for (size_t i = 0; anyEmitter && i < set->size(); ++i) {
+                const Vector3d& emission = emissions[set->materialIndex(i)];
+                if (luminance(emission) <= 0.0) continue;
+
+                const PackedSphere& sphere = set->sphere(i);
+                addLight({ sphere.x, sphere.y, sphere.z }, sphere.radius, emission);
+            }
+            continue;
+        }
+
+        auto sphere = dynamic_cast<const Sphere*>(shape.get());
+        if (sphere == nullptr || shape->material() == nullptr) continue;
+
+        Vector3d emission = shape->material()->emitted();
+        if (luminance(emission) <= 0.0) continue;
+
+        addLight(sphere->center(), sphere->radius(), emission);
+    }
+    if (m_lights.empty()) return;
+
+    std::vector<BuildItem> items(m_lights.size());
+    for (size_t i = 0; i < m_lights.size(); ++i) {
+        items[i] = { static_cast<int>(i), m_lights[i].bounds.centroid() };
+    }
+    m_nodes.reserve(2 * m_lights.size() - 1);
+    buildRecursive(items, 0, items.size());
+}
+
+int LightBVH::buildRecursive(std::vector<BuildItem>& items, size_t begin, size_t end) {
+    int nodeIndex = static_cast<int>(m_nodes.size());
+    m_nodes.emplace_back();
+
+    if (end - begin == 1) {
+        m_nodes[nodeIndex].bounds = m_lights[items[begin].light].bounds;
+        m_nodes[nodeIndex].childOrLight = items[begin].light;
+        m_nodes[nodeIndex].isLeaf = true;
+        return nodeIndex;
+    }
+
+    LightBounds bounds = {};
+    Vector3d centroidMin = items[begin].centroid, centroidMax = items[begin].centroid;
+    for (size_t i = begin; i < end; ++i) {
+        bounds = unite(bounds, m_lights[items[i].light].bounds);
+        centroidMin = minVec3d(centroidMin, items[i].centroid);
+        centroidMax = maxVec3d(centroidMax, items[i].centroid);
+    }
+
+    // Binned surface area orientation heuristic over all three axes.
+    constexpr int bucketCount = 12;
+    Vector3d extent = bounds.pMax - bounds.pMin;
+    double maxExtent = std::max({ extent.x(), extent.y(), extent.z() });
+
+    int bestAxis = -1, bestBucket = -1;
+    double bestCost = infinity;
+    for (int axis = 0; axis < 3; ++axis) {
+        double lo = centroidMin[axis], hi = centroidMax[axis];
+        if (hi <= lo) continue;
+
+        LightBounds buckets[bucketCount] = {};
+        for (size_t i = begin; i < end; ++i) {
+            int b = std::min(bucketCount - 1, static_cast<int>(bucketCount * (items[i].centroid[axis] - lo) / (hi - lo)));
+            buckets[b] = unite(buckets[b], m_lights[items[i].light].bounds);
+        }
+
+        double aspect = extent[axis] > 0.0 ? maxExtent / extent[axis] : 1.0;
+        for (int split = 1; split < bucketCount; ++split) {
+            LightBounds below = {}, above = {};
+            for (int b = 0; b < split; ++b) below = unite(below, buckets[b]);
+            for (int b = split; b < bucketCount; ++b) above = unite(above, buckets[b]);
+            if (below.phi == 0.0 || above.phi == 0.0) continue;
+
+            double cost = aspect * (below.phi * orientationMeasure(below) * surfaceArea(below) +
+                                    above.phi * orientationMeasure(above) * surfaceArea(above));
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestBucket = split;
+            }
+        }
+    }
+
+    size_t mid = begin;
+    if (bestAxis >= 0) {
+        double lo = centroidMin[bestAxis], hi = centroidMax[bestAxis];
+        auto midIter = std::partition(items.begin() + begin, items.begin() + end, [&](const BuildItem& item) {
+            int b = std::min(bucketCount - 1, static_cast<int>(bucketCount * (item.centroid[bestAxis] - lo) / (hi - lo)));
+            return b < bestBucket;
+        });
+        mid = midIter - items.begin();
+    }
+    // Coincident centroids or a degenerated partition, fall back to an even split.
+    if (mid == begin || mid == end) {
+        mid = (begin + end) / 2;
+        Vector3d spread = centroidMax - centroidMin;
+        int axis = spread.x() > spread.y() ? (spread.x() > spread.z() ? 0 : 2) : (spread.y() > spread.z() ? 1 : 2);
+        std::nth_element(items.begin() + begin, items.begin() + mid, items.begin() + end,
+                         [axis](const BuildItem& a, const BuildItem& b) { return a.centroid[axis] < b.centroid[axis]; });
+    }
+
+    buildRecursive(items, begin, mid);
+    int secondChild = buildRecursive(items, mid, end);
+
+    m_nodes[nodeIndex].bounds = bounds;
+    m_nodes[nodeIndex].childOrLight = secondChild;
+    m_nodes[nodeIndex].isLeaf = false;
+    return nodeIndex;
+}
+
+bool LightBVH::sample(const Vector3d& p, const Vector3d& n, double u, LightSampleIndex& result) const {
+    if (m_nodes.empty()) return false;
+
+    constexpr double oneMinusEpsilon = 1.0 - std::numeric_limits<double>::epsilon();
+
+    int nodeIndex = 0;
+    double pmf = 1.0;
+    if (m_nodes[0].isLeaf && m_nodes[0].bounds.importance(p, n) <= 0.0) return false;
+
+    while (!m_nodes[nodeIndex].isLeaf) {
+        int first = nodeIndex + 1, second = m_nodes[nodeIndex].childOrLight;
+        double firstImportance = m_nodes[first].bounds.importance(p, n);
+        double secondImportance = m_nodes[second].bounds.importance(p, n);
+        if (firstImportance == 0.0 && secondImportance == 0.0) return false;
+
+        // Pick a child and remap u so that it can be reused at the next level.
+        double firstProb = firstImportance / (firstImportance + secondImportance);
+        if (u < firstProb) {
+            nodeIndex = first;
+            pmf *= firstProb;
+            u = std::min(u / firstProb, oneMinusEpsilon);
+        }
+        else {
+            nodeIndex = second;
+            pmf *= 1.0 - firstProb;
+            u = std::min((u - firstProb) / (1.0 - firstProb), oneMinusEpsilon);
+        }
+    }
+
+    result.light = m_nodes[nodeIndex].childOrLight;
+    result.pmf = pmf;
+    return true;
+}
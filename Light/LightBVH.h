@@ -0,0 +1,91 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#ifndef LIGHT_BVH_H
+#define LIGHT_BVH_H
+
+#include "Ray/Ray.h"
+#include "Shape/Shape.h"
+#include "Shape/Sphere.h"
+#include "Shape/SphereSet.h"
+
+#include "RayTracer/RayTracer.h"
+
+/*
+ * Conservative bounds of a cluster of emitters: where they are (AABB), how much they emit (phi)
+ * and in which directions (normal cone of half angle thetaO around w, widened by emission angle thetaE).
+ */
+struct LightBounds {
+    Vector3d pMin = {};
+    Vector3d pMax = {};
+    Vector3d w = { 0.0, 1.0, 0.0 };
+    double phi = 0.0;
+    double cosThetaO = 1.0;
+    double cosThetaE = 1.0;
+
+    inline Vector3d centroid() const { return 0.5 * (pMin + pMax); }
+
+    // Upper bound of the light arriving at a diffuse point p with normal n, used as sampling weight.
+    double importance(const Vector3d& p, const Vector3d& n) const;
+
+    friend LightBounds unite(const LightBounds& a, const LightBounds& b);
+};
+
+// Emissive sphere of the hierarchy, a copy of its geometry whether it is a Sphere or part of a SphereSet.
+struct LightInfo {
+    Vector3d center = {};
+    double radius = 0.0;
+    Vector3d emission = {};
+    LightBounds bounds = {};
+};
+
+struct LightSampleIndex {
+    int light = -1;
+    double pmf = 0.0; // Discrete probability of having picked this light.
+};
+
+class LightBVH {
+public:
+    LightBVH() = default;
+    explicit LightBVH(const std::vector<std::shared_ptr<Shape>>& shapeList) { build(shapeList); }
+
+    // Collect every sphere whose material emits light, on its own or in a set, and cluster them.
+    void build(const std::vector<std::shared_ptr<Shape>>& shapeList);
+
+    // Traverse from the root, choosing children in proportion to their importance. u is in [0, 1).
+    bool sample(const Vector3d& p, const Vector3d& n, double u, LightSampleIndex& result) const;
+
+public:
+    inline bool empty() const { return m_lights.empty(); }
+    inline size_t size() const { return m_lights.size(); }
+    inline size_t nodeCount() const { return m_nodes.size(); }
+
+    inline const LightInfo& light(int index) const { return m_lights[index]; }
+
+private:
+    struct Node {
+        LightBounds bounds = {};
+        // Leaf: index of light. Interior: index of second child, the first child follows its parent.
+        int childOrLight = -1;
+        bool isLeaf = false;
+    };
+
+    struct BuildItem {
+        int light = 0;
+        Vector3d centroid = {};
+    };
+
+    int buildRecursive(std::vector<BuildItem>& items, size_t begin, size_t end);
+
+private:
+    std::vector<LightInfo> m_lights = {};
+    std::vector<Node> m_nodes = {};
+};
+
+#endif // LIGHT_BVH_H
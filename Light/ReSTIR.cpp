@@ -0,0 +1,122 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#include "ReSTIR.h"
+
+namespace {
+    constexpr double minCosNormal = 0.906; // About 25 degrees.
+    constexpr double maxDepthRatio = 0.1;
+
+    // Lambertian BRDF times the geometry term, without visibility.
+    inline Vector3d unshadowedContribution(const ShadingPoint& point, const LightCandidate& candidate,
+                                           const LightBVH& lights, Vector3d& wi, double& distance) {
+        Vector3d toLight = candidate.position - point.hit.position;
+        distance = toLight.length();
+        if (distance <= 0.0) return Vector3d::zero();
+
+        wi = toLight / distance;
+        double cosSurface = dot(point.hit.normal, wi);
+        double cosLight = dot(candidate.normal, -wi);
+        if (cosSurface <= 0.0 || cosLight <= 0.0) return Vector3d::zero();
+
+        return lights.light(candidate.light).emission * point.albedo * (cosSurface * cosLight / (pi * distance * distance));
+    }
+}
+
+double targetPdf(const ShadingPoint& point, const LightCandidate& candidate, const LightBVH& lights) {
+    if (!point.diffuse || candidate.light < 0) return 0.0;
+
+    Vector3d wi = {};
+    double distance = 0.0;
+    return luminance(unshadowedContribution(point, candidate, lights, wi, distance));
+}
+
+Reservoir initialReservoir(const ShadingPoint& point, const LightBVH& lights, int candidateCount) {
+    Reservoir reservoir = {};
+    if (!point.diffuse || lights.empty()) return reservoir;
+
+    for (int i = 0; i < candidateCount; ++i) {
+        LightSampleIndex index = {};
+        LightPointSample lightPoint = {};
+        if (!lights.sample(point.hit.position, point.hit.normal, randomReal(), index) ||
+            !sampleSphereLight(lights.light(index.light).center, lights.light(index.light).radius, point.hit.position,
+                               randomReal(), randomReal(), lightPoint)) {
+            reservoir.M += 1.0; // A failed candidate still counts in the stream.
+            continue;
+        }
+
+        LightCandidate candidate = { index.light, lightPoint.position, lightPoint.normal };
+
+        // Convert the solid angle density to area measure so that candidates can move between pixels.
+        Vector3d toLight = lightPoint.position - point.hit.position;
+        double cosLight = dot(lightPoint.normal, -normalize(toLight));
+        double sourcePdf = index.pmf * lightPoint.pdf * cosLight / toLight.length2();
+
+        double pHat = targetPdf(point, candidate, lights);
+        double weight = sourcePdf > 0.0 ? pHat / sourcePdf : 0.0;
+        reservoir.update(candidate, weight, pHat, randomReal());
+    }
+    reservoir.finalize();
+    return reservoir;
+}
+
+void combineReservoir(Reservoir& dst, const Reservoir& src, const ShadingPoint& point, const LightBVH& lights, double u) {
+    if (src.M <= 0.0) return;
+
+    double pHat = src.W > 0.0 ? targetPdf(point, src.sample, lights) : 0.0;
+    double weight = pHat * src.W * src.M;
+    dst.weightSum += weight;
+    dst.M += src.M;
+    if (weight > 0.0 && u * dst.weightSum < weight) {
+        dst.sample = src.sample;
+        dst.targetPdf = pHat;
+    }
+}
+
+bool similarSurface(const ShadingPoint& a, const ShadingPoint& b) {
+    if (!a.diffuse || !b.diffuse) return false;
+
+    return dot(a.hit.normal, b.hit.normal) > minCosNormal &&
+           std::abs(a.hit.t - b.hit.t) < maxDepthRatio * a.hit.t;
+}
+
+bool sameSurface(const ShadingPoint& point, double depth, const TemporalReservoir& history) {
+    if (!point.diffuse || history.depth <= 0.0) return false;
+
+    return dot(point.hit.normal, history.normal) > minCosNormal &&
+           std::abs(depth - history.depth) < maxDepthRatio * history.depth;
+}
+
+void validateReservoir(Reservoir& reservoir, const ShadingPoint& point,
+                       const std::vector<std::shared_ptr<Shape>>& shapeList) {
+    if (reservoir.W <= 0.0) return;
+
+    Vector3d toLight = reservoir.sample.position - point.hit.position;
+    double distance = toLight.length();
+    if (occluded(Ray(point.hit.position, toLight / distance), distance * (1.0 - 1e-4), shapeList)) {
+        reservoir.W = 0.0;
+    }
+}
+
+Vector3d shadeReservoir(Reservoir& reservoir, const ShadingPoint& point,
+                        const std::vector<std::shared_ptr<Shape>>& shapeList, const LightBVH& lights) {
+    if (reservoir.W <= 0.0 || !point.diffuse) return Vector3d::zero();
+
+    Vector3d wi = {};
+    double distance = 0.0;
+    Vector3d contribution = unshadowedContribution(point, reservoir.sample, lights, wi, distance);
+    if (luminance(contribution) <= 0.0) return Vector3d::zero();
+
+    // Stop just before the sampled point so the light does not shadow itself.
+    if (occluded(Ray(point.hit.position, wi), distance * (1.0 - 1e-4), shapeList)) {
+        reservoir.W = 0.0;
+        return Vector3d::zero();
+    }
+    return contribution * reservoir.W;
+}
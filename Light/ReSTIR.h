@@ -0,0 +1,64 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#ifndef RESTIR_H
+#define RESTIR_H
+
+#include "Light/DirectLighting.h"
+#include "Light/LightBVH.h"
+#include "Light/Reservoir.h"
+#include "Ray/Ray.h"
+#include "Shape/Shape.h"
+
+#include "RayTracer/RayTracer.h"
+
+struct ReSTIRSettings {
+    int candidateCount = 4; // The light hierarchy is a good source distribution already.
+    int spatialNeighbors = 4;
+    int spatialRadius = 16;
+    // History is clamped to this multiple of candidateCount to keep stale samples from dominating, zero
+    // turns temporal reuse off.
+    int temporalMaxM = 5;
+};
+
+// First hit of a camera ray, one entry of the per-tile G-buffer.
+struct ShadingPoint {
+    Ray ray = {};
+    HitResult hit = {};
+    Vector3d albedo = {};
+    bool valid = false;   // Ray hit something.
+    bool diffuse = false; // Hit material accepts light samples.
+};
+
+// Unshadowed contribution of the candidate at the shading point, measured per unit light area.
+double targetPdf(const ShadingPoint& point, const LightCandidate& candidate, const LightBVH& lights);
+
+// Resampled importance sampling of candidateCount light samples drawn from the light hierarchy.
+Reservoir initialReservoir(const ShadingPoint& point, const LightBVH& lights, int candidateCount);
+
+// Merge src, which was built for another shading point, into dst by re-evaluating the target at point.
+void combineReservoir(Reservoir& dst, const Reservoir& src, const ShadingPoint& point, const LightBVH& lights, double u);
+
+// Reuse is restricted to neighbors of similar geometry, the combination is biased but consistent.
+bool similarSurface(const ShadingPoint& a, const ShadingPoint& b);
+
+// The previous frame saw the same surface as point where it reprojects to: its distance from the camera
+// and its normal agree with the history entry, otherwise the pixel was disoccluded.
+bool sameSurface(const ShadingPoint& point, double depth, const TemporalReservoir& history);
+
+// Visibility reuse: drop the kept sample if it is shadowed.
+void validateReservoir(Reservoir& reservoir, const ShadingPoint& point,
+                       const std::vector<std::shared_ptr<Shape>>& shapeList);
+
+// Direct light estimate of the kept sample, including its shadow ray. A shadowed sample gets W = 0, so
+// the next frame does not reuse it.
+Vector3d shadeReservoir(Reservoir& reservoir, const ShadingPoint& point,
+                        const std::vector<std::shared_ptr<Shape>>& shapeList, const LightBVH& lights);
+
+#endif // RESTIR_H
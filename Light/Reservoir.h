@@ -0,0 +1,74 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#ifndef RESERVOIR_H
+#define RESERVOIR_H
+
+#include "RayTracer/RayTracer.h"
+
+// A point on an emitter, chosen among many candidates for one pixel.
+struct LightCandidate {
+    int light = -1;
+    Vector3d position = {};
+    Vector3d normal = {};
+};
+
+/*
+ * Weighted reservoir sampling: keeps one candidate out of a stream of M, picked in proportion to its
+ * resampling weight. W is the unbiased contribution weight of the kept candidate once finalized.
+ */
+struct Reservoir {
+    LightCandidate sample = {};
+    double weightSum = 0.0;
+    double targetPdf = 0.0;
+    double M = 0.0;
+    double W = 0.0;
+
+    inline bool update(const LightCandidate& candidate, double weight, double candidateTargetPdf, double u) {
+        weightSum += weight;
+        M += 1.0;
+        if (weight > 0.0 && u * weightSum < weight) {
+            sample = candidate;
+            targetPdf = candidateTargetPdf;
+            return true;
+        }
+        return false;
+    }
+
+    inline void finalize() {
+        W = (targetPdf > 0.0 && M > 0.0) ? weightSum / (M * targetPdf) : 0.0;
+    }
+};
+
+// Reservoir kept for the next frame with the primary hit it was built for.
+struct TemporalReservoir {
+    Reservoir reservoir = {};
+    Vector3d normal = {};
+    double depth = 0.0; // Distance of the hit from the camera, zero when the pixel has no diffuse hit.
+};
+
+// Full frame of reservoirs, kept between frames for temporal reuse.
+class ReservoirBuffer {
+public:
+    ReservoirBuffer(int width, int height) : m_width(width), m_height(height) {
+        m_reservoirs.resize(static_cast<size_t>(width) * height);
+    }
+
+    inline TemporalReservoir& at(int x, int y) { return m_reservoirs[x + static_cast<size_t>(y) * m_width]; }
+    inline const TemporalReservoir& at(int x, int y) const { return m_reservoirs[x + static_cast<size_t>(y) * m_width]; }
+
+    inline int width() const { return m_width; }
+    inline int height() const { return m_height; }
+
+private:
+    int m_width = 0, m_height = 0;
+    std::vector<TemporalReservoir> m_reservoirs = {};
+};
+
+#endif // RESERVOIR_H
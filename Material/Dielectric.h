@@ -42,6 +42,10 @@ public:
         return true;
     }
 
+    MaterialParameters parameters() const override {
+        return { MaterialType::Dielectric, 0, { m_albedo.x(), m_albedo.y(), m_albedo.z() }, m_refractionIndex };
+    }
+
 private:
     inline static double schlickApproximation(double cosine, double refractiveIndex) {
         double r0 = (1.0 - refractiveIndex) / (1.0 + refractiveIndex);
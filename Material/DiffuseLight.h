@@ -0,0 +1,34 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#ifndef DIFFUSE_LIGHT_H
+#define DIFFUSE_LIGHT_H
+
+#include "Material.h"
+#include "Shape/Shape.h"
+
+class DiffuseLight : public Material {
+public:
+    explicit DiffuseLight(const Vector3d& emission) : m_emission(emission) {}
+
+    bool scatter(const Ray&, const HitResult&, Vector3d&, Ray&) const override {
+        return false; // Emitters absorb everything.
+    }
+
+    Vector3d emitted() const override { return m_emission; }
+
+    MaterialParameters parameters() const override {
+        return { MaterialType::DiffuseLight, 0, { m_emission.x(), m_emission.y(), m_emission.z() }, 0.0 };
+    }
+
+private:
+    Vector3d m_emission = {};
+};
+
+#endif // DIFFUSE_LIGHT_H
@@ -29,6 +29,15 @@ public:
         return true;
     }
 
+    MaterialParameters parameters() const override {
+        return { MaterialType::Lambertian, 0, { m_albedo.x(), m_albedo.y(), m_albedo.z() }, 0.0 };
+    }
+
+    bool diffuseAlbedo(Vector3d& albedo) const override {
+        albedo = m_albedo;
+        return true;
+    }
+
 protected:
     Vector3d m_albedo = {};
 };
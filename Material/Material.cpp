@@ -0,0 +1,40 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#include "RayTracer/Arena.h"
+
+#include "Dielectric.h"
+#include "DiffuseLight.h"
+#include "Lambertian.h"
+#include "Metal.h"
+
+namespace {
+    template<typename T, typename... Args>
+    std::shared_ptr<Material> make(const std::shared_ptr<Arena>& arena, Args&&... args) {
+        if (arena != nullptr) {
+            return makeInArena<T>(arena, std::forward<Args>(args)...);
+        }
+        return std::make_shared<T>(std::forward<Args>(args)...);
+    }
+}
+
+std::shared_ptr<Material> makeMaterial(const MaterialParameters& parameters, const std::shared_ptr<Arena>& arena) {
+    Vector3d color(parameters.color[0], parameters.color[1], parameters.color[2]);
+    switch (parameters.type) {
+        case MaterialType::Lambertian:
+            return make<Lambertian>(arena, color);
+        case MaterialType::Metal:
+            return make<Metal>(arena, color, parameters.parameter);
+        case MaterialType::Dielectric:
+            return make<Dielectric>(arena, color, parameters.parameter);
+        case MaterialType::DiffuseLight:
+            return make<DiffuseLight>(arena, color);
+    }
+    return nullptr;
+}
@@ -14,11 +14,58 @@
 
 #include "RayTracer/RayTracer.h"
 
+class Arena;
 struct HitResult;
 
+enum class MaterialType : uint32_t {
+    Lambertian = 0,
+    Metal = 1,
+    Dielectric = 2,
+    DiffuseLight = 3
+};
+
+// Everything that defines a material, with the fixed layout of material tables in binary scene files.
+struct MaterialParameters {
+    MaterialType type = MaterialType::Lambertian;
+    uint32_t reserved = 0;
+    double color[3] = {}; // Albedo, the emission of lights.
+    double parameter = 0.0; // Fuzz of metals, refraction index of dielectrics.
+};
+
+static_assert(sizeof(MaterialParameters) == 40, "Binary scene files rely on 40-byte material parameters.");
+
+// Materials of equal parameters behave the same, so scenes intern them into one object.
+inline bool operator==(const MaterialParameters& a, const MaterialParameters& b) {
+    return a.type == b.type && a.color[0] == b.color[0] && a.color[1] == b.color[1] && a.color[2] == b.color[2] &&
+           a.parameter == b.parameter;
+}
+
+struct MaterialParametersHash {
+    size_t operator()(const MaterialParameters& parameters) const {
+        // std::hash<double> agrees with ==, also for 0.0 and -0.0.
+        size_t seed = static_cast<size_t>(parameters.type);
+        for (double value : { parameters.color[0], parameters.color[1], parameters.color[2], parameters.parameter }) {
+            seed ^= std::hash<double>()(value) + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+        }
+        return seed;
+    }
+};
+
 class Material {
 public:
     virtual bool scatter(const Ray& rayIn, const HitResult& result, Vector3d& attenuation, Ray& rayScattered) const = 0;
+
+    virtual MaterialParameters parameters() const = 0;
+
+    // Radiance emitted by the surface itself, black for all non-emissive materials.
+    virtual Vector3d emitted() const { return Vector3d::zero(); }
+
+    // Only ideal diffuse surfaces receive explicit light samples in direct lighting, they return true
+    // and set their albedo.
+    virtual bool diffuseAlbedo(Vector3d&) const { return false; }
 };
 
+// The material of parameters, allocated from arena when given, nullptr for an unknown type.
+std::shared_ptr<Material> makeMaterial(const MaterialParameters& parameters, const std::shared_ptr<Arena>& arena = nullptr);
+
 #endif // MATERIAL_H
\ No newline at end of file
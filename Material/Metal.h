@@ -24,6 +24,10 @@ public:
         return (dot(rayScattered.direction(), result.normal) > 0);
     }
 
+    MaterialParameters parameters() const override {
+        return { MaterialType::Metal, 0, { m_albedo.x(), m_albedo.y(), m_albedo.z() }, m_fuzz };
+    }
+
 private:
     Vector3d m_albedo = {};
 
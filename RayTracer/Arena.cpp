@@ -0,0 +1,27 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#include "Arena.h"
+
+void* Arena::allocate(size_t size, size_t alignment) {
+    auto address = reinterpret_cast<uintptr_t>(m_position);
+    auto aligned = (address + alignment - 1) / alignment * alignment;
+    if (m_position == nullptr || aligned + size > reinterpret_cast<uintptr_t>(m_end)) {
+        // Larger objects get a block of their own.
+        size_t blockSize = std::max(BlockSize, size + alignment);
+        m_blocks.emplace_back(new char[blockSize]);
+        m_position = m_blocks.back().get();
+        m_end = m_position + blockSize;
+        address = reinterpret_cast<uintptr_t>(m_position);
+        aligned = (address + alignment - 1) / alignment * alignment;
+    }
+    m_position += aligned - address + size;
+    m_bytesUsed += size;
+    return reinterpret_cast<void*>(aligned);
+}
@@ -0,0 +1,73 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "RayTracer.h"
+
+/*
+ * Bump allocator for objects that live as long as their scene, carved out of blocks of BlockSize bytes.
+ * Nothing is freed before the arena itself, which every ArenaAllocator keeps alive, so shared_ptrs made
+ * by makeInArena may outlive whoever built them. Not thread safe, scenes are built by one thread.
+ */
+class Arena {
+public:
+    static constexpr size_t BlockSize = 64 * 1024;
+
+    Arena() = default;
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t size, size_t alignment);
+
+    // Bytes handed out so far, without the padding and unused block ends.
+    inline size_t bytesUsed() const { return m_bytesUsed; }
+
+private:
+    std::vector<std::unique_ptr<char[]>> m_blocks = {};
+    char* m_position = nullptr;
+    char* m_end = nullptr;
+    size_t m_bytesUsed = 0;
+};
+
+template<typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator(std::shared_ptr<Arena> arena) : m_arena(std::move(arena)) {}
+
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : m_arena(other.arena()) {}
+
+    T* allocate(size_t n) { return static_cast<T*>(m_arena->allocate(n * sizeof(T), alignof(T))); }
+
+    void deallocate(T*, size_t) {}
+
+    inline const std::shared_ptr<Arena>& arena() const { return m_arena; }
+
+    template<typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return m_arena == other.arena(); }
+
+    template<typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return m_arena != other.arena(); }
+
+private:
+    std::shared_ptr<Arena> m_arena = nullptr;
+};
+
+// Object and reference counts in one allocation from arena, next to the objects made before.
+template<typename T, typename... Args>
+std::shared_ptr<T> makeInArena(const std::shared_ptr<Arena>& arena, Args&&... args) {
+    return std::allocate_shared<T>(ArenaAllocator<T>(arena), std::forward<Args>(args)...);
+}
+
+#endif // ARENA_H
@@ -0,0 +1,156 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#include <sstream>
+#include <stdexcept>
+
+#include "BatchJob.h"
+
+namespace {
+    double toReal(const std::string& where, const std::string& value) {
+        try {
+            size_t used = 0;
+            double result = std::stod(value, &used);
+            if (used == value.size() && std::isfinite(result)) return result;
+        }
+        catch (const std::exception&) {}
+        throw std::invalid_argument(where + " expects a number, got \"" + value + "\".");
+    }
+
+    int toPositiveInt(const std::string& where, const std::string& value) {
+        double result = toReal(where, value);
+        if (result < 1.0 || result != std::floor(result) || result > std::numeric_limits<int>::max()) {
+            throw std::invalid_argument(where + " expects an integer >= 1, got \"" + value + "\".");
+        }
+        return static_cast<int>(result);
+    }
+
+    Vector3d toVector(const std::string& where, const std::string& value) {
+        std::stringstream stream(value);
+        std::string component;
+        double xyz[3] = {};
+        int count = 0;
+        while (std::getline(stream, component, ',')) {
+            if (count == 3) break;
+            xyz[count++] = toReal(where, component);
+        }
+        if (count != 3 || !stream.eof()) {
+            throw std::invalid_argument(where + " expects x,y,z, got \"" + value + "\".");
+        }
+        return { xyz[0], xyz[1], xyz[2] };
+    }
+}
+
+std::vector<BatchJob> readBatchJobs(const std::string& filename, const RenderOptions& options, const CameraSettings& camera) {
+    std::ifstream fin(filename);
+    if (!fin) {
+        throw std::runtime_error("Cannot read job file " + filename + ".");
+    }
+
+    std::vector<BatchJob> jobs = {};
+    std::string line = {};
+    for (int lineNumber = 1; std::getline(fin, line); ++lineNumber) {
+        std::stringstream tokens(line);
+        std::string output = {};
+        if (!(tokens >> output) || output[0] == '#') continue;
+
+        BatchJob job = {};
+        job.output = output;
+        job.fileType = ExporterManager::fileTypeOf(output, options.asciiPpm);
+        job.width = options.imageWidth;
+        job.sampleCount = options.sampleCount;
+        job.tonemap = options.tonemap;
+        job.camera = camera;
+
+        std::string token = {};
+        while (tokens >> token) {
+            auto equals = token.find('=');
+            std::string key = token.substr(0, equals);
+            std::string where = filename + ":" + std::to_string(lineNumber) + ": " + key;
+            if (equals == std::string::npos) {
+                throw std::invalid_argument(where + " is not a key=value pair.");
+            }
+            std::string value = token.substr(equals + 1);
+
+            if (key == "width") {
+                job.width = toPositiveInt(where, value);
+            }
+            else if (key == "height") {
+                job.height = toPositiveInt(where, value);
+            }
+            else if (key == "spp") {
+                job.sampleCount = toPositiveInt(where, value);
+            }
+            else if (key == "position") {
+                job.camera.position = toVector(where, value);
+            }
+            else if (key == "look_at") {
+                job.camera.lookAt = toVector(where, value);
+            }
+            else if (key == "up") {
+                job.camera.up = toVector(where, value);
+            }
+            else if (key == "fov") {
+                job.camera.verticalFov = toReal(where, value);
+            }
+            else if (key == "aperture") {
+                job.camera.aperture = toReal(where, value);
+            }
+            else if (key == "focus") {
+                job.camera.focusDistance = toReal(where, value);
+            }
+            else {
+                throw std::invalid_argument(where + " is not a job key.");
+            }
+        }
+        if (job.height == 0) {
+            job.height = std::max(1, static_cast<int>(job.width / options.aspectRatio));
+            job.aspectRatio = options.aspectRatio;
+        }
+        else {
+            job.aspectRatio = static_cast<double>(job.width) / job.height;
+        }
+        jobs.push_back(job);
+    }
+    if (jobs.empty()) {
+        throw std::invalid_argument("Job file " + filename + " lists no frames.");
+    }
+    return jobs;
+}
+
+std::vector<BatchJob> flythroughJobs(const RenderOptions& options, const CameraSettings& camera, int frameCount) {
+    auto dot = options.output.find_last_of('.');
+    if (dot == std::string::npos || options.output.find_first_of("/\\", dot) != std::string::npos) {
+        dot = options.output.size();
+    }
+
+    std::vector<BatchJob> jobs = {};
+    Vector3d offset = camera.position - camera.lookAt;
+    for (int i = 0; i < frameCount; ++i) {
+        std::string number = std::to_string(i + 1);
+        number.insert(0, std::max(0, 4 - static_cast<int>(number.size())), '0');
+
+        BatchJob job = {};
+        job.output = options.output.substr(0, dot) + "_" + number + options.output.substr(dot);
+        job.fileType = ExporterManager::fileTypeOf(job.output, options.asciiPpm);
+        job.width = options.imageWidth;
+        job.height = options.imageHeight();
+        job.sampleCount = options.sampleCount;
+        job.tonemap = options.tonemap;
+        job.aspectRatio = options.aspectRatio;
+        job.camera = camera;
+
+        double angle = 2.0 * pi * i / frameCount;
+        double c = std::cos(angle), s = std::sin(angle);
+        job.camera.position = camera.lookAt +
+            Vector3d(c * offset.x() - s * offset.z(), offset.y(), s * offset.x() + c * offset.z());
+        jobs.push_back(job);
+    }
+    return jobs;
+}
@@ -0,0 +1,47 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#ifndef BATCH_JOB_H
+#define BATCH_JOB_H
+
+#include "Camera/Camera.h"
+#include "Exporter/ExporterManager.h"
+
+#include "RayTracer.h"
+#include "RenderOptions.h"
+
+// One frame of a batch, rendered from the resident scene.
+struct BatchJob {
+    std::string output = {};
+    ExporterManager::FileType fileType = ExporterManager::PNG;
+    int width = 0;
+    int height = 0;
+    int sampleCount = 0;
+    // Of the camera, width / height unless the height follows from options.aspectRatio like in single runs.
+    double aspectRatio = 1.0;
+    CameraSettings camera = {};
+    TonemapSettings tonemap = {};
+};
+
+/*
+ * Read a job file, one frame per line: the output path followed by optional key=value overrides
+ *
+ *     frames/0001.png width=640 height=360 spp=16 position=13,2,3 look_at=0,0,0 up=0,1,0 fov=20 aperture=0.1 focus=10
+ *
+ * Missing keys are taken from options and camera, the height from the width and options.aspectRatio.
+ * Blank lines and lines starting with # are skipped. Throws std::invalid_argument with the line number
+ * on bad input, std::runtime_error if the file cannot be read.
+ */
+std::vector<BatchJob> readBatchJobs(const std::string& filename, const RenderOptions& options, const CameraSettings& camera);
+
+// One turn of camera around its look-at point in frameCount frames, keeping its height. The frames are
+// written to options.output with the frame number before the extension, render_result_0001.png and so on.
+std::vector<BatchJob> flythroughJobs(const RenderOptions& options, const CameraSettings& camera, int frameCount);
+
+#endif // BATCH_JOB_H
@@ -7,45 +7,27 @@
  * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
 */
 
+#include "Light/DirectLighting.h"
 #include "Material/Material.h"
 
 #include "RayColor.h"
 
-Vector3d rayColor(const Ray& r, const std::vector<std::shared_ptr<Shape>>& shapeList, int depth, bool autoPriority) {
+bool closestHit(const Ray& r, const std::vector<std::shared_ptr<Shape>>& shapeList, bool autoPriority, HitResult& result) {
     HitResult hit = {};
 
-    // In case of stack overflow.
-    if (depth <= 0) return Vector3d::zero();
-
     /*
      * Compare depth priority automatically.
      */
     if (autoPriority) {
-        HitResult nearHit = {};
-        nearHit.t = infinity;
+        result.t = infinity;
         for (const auto& shape : shapeList) {
             if (shape->hit(r, 0.001, infinity, hit)) { // Do not hit children.
-                if (hit.t > 0.0 && hit.t < nearHit.t) {
-                    nearHit = hit;
+                if (hit.t > 0.0 && hit.t < result.t) {
+                    result = hit;
                 }
             }
         }
-        if (nearHit.t < infinity) {
-            Ray rayScattered = {};
-            Vector3d attenuation = {};
-            if (nearHit.material->scatter(r, nearHit, attenuation, rayScattered)) {
-                return attenuation * rayColor(rayScattered, shapeList, depth - 1, autoPriority);
-            }
-            else {
-                return Vector3d::zero();
-            }
-        }
-        else {
-            // Default sky background.
-            Vector3d unitDirection = normalize(r.direction());
-            auto t = 0.5 * (unitDirection.y() + 1.0);
-            return (1.0 - t) * Vector3d(1.0, 1.0, 1.0) + t * Vector3d(0.5, 0.7, 1.0);
-        }
+        return result.t < infinity;
     }
     /*
     * Use designated priority.
@@ -53,19 +35,47 @@ Vector3d rayColor(const Ray& r, const std::vector<std::shared_ptr<Shape>>& shape
     else {
         for (const auto& shape : shapeList) {
             if (shape->hit(r, 0.001, infinity, hit)) { // Do not hit children.
-                Ray rayScattered = {};
-                Vector3d attenuation = {};
-                if (hit.material->scatter(r, hit, attenuation, rayScattered)) {
-                    return attenuation * rayColor(rayScattered, shapeList, depth - 1, autoPriority);
-                }
-                else {
-                    return Vector3d::zero();
-                }
+                result = hit;
+                return true;
             }
         }
-        // Default sky background.
-        Vector3d unitDirection = normalize(r.direction());
-        auto t = 0.5 * (unitDirection.y() + 1.0);
-        return (1.0 - t) * Vector3d(1.0, 1.0, 1.0) + t * Vector3d(0.5, 0.7, 1.0);
+        return false;
+    }
+}
+
+Vector3d skyColor(const Ray& r) {
+    // Default sky background.
+    Vector3d unitDirection = normalize(r.direction());
+    auto t = 0.5 * (unitDirection.y() + 1.0);
+    return (1.0 - t) * Vector3d(1.0, 1.0, 1.0) + t * Vector3d(0.5, 0.7, 1.0);
+}
+
+Vector3d rayColor(const Ray& r, const std::vector<std::shared_ptr<Shape>>& shapeList, int depth, bool autoPriority) {
+    return rayColor(r, shapeList, nullptr, depth, autoPriority);
+}
+
+Vector3d rayColor(const Ray& r, const std::vector<std::shared_ptr<Shape>>& shapeList, const LightBVH* lights,
+                  int depth, bool autoPriority, bool countEmission) {
+    // In case of stack overflow.
+    if (depth <= 0) return Vector3d::zero();
+
+    HitResult hit = {};
+    if (!closestHit(r, shapeList, autoPriority, hit)) {
+        return skyColor(r);
+    }
+
+    Vector3d color = countEmission ? hit.material->emitted() : Vector3d::zero();
+
+    Vector3d albedo = {};
+    bool sampleLights = lights != nullptr && !lights->empty() && hit.material->diffuseAlbedo(albedo);
+    if (sampleLights) {
+        color += sampleDirectLight(hit, albedo, shapeList, *lights);
+    }
+
+    Ray rayScattered = {};
+    Vector3d attenuation = {};
+    if (hit.material->scatter(r, hit, attenuation, rayScattered)) {
+        color += attenuation * rayColor(rayScattered, shapeList, lights, depth - 1, autoPriority, !sampleLights);
     }
-}
\ No newline at end of file
+    return color;
+}
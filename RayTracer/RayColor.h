@@ -14,9 +14,21 @@
 #include <vector>
 
 #include "GraphMath/Vector3.hpp"
+#include "Light/LightBVH.h"
 #include "Ray/Ray.h"
 #include "Shape/Shape.h"
 
+bool closestHit(const Ray& r, const std::vector<std::shared_ptr<Shape>>& shapeList, bool autoPriority, HitResult& result);
+
+Vector3d skyColor(const Ray& r);
+
 Vector3d rayColor(const Ray& r, const std::vector<std::shared_ptr<Shape>>& shapeList, int depth, bool autoPriority);
 
+/*
+ * With a light hierarchy, diffuse hits sample one emitter by shadow ray, and the emission found by
+ * the following bounce is skipped (countEmission = false) to avoid counting the same light twice.
+ */
+Vector3d rayColor(const Ray& r, const std::vector<std::shared_ptr<Shape>>& shapeList, const LightBVH* lights,
+                  int depth, bool autoPriority, bool countEmission = true);
+
 #endif // RAY_COLOR_H
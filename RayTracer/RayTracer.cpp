@@ -7,112 +7,334 @@
  * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
 */
 
-#include <functional>
+#include <csignal>
 #include <future>
-#include <thread>
+#include <iomanip>
 
 #include "Exporter/ExporterManager.h"
+#include "Exporter/TiledImage.h"
+#include "Concurrency/BatchRenderer.h"
+#include "Concurrency/Checkpoint.h"
+#include "Concurrency/CpuTopology.h"
 #include "Concurrency/PartialProcessor.h"
-#include "Scene/Scene.h"
+#include "Concurrency/ProgressiveRenderer.h"
+#include "Concurrency/RenderProgress.h"
+#include "Concurrency/ThreadPool.h"
+#include "Concurrency/TileScheduler.h"
+#include "Distributed/Coordinator.h"
+#include "Distributed/PreviewServer.h"
+#include "Distributed/RenderWorker.h"
+#include "Scene/SceneLoader.h"
 
+#include "BatchJob.h"
 #include "RayTracer.h"
+#include "RenderOptions.h"
 
-std::default_random_engine defaultRandomEngine;
+thread_local std::default_random_engine defaultRandomEngine;
+
+namespace {
+    std::atomic<bool> renderInterrupted = false;
+
+    // First Ctrl+C finishes the image with the samples so far, the second one kills as usual.
+    void onInterrupt(int) {
+        renderInterrupted = true;
+        std::signal(SIGINT, SIG_DFL);
+    }
+}
 
 int main(int argc, char* argv[]) {
     try {
+        auto options = parseRenderOptions(argc, argv);
+        if (options.showHelp) {
+            printUsage(std::cout);
+            return 0;
+        }
+
+        if (!options.convertFile.empty()) {
+            std::cout << "Converting " << options.convertFile << " to " << options.output << "...\n";
+            if (!convertTiledImage(options.convertFile, options.output,
+                                   ExporterManager::fileTypeOf(options.output, options.asciiPpm), options.crop,
+                                   options.tonemap)) {
+                std::cout << "Failed to write " << options.output << '\n';
+            }
+            return 0;
+        }
+
+        // Workers take everything else from the coordinator.
+        if (!options.connectAddress.empty()) {
+            runRenderWorker(options.connectAddress, options.threadCount);
+            return 0;
+        }
+
+        // Scene files are read before anything else, their render settings size the image and the jobs.
+        std::unique_ptr<SceneDescription> sceneFile = nullptr;
+        auto loadSceneCost = std::chrono::high_resolution_clock::duration::zero();
+        if (isSceneFile(options.scene)) {
+            auto readStart = std::chrono::high_resolution_clock::now();
+            sceneFile = std::make_unique<SceneDescription>(readScene(options.scene));
+            loadSceneCost = std::chrono::high_resolution_clock::now() - readStart;
+            applySceneSettings(*sceneFile, options);
+            std::cout << "Read scene file " << options.scene << '.' << std::endl;
+        }
+
+        // Read the jobs up front, so that a bad line fails before the scene is built.
+        std::vector<BatchJob> batchJobs = {};
+        if (!options.batchFile.empty()) {
+            batchJobs = readBatchJobs(options.batchFile, options, sceneCameraSettings(options, sceneFile.get()));
+        }
+        else if (options.frameCount > 0) {
+            batchJobs = flythroughJobs(options, sceneCameraSettings(options, sceneFile.get()), options.frameCount);
+        }
+
         // Init random engine.
-        defaultRandomEngine = std::default_random_engine(std::chrono::system_clock::now().time_since_epoch().count());
+        unsigned seed = options.seed.has_value() ? options.seed.value() :
+            static_cast<unsigned>(std::chrono::system_clock::now().time_since_epoch().count());
+        if (options.resume) {
+            // The saved seed regenerates the same scene and sample streams.
+            auto checkpoint = readCheckpointHeader(options.checkpointFile);
+            seed = checkpoint.seed;
+            std::cout << "Resuming " << options.checkpointFile << " at " << checkpoint.state.finishedSampleCount
+                      << " spp." << std::endl;
+        }
+        defaultRandomEngine.seed(seed);
+
+        // Converting a scene takes the seeded engine of random scenes and plain workers for the generated
+        // one, but nothing of the renderer.
+        if (!options.sceneOutput.empty()) {
+            SceneDescription scene = {};
+            scene.camera = sceneCameraSettings(options, sceneFile.get());
+            std::shared_ptr<Camera> camera = nullptr;
+            ThreadPool generatorPool(options.threadCount);
+            loadScene(options, seed, camera, scene.shapes, sceneFile.get(), &generatorPool);
+            scene.imageWidth = options.imageWidth;
+            // The aspect ratio follows from the size, which may only round it when the height is left out.
+            if (static_cast<double>(options.imageWidth) / options.imageHeight() == options.aspectRatio) {
+                scene.imageHeight = options.imageHeight();
+            }
+            scene.sampleCount = options.sampleCount;
+            scene.maxDepth = options.maxDepth;
+            if (!writeBinaryScene(options.sceneOutput, scene)) {
+                throw std::runtime_error("Cannot write " + options.sceneOutput + ".");
+            }
+            std::cout << "Wrote " << options.scene << " to " << options.sceneOutput << ".\n";
+            return 0;
+        }
+
+        // Pinned workers are spread evenly over the CPUs, node by node, and grouped by node so that
+        // tiles and stolen tasks stay node-local as long as possible.
+        size_t threadCount = options.threadCount;
+        std::vector<int> workerCpus = {};
+        std::vector<int> workerNodes = {};
+        if (options.pinThreads) {
+            auto topology = CpuTopology::detect(options.emulatedNodeCount);
+            if (threadCount == 0) {
+                threadCount = topology.cpus.size();
+            }
+            for (size_t i = 0; i < threadCount; ++i) {
+                size_t slot = i * topology.cpus.size() / threadCount;
+                workerCpus.push_back(topology.cpus[slot]);
+                workerNodes.push_back(topology.nodes[slot]);
+            }
+            std::cout << "Pinning " << threadCount << " threads to " << topology.cpus.size() << " CPUs on "
+                      << topology.nodeCount << " NUMA nodes." << std::endl;
+        }
+
+        // Render workers live for the whole run, each with its own random stream.
+        ThreadPool pool(threadCount, [seed, &workerCpus](size_t index) {
+            if (index < workerCpus.size()) {
+                pinCurrentThread(workerCpus[index]);
+                // Tile buffers are allocated by the worker rendering the tile, so they get first-touched locally.
+                preferLocalMemory();
+            }
+            std::seed_seq sequence = { seed, static_cast<unsigned>(index + 1) };
+            defaultRandomEngine.seed(sequence);
+        }, workerNodes);
 
         // Image
-        const double aspectRatio = 16.0 / 9.0;
-        const int imageWidth = 800;
-        const int imageHeight = static_cast<int>(imageWidth / aspectRatio);
-        const int maxDepth = 50;
-        const int sampleCount = 50;
+        const int imageWidth = options.imageWidth;
+        const int imageHeight = options.imageHeight();
+        const int maxDepth = options.maxDepth;
+        const int sampleCount = options.sampleCount;
 
         /* Build scene start */
         auto buildSceneStart = std::chrono::high_resolution_clock::now();
-        // Camera
-        auto camera = randomBallsCamera(aspectRatio);
+        // Camera & Scene
+        std::shared_ptr<Camera> camera = nullptr;
+        std::vector<std::shared_ptr<Shape>> shapeList = {};
+        SceneStatistics statistics = {};
+        // The coordinator only hands out tiles, its workers build the scene.
+        if (options.serveAddress.empty()) {
+            loadScene(options, seed, camera, shapeList, sceneFile.get(), &pool, &statistics);
+        }
+        auto hierarchyStart = std::chrono::high_resolution_clock::now();
+        loadSceneCost += hierarchyStart - buildSceneStart;
 
-        // Scene
-        auto shapeList = randomBallsScene();
+        // Acceleration structures: the sphere hierarchy for hits, the light hierarchy for direct
+        // lighting, which is empty when there is no emitter.
+        size_t hierarchyNodeCount = buildHierarchies(shapeList, &pool);
+        auto lightsStart = std::chrono::high_resolution_clock::now();
+        auto lights = std::make_shared<LightBVH>(shapeList);
         /* Build scene end */
         auto buildSceneEnd = std::chrono::high_resolution_clock::now();
-        auto buildSceneCost = buildSceneEnd - buildSceneStart;
-        auto buildSceneUs = std::chrono::duration_cast<std::chrono::microseconds>(buildSceneCost).count();
-        auto buildSceneCostMs = buildSceneUs / 1000;
-        auto buildSceneCostUs = buildSceneUs % 1000;
+        auto loadSceneUs = std::chrono::duration_cast<std::chrono::microseconds>(loadSceneCost).count();
+        auto buildHierarchyUs = std::chrono::duration_cast<std::chrono::microseconds>(lightsStart - hierarchyStart).count();
+        auto buildLightsUs = std::chrono::duration_cast<std::chrono::microseconds>(buildSceneEnd - lightsStart).count();
+        if (options.serveAddress.empty()) {
+            std::cout << "Scene has " << statistics.sphereCount << " spheres and " << statistics.materialCount
+                      << " materials, interned to " << statistics.distinctMaterialCount << " (" << std::fixed
+                      << std::setprecision(2) << statistics.dedupRatio() << "x dedup)." << std::defaultfloat
+                      << std::setprecision(6) << std::endl;
+        }
 
         /* Render scene start */
         auto renderSceneStart = std::chrono::high_resolution_clock::now();
         // Render
         ExporterManager em = {};
-        em.startWrite(imageWidth, imageHeight);
+        em.setTonemap(options.tonemap);
+        // One-shot local renders flush finished tiles straight into a tiled output as chunks.
+        TiledImageWriter tiles = {};
+        bool tiledOutput = ExporterManager::fileTypeOf(options.output) == ExporterManager::TILED && batchJobs.empty() &&
+                           !options.progressive && options.serveAddress.empty();
+        if (tiledOutput) {
+            if (!tiles.open(options.output, imageWidth, imageHeight)) {
+                throw std::runtime_error("Cannot create " + options.output + ".");
+            }
+        }
+        else if (options.mappedOutput) {
+            if (!em.startMappedWrite(options.output, ExporterManager::fileTypeOf(options.output), imageWidth, imageHeight)) {
+                throw std::runtime_error("Cannot map " + options.output + " for writing.");
+            }
+        }
+        else if (batchJobs.empty()) {
+            em.startWrite(imageWidth, imageHeight, ExporterManager::isHdr(ExporterManager::fileTypeOf(options.output)));
+            em.setThreadPool(&pool);
+        }
 
         // Split the image to take advantage of multithreading to accelerate rendering.
         PartialSceneInfo sceneInfo(shapeList);
         sceneInfo.fullSize = { imageWidth, imageHeight };
         sceneInfo.camera = camera;
+        sceneInfo.lights = lights;
         sceneInfo.maxDepth = maxDepth;
         sceneInfo.sampleCount = sampleCount;
+        sceneInfo.seed = seed;
+        sceneInfo.directLighting = options.directLighting;
+        sceneInfo.restir = options.restir;
 
-        int dispatchCountX = 16;
-        int dispatchCountY = 16;
-
-        int partialWidth = imageWidth / dispatchCountX;
-        int partialHeight = imageHeight / dispatchCountY;
-
-        std::vector<PartialProcessor> partials;
-        partials.reserve((dispatchCountX + 1) * (dispatchCountY + 1));
-
-        std::vector<std::future<void>> tasks;
-        tasks.reserve((dispatchCountX + 1) * (dispatchCountY + 1));
-
-        std::cout << "Building partial processors..." << std::endl;
-        int partialID = 0;
-        for (int i = 0; i <= dispatchCountX; ++i) {
-            for (int j = 0; j <= dispatchCountY; ++j) {
-                sceneInfo.widthRange = {partialWidth * i, partialWidth * (i + 1) - 1 };
-                if (sceneInfo.widthRange.second >= imageWidth) {
-                    if (sceneInfo.widthRange.first >= imageWidth) continue;
-                    sceneInfo.widthRange.second = imageWidth - 1;
-                }
-                sceneInfo.heightRange = {partialHeight * j, partialHeight * (j + 1) - 1 };
-                if (sceneInfo.heightRange.second >= imageHeight) {
-                    if (sceneInfo.heightRange.first >= imageHeight) continue;
-                    sceneInfo.heightRange.second = imageHeight - 1;
-                }
-                partials.emplace_back(sceneInfo, partialID);
-                tasks.emplace_back(std::async([&,partialID] { partials[partialID].process(); }));
-                ++partialID;
-            }
-        }
-
-        size_t totalCount = tasks.size();
-        size_t lastFinished = 0, currFinished = 0;
-        std::function<size_t()> finishedCount = [&]() -> size_t {
-            return std::count_if(tasks.begin(), tasks.end(), [&](const std::future<void>& task) {
-                return task.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
-            });
+
+        // Viewers of the live preview watch the image fill in, the progressive mode shows its passes instead.
+        std::unique_ptr<PreviewServer> livePreview = nullptr;
+        auto startLivePreview = [&](PreviewServer::FrameSource source) {
+            if (!options.livePreviewAddress.empty()) {
+                livePreview = std::make_unique<PreviewServer>(options.livePreviewAddress, imageWidth, imageHeight,
+                                                              std::move(source), options.livePreviewWidth);
+                std::cout << "Streaming live previews on " << options.livePreviewAddress << std::endl;
+            }
         };
-        while ((currFinished = finishedCount()) != totalCount) {
-            if (currFinished > lastFinished) {
-                std::cout << "Finished partial count " << currFinished << " / " << totalCount << std::endl;
-                lastFinished = currFinished;
+        auto imagePreview = [&em](size_t width, size_t height, uint8_t* rgb) { em.preview(width, height, rgb); };
+
+        if (!options.serveAddress.empty()) {
+            startLivePreview(imagePreview);
+            Coordinator coordinator(options, seed);
+            coordinator.run(options.serveAddress, em);
+        }
+        else if (!batchJobs.empty()) {
+            BatchRenderer renderer(pool, sceneInfo, options.tileSize);
+            std::cout << "Rendering " << batchJobs.size() << " frames on " << pool.size() << " threads..." << std::endl;
+            auto result = renderer.render(batchJobs, options.progressInterval);
+            std::cout << "Rendered " << result.frameCount << " frames in " << result.seconds << " s, "
+                      << result.seconds / result.frameCount << " s per frame, writing took "
+                      << result.writeSeconds << " s alongside.\n";
+            if (result.failedCount > 0) {
+                std::cout << result.failedCount << " frames could not be written.\n";
+            }
+        }
+        else if (options.progressive) {
+            sceneInfo.cancel = &renderInterrupted;
+            std::signal(SIGINT, onInterrupt);
+
+            ProgressiveSettings settings = {};
+            settings.totalSampleCount = sampleCount;
+            settings.passSampleCount = options.passSampleCount;
+            settings.previewFile = options.previewFile;
+            settings.previewTonemap = options.tonemap;
+            settings.timeBudget = options.timeBudget;
+            settings.noiseTarget = options.noiseTarget;
+            settings.progressInterval = options.progressInterval;
+            settings.checkpointFile = options.checkpointFile;
+            settings.checkpointInterval = options.checkpointInterval;
+            settings.renderHash = renderHash(options, statistics);
+
+            ProgressiveRenderer renderer(pool, sceneInfo, options.tileSize);
+            if (options.resume) {
+                renderer.resume(options.checkpointFile, settings.renderHash);
+            }
+            startLivePreview([&renderer, &options](size_t width, size_t height, uint8_t* rgb) {
+                renderer.accumulation().preview(width, height, options.tonemap, rgb);
+            });
+            auto result = renderer.render(settings);
+            if (livePreview != nullptr) {
+                livePreview->finish();
+            }
+            if (renderInterrupted) {
+                std::cout << "Render interrupted, keeping " << renderer.accumulation().totalSampleCount()
+                          << " samples.\n";
             }
-            std::this_thread::yield();
+            std::cout << "Reached " << result.averageSampleCount << " spp in " << result.passCount << " passes and "
+                      << result.seconds << " s, estimated error " << 100.0 * result.estimatedError << " %.\n";
+            if (!options.checkpointFile.empty()) {
+                std::cout << "Checkpoints took " << result.checkpointSeconds << " s.\n";
+            }
+            renderer.accumulation().resolve(em);
         }
+        else {
+            RenderProgress progress = {};
+            sceneInfo.progress = &progress;
+
+            TileScheduler scheduler(imageWidth, imageHeight, options.tileSize, pool.size(), pool.groupCount());
+            std::cout << "Rendering " << scheduler.tileCount() << " tiles on " << pool.size() << " threads..." << std::endl;
+
+            progress.start(static_cast<uint64_t>(imageWidth) * imageHeight * sampleCount, pool.size());
+            // Tiles cover disjoint pixels, so they write the final image directly, and PNG strips are
+            // encoded by the worker finishing their last tile.
+            sceneInfo.output = &em;
+            if (tiledOutput) {
+                sceneInfo.tiles = &tiles;
+            }
+            else if (ExporterManager::fileTypeOf(options.output, options.asciiPpm) == ExporterManager::PNG) {
+                em.streamPng();
+            }
+            startLivePreview(imagePreview);
+            auto tasks = scheduler.dispatch(pool, progress, [&](const Tile& tile) {
+                PartialProcessor(tileSceneInfo(sceneInfo, tile), 0).process();
+                em.markWritten(tile.widthRange.first, tile.heightRange.first, tile.width(), tile.height());
+            });
 
+            // Sleep until the tiles are done, waking up only to report.
+            progress.wait(std::cout, options.progressInterval);
+            for (auto& task : tasks) {
+                task.get();
+            }
+            auto tailLatency = std::chrono::steady_clock::now() - scheduler.firstIdle();
+            std::cout << "Tail latency (first idle thread to last tile) "
+                      << std::chrono::duration_cast<std::chrono::milliseconds>(tailLatency).count() << " ms.\n";
+        }
 
-        std::cout << "Writing partial images to final full image...\n";
-        for (const auto& partial : partials) {
-            partial.writeToFullImage(em.buffer());
+        if (livePreview != nullptr) {
+            livePreview->finish();
         }
 
-        std::cout << "Generating render result...\n";
-        em.endWrite("render_result.png", ExporterManager::PNG);
+        if (tiledOutput) {
+            if (!tiles.close()) {
+                std::cout << "Failed to write " << options.output << '\n';
+            }
+        }
+        else if (batchJobs.empty()) {
+            std::cout << "Generating render result...\n";
+            if (!em.endWrite(options.output, ExporterManager::fileTypeOf(options.output, options.asciiPpm))) {
+                std::cout << "Failed to write " << options.output << '\n';
+            }
+        }
         /* Render scene end */
         auto renderSceneEnd = std::chrono::high_resolution_clock::now();
         auto renderSceneCost = renderSceneEnd - renderSceneStart;
@@ -120,7 +342,10 @@ int main(int argc, char* argv[]) {
         auto renderSceneCostMin = renderSceneSecs / 60;
         auto renderSceneCostSec = renderSceneSecs % 60;
 
-        std::cout << "Build finished in " << buildSceneCostMs << " ms, " << buildSceneCostUs << " us. " <<
+        std::cout << "Scene loaded in " << loadSceneUs / 1000 << " ms, " << loadSceneUs % 1000 << " us. " <<
+            "Sphere hierarchy of " << hierarchyNodeCount << " nodes built in " << buildHierarchyUs / 1000 << " ms, " <<
+            buildHierarchyUs % 1000 << " us. " <<
+            "Light hierarchy built in " << buildLightsUs / 1000 << " ms, " << buildLightsUs % 1000 << " us. " <<
             "Render finished in " << renderSceneCostMin << " min, " << renderSceneCostSec << " sec.\n";
     }
     catch (const std::exception& e) {
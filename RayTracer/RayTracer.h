@@ -53,9 +53,47 @@ inline double degree(double radians) {
     return radians * 180.0 / pi;
 }
 
+// Rec. 709 relative luminance
+inline double luminance(const Vector3d& color) {
+    return 0.2126 * color.r() + 0.7152 * color.g() + 0.0722 * color.b();
+}
+
+#include <new>
+
+constexpr size_t cacheLineSize = 64;
+
+// Starts buffers on a cache line, so that threads writing disjoint aligned ranges never share one.
+template<typename T, size_t Alignment = cacheLineSize>
+struct AlignedAllocator {
+    using value_type = T;
+
+    template<typename U>
+    struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+    AlignedAllocator() = default;
+
+    template<typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+    inline T* allocate(size_t count) {
+        return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(Alignment)));
+    }
+
+    inline void deallocate(T* pointer, size_t) {
+        ::operator delete(pointer, std::align_val_t(Alignment));
+    }
+
+    template<typename U>
+    inline bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+
+    template<typename U>
+    inline bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+};
+
 #include <random>
 
-extern std::default_random_engine defaultRandomEngine;
+// One engine per thread, every render thread must seed its own.
+extern thread_local std::default_random_engine defaultRandomEngine;
 
 inline double randomReal() {
     std::uniform_real_distribution<double> range(0.0, 1.0f); // [0.0, 1.0]
@@ -0,0 +1,372 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#include <stdexcept>
+
+#include "Exporter/ExporterManager.h"
+#include "RenderOptions.h"
+
+namespace {
+    int toInt(const std::string& name, const std::string& value, int minValue = 1) {
+        try {
+            size_t used = 0;
+            int result = std::stoi(value, &used);
+            if (used == value.size() && result >= minValue) return result;
+        }
+        catch (const std::exception&) {}
+        throw std::invalid_argument("Option " + name + " expects an integer >= " + std::to_string(minValue) +
+                                    ", got \"" + value + "\".");
+    }
+
+    double toPositiveReal(const std::string& name, const std::string& value) {
+        try {
+            size_t used = 0;
+            double result = std::stod(value, &used);
+            if (used == value.size() && result > 0.0) return result;
+        }
+        catch (const std::exception&) {}
+        throw std::invalid_argument("Option " + name + " expects a positive number, got \"" + value + "\".");
+    }
+
+    double toNonNegativeReal(const std::string& name, const std::string& value) {
+        return value == "0" ? 0.0 : toPositiveReal(name, value);
+    }
+
+    inline bool hasExtension(const std::string& value, const std::string& extension) {
+        return value.size() > extension.size() &&
+               value.compare(value.size() - extension.size(), extension.size(), extension) == 0;
+    }
+
+    // x,y,width,height with a positive size.
+    // d,m,g,l weights of the generated materials, not all zero.
+    void toMaterialMix(const std::string& name, const std::string& value, double mix[4]) {
+        size_t start = 0;
+        double total = 0.0;
+        for (int k = 0; k < 4; ++k) {
+            size_t end = k < 3 ? value.find(',', start) : value.size();
+            if (end == std::string::npos) {
+                throw std::invalid_argument("Option " + name + " expects diffuse,metal,glass,light weights, got \"" +
+                                            value + "\".");
+            }
+            mix[k] = toNonNegativeReal(name, value.substr(start, end - start));
+            total += mix[k];
+            start = end + 1;
+        }
+        if (total <= 0.0) {
+            throw std::invalid_argument("Option " + name + " expects at least one positive weight.");
+        }
+    }
+
+    ImageRegion toRegion(const std::string& name, const std::string& value) {
+        int numbers[4] = {};
+        size_t start = 0;
+        for (int k = 0; k < 4; ++k) {
+            size_t end = k < 3 ? value.find(',', start) : value.size();
+            if (end == std::string::npos) {
+                throw std::invalid_argument("Option " + name + " expects x,y,width,height, got \"" + value + "\".");
+            }
+            numbers[k] = toInt(name, value.substr(start, end - start), k < 2 ? 0 : 1);
+            start = end + 1;
+        }
+        return { static_cast<size_t>(numbers[0]), static_cast<size_t>(numbers[1]),
+                 static_cast<size_t>(numbers[2]), static_cast<size_t>(numbers[3]) };
+    }
+}
+
+RenderOptions parseRenderOptions(int argc, char* argv[]) {
+    RenderOptions options = {};
+    bool sampleCountGiven = false;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string name = argv[i];
+        if (name == "--help" || name == "-h") {
+            options.showHelp = true;
+            continue;
+        }
+        if (name == "--progressive") {
+            options.progressive = true;
+            continue;
+        }
+        if (name == "--resume") {
+            options.resume = true;
+            continue;
+        }
+        if (name == "--pin-threads") {
+            options.pinThreads = true;
+            continue;
+        }
+        if (name == "--ppm-ascii") {
+            options.asciiPpm = true;
+            continue;
+        }
+        if (name == "--mmap-output") {
+            options.mappedOutput = true;
+            continue;
+        }
+        if (name == "--srgb") {
+            options.tonemap.curve = TransferCurve::Srgb;
+            continue;
+        }
+        if (name == "--dither") {
+            options.tonemap.dither = true;
+            continue;
+        }
+
+        if (i + 1 >= argc) {
+            throw std::invalid_argument("Option " + name + " expects a value.");
+        }
+        std::string value = argv[++i];
+        options.givenOptions.insert(name);
+
+        if (name == "--width") {
+            options.imageWidth = toInt(name, value);
+        }
+        else if (name == "--depth") {
+            options.maxDepth = toInt(name, value);
+        }
+        else if (name == "--spp") {
+            options.sampleCount = toInt(name, value);
+            sampleCountGiven = true;
+        }
+        else if (name == "--scene") {
+            if (value != "random_balls" && value != "test" && value != "many_lights" && value != "generated" &&
+                !hasExtension(value, ".scene") && !hasExtension(value, ".rtscene")) {
+                throw std::invalid_argument("Unknown scene \"" + value + "\", expected a built-in name or a "
+                                            ".scene or .rtscene file.");
+            }
+            options.scene = value;
+        }
+        else if (name == "--lights") {
+            options.lightCount = toInt(name, value);
+        }
+        else if (name == "--spheres") {
+            options.generator.sphereCount = static_cast<size_t>(toInt(name, value));
+        }
+        else if (name == "--density") {
+            options.generator.density = toPositiveReal(name, value);
+            if (options.generator.density > 1.0) {
+                throw std::invalid_argument("Option --density expects a share of the ground up to 1.");
+            }
+        }
+        else if (name == "--material-mix") {
+            toMaterialMix(name, value, options.generator.materialMix);
+        }
+        else if (name == "--clusters") {
+            options.generator.clusterCount = toInt(name, value, 0);
+        }
+        else if (name == "--direct") {
+            if (value == "nee") {
+                options.directLighting = DirectLightingMode::NextEvent;
+            }
+            else if (value == "restir") {
+                options.directLighting = DirectLightingMode::ReSTIR;
+            }
+            else {
+                throw std::invalid_argument("Unknown direct lighting mode \"" + value + "\".");
+            }
+        }
+        else if (name == "--restir-candidates") {
+            options.restir.candidateCount = toInt(name, value);
+        }
+        else if (name == "--restir-neighbors") {
+            options.restir.spatialNeighbors = toInt(name, value, 0);
+        }
+        else if (name == "--restir-radius") {
+            options.restir.spatialRadius = toInt(name, value);
+        }
+        else if (name == "--restir-history") {
+            options.restir.temporalMaxM = toInt(name, value, 0);
+        }
+        else if (name == "--pass-spp") {
+            options.passSampleCount = toInt(name, value);
+        }
+        else if (name == "--preview") {
+            options.previewFile = value;
+        }
+        else if (name == "--live-preview") {
+            options.livePreviewAddress = value;
+        }
+        else if (name == "--live-preview-width") {
+            options.livePreviewWidth = toInt(name, value);
+        }
+        else if (name == "--time-budget") {
+            options.timeBudget = toPositiveReal(name, value);
+        }
+        else if (name == "--noise-target") {
+            options.noiseTarget = toPositiveReal(name, value);
+        }
+        else if (name == "--checkpoint") {
+            options.checkpointFile = value;
+        }
+        else if (name == "--checkpoint-interval") {
+            options.checkpointInterval = toNonNegativeReal(name, value);
+        }
+        else if (name == "--serve") {
+            options.serveAddress = value;
+        }
+        else if (name == "--connect") {
+            options.connectAddress = value;
+        }
+        else if (name == "--tile-timeout") {
+            options.tileTimeout = toNonNegativeReal(name, value);
+        }
+        else if (name == "--threads") {
+            options.threadCount = toInt(name, value, 0);
+        }
+        else if (name == "--numa-nodes") {
+            options.emulatedNodeCount = toInt(name, value, 0);
+        }
+        else if (name == "--tile-size") {
+            options.tileSize = toInt(name, value, 8);
+        }
+        else if (name == "--progress-interval") {
+            options.progressInterval = toNonNegativeReal(name, value);
+        }
+        else if (name == "--seed") {
+            options.seed = static_cast<unsigned>(toInt(name, value, 0));
+        }
+        else if (name == "--batch") {
+            options.batchFile = value;
+        }
+        else if (name == "--frames") {
+            options.frameCount = toInt(name, value);
+        }
+        else if (name == "--tonemap") {
+            if (value == "clamp") {
+                options.tonemap.toneMapping = ToneMapping::Clamp;
+            }
+            else if (value == "reinhard") {
+                options.tonemap.toneMapping = ToneMapping::Reinhard;
+            }
+            else if (value == "aces") {
+                options.tonemap.toneMapping = ToneMapping::Aces;
+            }
+            else {
+                throw std::invalid_argument("Unknown tone mapping \"" + value + "\".");
+            }
+        }
+        else if (name == "--output") {
+            options.output = value;
+        }
+        else if (name == "--write-scene") {
+            if (!hasExtension(value, ".rtscene")) {
+                throw std::invalid_argument("Option --write-scene writes binary .rtscene files only.");
+            }
+            options.sceneOutput = value;
+        }
+        else if (name == "--convert") {
+            options.convertFile = value;
+        }
+        else if (name == "--crop") {
+            options.crop = toRegion(name, value);
+        }
+        else {
+            throw std::invalid_argument("Unknown option " + name + ", see --help.");
+        }
+    }
+
+    if (options.resume && options.checkpointFile.empty()) {
+        throw std::invalid_argument("Option --resume needs --checkpoint <file>.");
+    }
+    if (!options.checkpointFile.empty()) {
+        options.progressive = true;
+    }
+    if (!options.serveAddress.empty() && options.progressive) {
+        throw std::invalid_argument("Option --serve renders one frame, it does not combine with progressive modes.");
+    }
+
+    // Budget and noise modes are progressive, and only bounded by --spp when it is given.
+    if (options.timeBudget > 0.0 || options.noiseTarget > 0.0) {
+        options.progressive = true;
+        if (!sampleCountGiven) {
+            options.sampleCount = std::numeric_limits<int>::max();
+        }
+    }
+
+    bool batch = !options.batchFile.empty() || options.frameCount > 0;
+    if (!options.batchFile.empty() && options.frameCount > 0) {
+        throw std::invalid_argument("Options --batch and --frames exclude each other.");
+    }
+    if (batch && (options.progressive || !options.serveAddress.empty())) {
+        throw std::invalid_argument("Options --batch and --frames render one-shot frames locally, they do not "
+                                    "combine with progressive modes or --serve.");
+    }
+    if (!options.livePreviewAddress.empty()) {
+        if (batch) {
+            throw std::invalid_argument("Option --live-preview shows single frames, it does not combine with "
+                                        "--batch or --frames.");
+        }
+        if (!options.progressive && options.serveAddress.empty() &&
+            ExporterManager::fileTypeOf(options.output) == ExporterManager::TILED) {
+            throw std::invalid_argument("Option --live-preview needs an image in memory, which one-shot .rtt "
+                                        "renders skip.");
+        }
+    }
+    if (options.crop.width > 0 && options.convertFile.empty()) {
+        throw std::invalid_argument("Option --crop needs --convert <file>.");
+    }
+    if (options.mappedOutput) {
+        auto type = ExporterManager::fileTypeOf(options.output, options.asciiPpm);
+        if (type != ExporterManager::PPM && type != ExporterManager::PFM) {
+            throw std::invalid_argument("Option --mmap-output writes binary .ppm or .pfm files only.");
+        }
+        if (batch || options.progressive) {
+            throw std::invalid_argument("Option --mmap-output writes one-shot single frames only.");
+        }
+    }
+    return options;
+}
+
+void printUsage(std::ostream& out) {
+    out << "Usage: RayTracer [options]\n"
+           "  --width <n>               Image width, height follows 16:9 (800)\n"
+           "  --spp <n>                 Samples per pixel (50)\n"
+           "  --depth <n>               Max bounce depth (50)\n"
+           "  --scene <name|file>       random_balls | test | many_lights | generated, or a .scene or .rtscene file (random_balls)\n"
+           "  --lights <n>              Light count of the many_lights scene (1000)\n"
+           "  --spheres <n>             Sphere count of the generated scene (1000000)\n"
+           "  --density <d>             Share of the ground covered by generated spheres, up to 1 (0.3)\n"
+           "  --material-mix <d,m,g,l>  Weights of diffuse, metal, glass and light generated spheres (0.8,0.15,0.05,0)\n"
+           "  --clusters <n>            Gather generated spheres in n clusters, 0 for a uniform field (0)\n"
+           "  --direct <mode>           nee | restir (nee)\n"
+           "  --restir-candidates <n>   Initial light candidates per pixel (4)\n"
+           "  --restir-neighbors <n>    Spatial neighbors reused per pixel (4)\n"
+           "  --restir-radius <n>       Spatial reuse radius in pixels (16)\n"
+           "  --restir-history <n>      Cap of reused frame history in initial candidates, 0 disables (5)\n"
+           "  --progressive             Render passes into a float buffer, Ctrl+C stops with a valid image\n"
+           "  --pass-spp <n>            Samples per pixel of each progressive pass (4)\n"
+           "  --preview <file>          Snapshot written after each progressive pass\n"
+           "  --live-preview <address>  Stream the render in progress as motion JPEG over HTTP, [tcp:]host:port\n"
+           "  --live-preview-width <n>  Width of the streamed frames (640)\n"
+           "  --time-budget <seconds>   Progressive render that ends within the wall-clock budget\n"
+           "  --noise-target <error>    Progressive render until the relative error is below, e.g. 0.05\n"
+           "  --checkpoint <file>       Save progressive state periodically and at the end, implies --progressive\n"
+           "  --checkpoint-interval <s> Seconds between checkpoints (300)\n"
+           "  --resume                  Continue from --checkpoint, with its seed, same image as a straight run\n"
+           "  --serve <address>         Coordinate worker processes, unix:/path or [tcp:]host:port\n"
+           "  --connect <address>       Run as a worker of the coordinator at address, scene comes from it\n"
+           "  --tile-timeout <s>        Hand out unanswered tiles again after s seconds, 0 for never (0)\n"
+           "  --threads <n>             Render worker threads, 0 for all hardware threads (0)\n"
+           "  --pin-threads             Pin workers to CPUs, schedule tiles per NUMA node before stealing\n"
+           "  --numa-nodes <n>          Emulate n NUMA nodes for --pin-threads, 0 to detect (0)\n"
+           "  --tile-size <n>           Tile edge in pixels, tiles are split near the end of a frame (32)\n"
+           "  --progress-interval <s>   Seconds between progress, Msamples/s and ETA reports, 0 for none (1)\n"
+           "  --seed <n>                Random seed for scene generation and sampling (clock)\n"
+           "  --batch <file>            Render the frames listed in a job file, scene and threads stay resident\n"
+           "  --frames <n>              Render n frames of a camera orbit as a batch, numbered after --output\n"
+           "  --output <file>           .png, .ppm, or linear float .pfm, .hdr, .exr, tiled .rtt result (render_result.png)\n"
+           "  --tonemap <op>            8-bit tone mapping: clamp, reinhard or aces (clamp)\n"
+           "  --srgb                    sRGB transfer curve for 8-bit outputs instead of gamma 2\n"
+           "  --dither                  Ordered dither instead of rounding for 8-bit outputs\n"
+           "  --ppm-ascii               Write .ppm as plain text P3 instead of binary P6\n"
+           "  --mmap-output             Write .ppm or .pfm tiles straight into a mapped file, for huge images\n"
+           "  --convert <file.rtt>      Convert a tiled image to --output instead of rendering\n"
+           "  --crop <x,y,w,h>          Convert only this region of the tiled image\n"
+           "  --write-scene <file>      Write the scene with camera and render settings as binary .rtscene, no render\n";
+}
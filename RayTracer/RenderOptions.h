@@ -0,0 +1,106 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#ifndef RENDER_OPTIONS_H
+#define RENDER_OPTIONS_H
+
+#include <set>
+
+#include "Exporter/TiledImage.h"
+#include "Exporter/Tonemap.h"
+#include "Light/ReSTIR.h"
+#include "Scene/SceneGenerator.h"
+
+#include "RayTracer.h"
+
+struct RenderOptions {
+    // Image
+    double aspectRatio = 16.0 / 9.0;
+    int imageWidth = 800;
+    int maxDepth = 50;
+    int sampleCount = 50;
+
+    // Scene, a built-in name or a scene file, see SceneFile.h.
+    std::string scene = "random_balls";
+    int lightCount = 1000;
+    // Settings of the generated scene.
+    GeneratorSettings generator = {};
+
+    // Lighting
+    DirectLightingMode directLighting = DirectLightingMode::NextEvent;
+    ReSTIRSettings restir = {};
+
+    // Progressive passes over the whole frame, stoppable with Ctrl+C.
+    bool progressive = false;
+    int passSampleCount = 4;
+    std::string previewFile = {};
+    // Address of a motion JPEG stream of the render in progress, none when empty.
+    std::string livePreviewAddress = {};
+    int livePreviewWidth = 640;
+    // Render until the budget in seconds is used or the estimated relative error is reached.
+    double timeBudget = 0.0;
+    double noiseTarget = 0.0;
+    // Progressive state saved for --resume, every checkpointInterval seconds and at the end.
+    std::string checkpointFile = {};
+    double checkpointInterval = 300.0;
+    bool resume = false;
+
+    // Render worker count, zero for one per hardware thread.
+    size_t threadCount = 0;
+    // Pin workers to CPUs and keep scheduling NUMA-node-local, optionally on emulated nodes.
+    bool pinThreads = false;
+    int emulatedNodeCount = 0;
+    // Edge length in pixels of the tiles handed to the workers, the last ones are split further.
+    int tileSize = 32;
+    // Seconds between progress reports, zero for none.
+    double progressInterval = 1.0;
+
+    // Coordinator address to serve tiles on, or to join as a worker process.
+    std::string serveAddress = {};
+    std::string connectAddress = {};
+    // Seconds before an unanswered tile is handed out once more, zero to wait for lost workers only.
+    double tileTimeout = 0.0;
+
+    // Job file of frames rendered one after another from the same scene and workers, see BatchJob.h.
+    std::string batchFile = {};
+    // Frames of a camera orbit around the scene rendered like a batch, zero for a single image.
+    int frameCount = 0;
+
+    std::string output = "render_result.png";
+    // Write .ppm files as plain text P3 instead of binary P6.
+    bool asciiPpm = false;
+    // Write a binary .ppm or .pfm output through a memory mapping of the file instead of a framebuffer.
+    bool mappedOutput = false;
+    // How 8-bit outputs are made from the linear radiance.
+    TonemapSettings tonemap = {};
+
+    // Tiled image (.rtt) converted to --output instead of rendering, cropped to crop unless that is empty.
+    std::string convertFile = {};
+    ImageRegion crop = {};
+
+    // Binary scene (.rtscene) the scene is written to instead of rendering it.
+    std::string sceneOutput = {};
+
+    // Fixed seed makes generated scenes and noise reproducible, otherwise seeded by clock.
+    std::optional<unsigned> seed = std::nullopt;
+
+    bool showHelp = false;
+
+    // Names of the options with a value given on the command line, which win over scene file settings.
+    std::set<std::string> givenOptions = {};
+
+    inline int imageHeight() const { return static_cast<int>(imageWidth / aspectRatio); }
+};
+
+// Parse "--name value" style arguments, throws std::invalid_argument on bad input.
+RenderOptions parseRenderOptions(int argc, char* argv[]);
+
+void printUsage(std::ostream& out);
+
+#endif // RENDER_OPTIONS_H
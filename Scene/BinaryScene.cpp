@@ -0,0 +1,224 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "BinaryScene.h"
+#include "RayTracer/Arena.h"
+#include "Shape/Sphere.h"
+
+namespace {
+    inline uint64_t alignArray(uint64_t offset) {
+        constexpr uint64_t alignment = BinarySceneHeader::ArrayAlignment;
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+
+    inline Vector3d toVector(const double xyz[3]) {
+        return { xyz[0], xyz[1], xyz[2] };
+    }
+
+    inline void fromVector(const Vector3d& v, double xyz[3]) {
+        xyz[0] = v.x();
+        xyz[1] = v.y();
+        xyz[2] = v.z();
+    }
+}
+
+SceneDescription readBinaryScene(const std::string& filename) {
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot read scene file " + filename + ".");
+    }
+    struct stat status = {};
+    size_t size = 0;
+    void* map = MAP_FAILED;
+    if (::fstat(fd, &status) == 0 && static_cast<size_t>(status.st_size) >= sizeof(BinarySceneHeader)) {
+        size = static_cast<size_t>(status.st_size);
+        map = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    ::close(fd); // The mapping keeps the file open.
+    if (map == MAP_FAILED) {
+        throw std::runtime_error("Cannot map scene file " + filename + ".");
+    }
+    // Shared by the sphere set viewing it, unmapped with the last reference.
+    std::shared_ptr<const void> storage(map, [size](const void* p) { ::munmap(const_cast<void*>(p), size); });
+    auto bytes = static_cast<const char*>(map);
+
+    auto invalid = [&filename](const std::string& reason) {
+        return std::runtime_error(filename + " is no valid binary scene, " + reason + ".");
+    };
+    BinarySceneHeader header = {};
+    std::memcpy(&header, bytes, sizeof(header));
+    if (std::memcmp(header.magic, BinarySceneHeader().magic, sizeof(header.magic)) != 0 ||
+        header.version != BinarySceneHeader::CurrentVersion) {
+        throw invalid("unknown magic or version");
+    }
+    if (header.sphereCount == 0 || header.materialCount == 0) {
+        throw invalid("it has no spheres or no materials");
+    }
+
+    // Arrays have to lie within the file, aligned for their elements.
+    auto array = [&](uint64_t offset, size_t elementSize, uint64_t count, const char* name) {
+        if (offset % BinarySceneHeader::ArrayAlignment != 0 || offset > size || count > (size - offset) / elementSize) {
+            throw invalid(std::string("the ") + name + " array is misplaced");
+        }
+        return bytes + offset;
+    };
+    size_t count = header.sphereCount;
+    auto spheres = reinterpret_cast<const PackedSphere*>(
+        array(header.spheresOffset, sizeof(PackedSphere), count, "sphere"));
+    auto materialIndices = reinterpret_cast<const uint32_t*>(
+        array(header.materialIndicesOffset, sizeof(uint32_t), count, "material index"));
+    auto parents = reinterpret_cast<const int32_t*>(array(header.parentsOffset, sizeof(int32_t), count, "parent"));
+    auto priorities = reinterpret_cast<const uint32_t*>(
+        array(header.prioritiesOffset, sizeof(uint32_t), count, "priority"));
+    auto table = array(header.materialsOffset, sizeof(MaterialParameters), header.materialCount, "material");
+
+    // The material table is the only part that becomes objects, next to each other in an arena. Equal
+    // entries, e.g. of files written before materials were interned, share one.
+    auto arena = std::make_shared<Arena>();
+    std::unordered_map<MaterialParameters, std::shared_ptr<Material>, MaterialParametersHash> distinct = {};
+    std::vector<std::shared_ptr<Material>> materials(header.materialCount);
+    for (size_t m = 0; m < materials.size(); ++m) {
+        MaterialParameters parameters = {};
+        std::memcpy(&parameters, table + m * sizeof(MaterialParameters), sizeof(parameters));
+        auto& material = distinct[parameters];
+        if (material == nullptr && (material = makeMaterial(parameters, arena)) == nullptr) {
+            throw invalid("material " + std::to_string(m) + " has an unknown type");
+        }
+        materials[m] = material;
+    }
+    // Out of range indices would be read past the arrays while rendering, the geometry can do no harm.
+    for (size_t i = 0; i < count; ++i) {
+        if (materialIndices[i] >= header.materialCount || parents[i] < -1 || parents[i] >= static_cast<int64_t>(count)) {
+            throw invalid("sphere " + std::to_string(i) + " refers to a missing material or parent");
+        }
+    }
+    // buildHierarchy reads every sphere right after loading, so all of the file is needed soon.
+    ::madvise(map, size, MADV_WILLNEED);
+
+    SceneDescription scene = {};
+    scene.camera.position = toVector(header.cameraPosition);
+    scene.camera.lookAt = toVector(header.cameraLookAt);
+    scene.camera.up = toVector(header.cameraUp);
+    scene.camera.verticalFov = header.verticalFov;
+    scene.camera.aperture = header.aperture;
+    scene.camera.focusDistance = header.focusDistance;
+    scene.imageWidth = header.imageWidth;
+    scene.imageHeight = header.imageHeight;
+    scene.sampleCount = header.sampleCount;
+    scene.maxDepth = header.maxDepth;
+    scene.statistics = { count, materials.size(), distinct.size() };
+    scene.shapes.push_back(std::make_shared<SphereSet>(spheres, materialIndices, count, std::move(materials),
+                                                       std::move(storage), parents, priorities));
+    return scene;
+}
+
+bool writeBinaryScene(const std::string& filename, const SceneDescription& scene) {
+    std::vector<PackedSphere> spheres = {};
+    std::vector<uint32_t> materialIndices = {};
+    std::vector<int32_t> parents = {};
+    std::vector<uint32_t> priorities = {};
+    std::vector<MaterialParameters> table = {};
+
+    // Spheres sharing a Material object share its table entry.
+    std::unordered_map<const Material*, uint32_t> materialIds = {};
+    auto materialId = [&](const std::shared_ptr<Material>& material) {
+        auto [entry, added] = materialIds.emplace(material.get(), static_cast<uint32_t>(table.size()));
+        if (added) {
+            table.push_back(material->parameters());
+        }
+        return entry->second;
+    };
+
+    // Single spheres get their parents once all of them are numbered.
+    std::unordered_map<const Shape*, int32_t> sphereIds = {};
+    std::vector<std::pair<const Shape*, size_t>> singles = {};
+    for (const auto& shape : scene.shapes) {
+        if (auto set = dynamic_cast<const SphereSet*>(shape.get())) {
+            auto base = static_cast<int32_t>(spheres.size());
+            // Numbered on first use like those of single spheres, unused ones are left out.
+            constexpr uint32_t unused = std::numeric_limits<uint32_t>::max();
+            std::vector<uint32_t> setIds(set->materials().size(), unused);
+            for (size_t i = 0; i < set->size(); ++i) {
+                uint32_t& id = setIds[set->materialIndex(i)];
+                if (id == unused) {
+                    id = materialId(set->materials()[set->materialIndex(i)]);
+                }
+                spheres.push_back(set->sphere(i));
+                materialIndices.push_back(id);
+                parents.push_back(set->parent(i) < 0 ? -1 : base + set->parent(i));
+                priorities.push_back(set->priority(i));
+            }
+            continue;
+        }
+        // Other shapes, and spheres without material, which could not be rendered either, are left out.
+        auto sphere = dynamic_cast<const Sphere*>(shape.get());
+        if (sphere == nullptr || sphere->material() == nullptr) continue;
+
+        sphereIds[sphere] = static_cast<int32_t>(spheres.size());
+        singles.emplace_back(sphere, spheres.size());
+        spheres.push_back({ sphere->center().x(), sphere->center().y(), sphere->center().z(), sphere->radius() });
+        materialIndices.push_back(materialId(sphere->material()));
+        parents.push_back(-1);
+        priorities.push_back(sphere->priority());
+    }
+    for (const auto& [shape, index] : singles) {
+        auto parent = sphereIds.find(shape->parent().lock().get());
+        if (parent != sphereIds.end()) {
+            parents[index] = parent->second;
+        }
+    }
+    if (spheres.empty()) {
+        return false;
+    }
+
+    BinarySceneHeader header = {};
+    header.sphereCount = spheres.size();
+    header.materialCount = table.size();
+    header.spheresOffset = alignArray(sizeof(header));
+    header.materialIndicesOffset = alignArray(header.spheresOffset + spheres.size() * sizeof(PackedSphere));
+    header.parentsOffset = alignArray(header.materialIndicesOffset + materialIndices.size() * sizeof(uint32_t));
+    header.prioritiesOffset = alignArray(header.parentsOffset + parents.size() * sizeof(int32_t));
+    header.materialsOffset = alignArray(header.prioritiesOffset + priorities.size() * sizeof(uint32_t));
+    fromVector(scene.camera.position, header.cameraPosition);
+    fromVector(scene.camera.lookAt, header.cameraLookAt);
+    fromVector(scene.camera.up, header.cameraUp);
+    header.verticalFov = scene.camera.verticalFov;
+    header.aperture = scene.camera.aperture;
+    header.focusDistance = scene.camera.focusDistance;
+    header.imageWidth = scene.imageWidth;
+    header.imageHeight = scene.imageHeight;
+    header.sampleCount = scene.sampleCount;
+    header.maxDepth = scene.maxDepth;
+
+    std::ofstream fout(filename, std::ios::binary);
+    uint64_t written = 0;
+    // Zero padding up to offset, then size bytes of data.
+    auto put = [&](uint64_t offset, const void* data, size_t size) {
+        static const char padding[BinarySceneHeader::ArrayAlignment] = {};
+        fout.write(padding, static_cast<std::streamsize>(offset - written));
+        fout.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+        written = offset + size;
+    };
+    put(0, &header, sizeof(header));
+    put(header.spheresOffset, spheres.data(), spheres.size() * sizeof(PackedSphere));
+    put(header.materialIndicesOffset, materialIndices.data(), materialIndices.size() * sizeof(uint32_t));
+    put(header.parentsOffset, parents.data(), parents.size() * sizeof(int32_t));
+    put(header.prioritiesOffset, priorities.data(), priorities.size() * sizeof(uint32_t));
+    put(header.materialsOffset, table.data(), table.size() * sizeof(MaterialParameters));
+    return static_cast<bool>(fout.flush());
+}
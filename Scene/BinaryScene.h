@@ -0,0 +1,72 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#ifndef BINARY_SCENE_H
+#define BINARY_SCENE_H
+
+#include <cstdint>
+
+#include "Scene/SceneFile.h"
+#include "Shape/SphereSet.h"
+
+/*
+ * Binary scene (.rtscene), the arrays of a SphereSet laid out to be mapped and rendered in place. All
+ * values are little-endian like the host, every array starts at a multiple of ArrayAlignment bytes:
+ *
+ *   header:     BinarySceneHeader
+ *   spheres:    PackedSphere per sphere
+ *   materials:  uint32 index into the material table per sphere
+ *   parents:    int32 index of the parent sphere per sphere, -1 for none
+ *   priorities: uint32 per sphere
+ *   table:      MaterialParameters per material
+ */
+struct BinarySceneHeader {
+    static constexpr uint32_t CurrentVersion = 1;
+    static constexpr uint64_t ArrayAlignment = 64;
+
+    char magic[8] = { 'R', 'T', 'S', 'C', 'E', 'N', 'E', '\0' };
+    uint32_t version = CurrentVersion;
+    uint32_t reserved = 0;
+    uint64_t sphereCount = 0;
+    uint64_t materialCount = 0;
+
+    // From the start of the file.
+    uint64_t spheresOffset = 0;
+    uint64_t materialIndicesOffset = 0;
+    uint64_t parentsOffset = 0;
+    uint64_t prioritiesOffset = 0;
+    uint64_t materialsOffset = 0;
+
+    double cameraPosition[3] = {};
+    double cameraLookAt[3] = {};
+    double cameraUp[3] = {};
+    double verticalFov = 90.0;
+    double aperture = 0.0;
+    double focusDistance = 1.0;
+
+    // Zero where the scene has no render settings.
+    int32_t imageWidth = 0;
+    int32_t imageHeight = 0;
+    int32_t sampleCount = 0;
+    int32_t maxDepth = 0;
+};
+
+static_assert(sizeof(BinarySceneHeader) == 184, "The header layout is part of the file format.");
+
+// Map filename and view its arrays as a single SphereSet, only the material table becomes objects.
+// The indices are checked once, the geometry is paged in as rays need it. Throws std::runtime_error
+// when the file cannot be read or is no valid binary scene.
+SceneDescription readBinaryScene(const std::string& filename);
+
+// Write the camera, the render settings and all spheres of scene, single or in sets, to filename.
+// Spheres keep their material sharing, parents and priorities, but not their labels. False if the
+// file cannot be written.
+bool writeBinaryScene(const std::string& filename, const SceneDescription& scene);
+
+#endif // BINARY_SCENE_H
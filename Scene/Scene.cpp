@@ -8,45 +8,62 @@
 */
 
 #include "Material/Dielectric.h"
+#include "Material/DiffuseLight.h"
 #include "Material/Lambertian.h"
 #include "Material/Metal.h"
 #include "Scene.h"
-#include "Shape/Sphere.h"
+#include "SceneBuilder.h"
+
+CameraSettings testCameraSettings() {
+    CameraSettings settings = {};
+    settings.position = { 0.0, 0.0, 0.0 };
+    settings.lookAt = { 0.0, 0.0, -1.0 };
+    settings.up = { 0.0, 1.0, 0.0 };
+    settings.verticalFov = 90.0;
+    settings.aperture = 0.0;
+    settings.focusDistance = 1.0;
+    return settings;
+}
 
 std::shared_ptr<Camera> testCamera(double aspectRatio) {
-    Vector3d position = { 0.0, 0.0, 0.0 };
-    Vector3d lookAt = { 0.0, 0.0, -1.0 };
-    Vector3d up = { 0.0, 1.0, 0.0 };
-    return std::make_shared<Camera>(aspectRatio, 0.0, 1.0, 90.0, position, lookAt, up);
+    return std::make_shared<Camera>(aspectRatio, testCameraSettings());
 }
 
-std::vector<std::shared_ptr<Shape>> testScene() {
-    std::vector<std::shared_ptr<Shape>> shapeList = {};
+std::vector<std::shared_ptr<Shape>> testScene(SceneStatistics* statistics) {
+    SceneBuilder builder = {};
+
+    auto groundMaterial = builder.addMaterial<Lambertian>(Vector3d(0.5, 0.5, 0.5));
+    builder.addSphere(Vector3d(0.0, -100.5, -1.0), 100.0, groundMaterial, "scene");
 
-    auto groundMaterial = std::make_shared<Lambertian>(Vector3d(0.5, 0.5, 0.5));
-    shapeList.push_back(std::make_shared<Sphere>(Vector3d(0.0, -100.5, -1.0), 100.0, "scene", groundMaterial));
+//    auto ballMaterial = builder.addMaterial<Lambertian>(Vector3d(0.5, 0.5, 0.5));
+//    auto ballMaterial = builder.addMaterial<Metal>(Vector3d(0.8, 0.8, 0.9), 0.0);
+    auto ballMaterial = builder.addMaterial<Dielectric>(Vector3d(0.8, 0.8, 0.9), 1.5);
 
-//    auto ballMaterial = std::make_shared<Lambertian>(Vector3d(0.5, 0.5, 0.5));
-//    auto ballMaterial = std::make_shared<Metal>(Vector3d(0.8, 0.8, 0.9), 0.0);
-    auto ballMaterial = std::make_shared<Dielectric>(Vector3d(0.8, 0.8, 0.9), 1.5);
+    builder.addSphere(Vector3d(0.0, 0.0, -1.0), 0.5, ballMaterial, "ball");
 
-    shapeList.push_back(std::make_shared<Sphere>(Vector3d(0.0, 0.0, -1.0), 0.5, "ball", ballMaterial));
+    return { builder.build(statistics) };
+}
 
-    return shapeList;
+CameraSettings randomBallsCameraSettings() {
+    CameraSettings settings = {};
+    settings.position = { 13.0, 2.0, 3.0 };
+    settings.lookAt = { 0.0, 0.0, 0.0 };
+    settings.up = { 0.0, 1.0, 0.0 };
+    settings.verticalFov = 20.0;
+    settings.aperture = 0.1;
+    settings.focusDistance = 10.0;
+    return settings;
 }
 
 std::shared_ptr<Camera> randomBallsCamera(double aspectRatio) {
-    Vector3d position = { 13.0, 2.0, 3.0 };
-    Vector3d lookAt = { 0.0, 0.0, 0.0 };
-    Vector3d up = { 0.0, 1.0, 0.0 };
-    return std::make_shared<Camera>(aspectRatio, 0.1, 10.0, 20.0, position, lookAt, up);
+    return std::make_shared<Camera>(aspectRatio, randomBallsCameraSettings());
 }
 
-std::vector<std::shared_ptr<Shape>> randomBallsScene() {
-    std::vector<std::shared_ptr<Shape>> shapeList = {};
+std::vector<std::shared_ptr<Shape>> randomBallsScene(SceneStatistics* statistics) {
+    SceneBuilder builder = {};
 
-    auto groundMaterial = std::make_shared<Lambertian>(Vector3d(0.5, 0.5, 0.5));
-    shapeList.push_back(std::make_shared<Sphere>(Vector3d(0.0, -1000.0, 0.0), 1000.0, "scene", groundMaterial));
+    auto groundMaterial = builder.addMaterial<Lambertian>(Vector3d(0.5, 0.5, 0.5));
+    builder.addSphere(Vector3d(0.0, -1000.0, 0.0), 1000.0, groundMaterial, "scene");
 
     for (int a = -11; a < 11; ++a) {
         for (int b = -11;  b < 11; ++b) {
@@ -54,38 +71,82 @@ std::vector<std::shared_ptr<Shape>> randomBallsScene() {
             Vector3d center(a + 0.9 * randomReal(), 0.2, b + 0.9 * randomReal());
 
             if ((center - Vector3d(4.0, 0.2, 0.0)).length() > 0.9) {
-                std::shared_ptr<Material> sphereMaterial;
+                uint32_t sphereMaterial = 0;
 
                 if (choose < 0.8) {
                     // Diffuse
                     auto albedo = randomVec3d() * randomVec3d();
-                    sphereMaterial = std::make_shared<Lambertian>(albedo);
-                    shapeList.push_back(std::make_shared<Sphere>(center, 0.2, "diffuse_ball", sphereMaterial));
+                    sphereMaterial = builder.addMaterial<Lambertian>(albedo);
+                    builder.addSphere(center, 0.2, sphereMaterial, "diffuse_ball");
                 }
                 else if (choose < 0.95) {
                     // Metal
                     auto albedo = randomVec3d(0.5, 1.0);
                     auto fuzz = randomReal(0.0, 0.5);
-                    sphereMaterial = std::make_shared<Metal>(albedo, fuzz);
-                    shapeList.push_back(std::make_shared<Sphere>(center, 0.2, "metal_ball", sphereMaterial));
+                    sphereMaterial = builder.addMaterial<Metal>(albedo, fuzz);
+                    builder.addSphere(center, 0.2, sphereMaterial, "metal_ball");
                 }
                 else {
                     // Glass
-                    sphereMaterial = std::make_shared<Dielectric>(Vector3d(0.9, 0.9, 0.95), 1.5);
-                    shapeList.push_back(std::make_shared<Sphere>(center, 0.2, "glass_ball", sphereMaterial));
+                    sphereMaterial = builder.addMaterial<Dielectric>(Vector3d(0.9, 0.9, 0.95), 1.5);
+                    builder.addSphere(center, 0.2, sphereMaterial, "glass_ball");
                 }
             }
         }
     }
 
-    auto material1 = std::make_shared<Dielectric>(Vector3d(0.95, 0.95, 1.0), 1.5);
-    shapeList.push_back(std::make_shared<Sphere>(Vector3d(0.0, 1.0, 0.0), 1.0, "ball1", material1));
+    auto material1 = builder.addMaterial<Dielectric>(Vector3d(0.95, 0.95, 1.0), 1.5);
+    builder.addSphere(Vector3d(0.0, 1.0, 0.0), 1.0, material1, "ball1");
 
-    auto material2 = std::make_shared<Lambertian>(Vector3d(0.4, 0.2, 0.1));
-    shapeList.push_back(std::make_shared<Sphere>(Vector3d(-4.0, 1.0, 0.0), 1.0, "ball2", material2));
+    auto material2 = builder.addMaterial<Lambertian>(Vector3d(0.4, 0.2, 0.1));
+    builder.addSphere(Vector3d(-4.0, 1.0, 0.0), 1.0, material2, "ball2");
 
-    auto material3 = std::make_shared<Metal>(Vector3d(0.7, 0.6, 0.5), 0.0);
-    shapeList.push_back(std::make_shared<Sphere>(Vector3d(4.0, 1.0, 0.0), 1.0, "ball3", material3));
+    auto material3 = builder.addMaterial<Metal>(Vector3d(0.7, 0.6, 0.5), 0.0);
+    builder.addSphere(Vector3d(4.0, 1.0, 0.0), 1.0, material3, "ball3");
+
+    return { builder.build(statistics) };
+}
+
+CameraSettings manyLightsCameraSettings() {
+    CameraSettings settings = {};
+    settings.position = { 13.0, 4.0, 3.0 };
+    settings.lookAt = { 0.0, 0.0, 0.0 };
+    settings.up = { 0.0, 1.0, 0.0 };
+    settings.verticalFov = 30.0;
+    settings.aperture = 0.0;
+    settings.focusDistance = 10.0;
+    return settings;
+}
+
+std::shared_ptr<Camera> manyLightsCamera(double aspectRatio) {
+    return std::make_shared<Camera>(aspectRatio, manyLightsCameraSettings());
+}
 
-    return shapeList;
-}
\ No newline at end of file
+std::vector<std::shared_ptr<Shape>> manyLightsScene(int lightCount, SceneStatistics* statistics) {
+    SceneBuilder builder = {};
+
+    auto groundMaterial = builder.addMaterial<Lambertian>(Vector3d(0.5, 0.5, 0.5));
+    builder.addSphere(Vector3d(0.0, -1000.0, 0.0), 1000.0, groundMaterial, "scene");
+
+    auto material1 = builder.addMaterial<Lambertian>(Vector3d(0.8, 0.8, 0.8));
+    builder.addSphere(Vector3d(0.0, 1.0, 0.0), 1.0, material1, "ball1");
+
+    auto material2 = builder.addMaterial<Metal>(Vector3d(0.7, 0.6, 0.5), 0.1);
+    builder.addSphere(Vector3d(4.0, 1.0, 0.0), 1.0, material2, "ball2");
+
+    // Small glowing balls hovering over the ground, total power is independent of the light count.
+    double radius = 0.05;
+    double intensity = 2000.0 / lightCount;
+    for (int i = 0; i < lightCount; ++i) {
+        Vector3d center(randomReal(-11.0, 11.0), randomReal(1.5, 4.0), randomReal(-11.0, 11.0));
+        auto emission = intensity * (Vector3d(0.2, 0.2, 0.2) + randomVec3d());
+        auto lightMaterial = builder.addMaterial<DiffuseLight>(emission);
+        builder.addSphere(center, radius, lightMaterial, "light_ball");
+    }
+
+    // Black dome around everything hides the default sky, so that the glowing balls are the only light.
+    auto nightMaterial = builder.addMaterial<DiffuseLight>(Vector3d(0.0, 0.0, 0.0));
+    builder.addSphere(Vector3d(0.0, 0.0, 0.0), 500.0, nightMaterial, "night_sky");
+
+    return { builder.build(statistics) };
+}
@@ -13,11 +13,21 @@
 #include "Camera/Camera.h"
 #include "Shape/Shape.h"
 
+struct SceneStatistics;
+
+// Built-in scenes, each a single SphereSet. statistics, when given, receive its size.
+
+CameraSettings testCameraSettings();
 std::shared_ptr<Camera> testCamera(double aspectRatio);
-std::vector<std::shared_ptr<Shape>> testScene();
+std::vector<std::shared_ptr<Shape>> testScene(SceneStatistics* statistics = nullptr);
 
+CameraSettings randomBallsCameraSettings();
 std::shared_ptr<Camera> randomBallsCamera(double aspectRatio);
-std::vector<std::shared_ptr<Shape>> randomBallsScene();
+std::vector<std::shared_ptr<Shape>> randomBallsScene(SceneStatistics* statistics = nullptr);
+
+CameraSettings manyLightsCameraSettings();
+std::shared_ptr<Camera> manyLightsCamera(double aspectRatio);
+std::vector<std::shared_ptr<Shape>> manyLightsScene(int lightCount, SceneStatistics* statistics = nullptr);
 
 
 #endif // SCENE_H
\ No newline at end of file
@@ -0,0 +1,86 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#include "SceneBuilder.h"
+
+namespace {
+    // A side array gets its entries for all spheres so far once it is first needed.
+    template<typename T>
+    std::vector<T>& touch(std::vector<T>& array, size_t count, T defaultValue) {
+        if (array.empty()) {
+            array.resize(count, defaultValue);
+        }
+        return array;
+    }
+}
+
+uint32_t SceneBuilder::addSphere(const Vector3d& center, double radius, uint32_t material, const std::string& label,
+                                 uint32_t priority) {
+    auto index = static_cast<uint32_t>(m_arrays.spheres.size());
+    m_arrays.spheres.push_back({ center.x(), center.y(), center.z(), radius });
+    m_arrays.materialIndices.push_back(material);
+
+    if (!m_arrays.parents.empty()) {
+        m_arrays.parents.push_back(-1);
+    }
+    if (priority != 0 || !m_arrays.priorities.empty()) {
+        touch(m_arrays.priorities, index, 0u).push_back(priority);
+    }
+    if (!label.empty() || !m_arrays.labelIndices.empty()) {
+        if (m_arrays.labels.empty()) {
+            m_arrays.labels.push_back("sphere");
+        }
+        uint32_t labelIndex = 0;
+        if (!label.empty()) {
+            auto [entry, added] = m_labelIndices.emplace(label, static_cast<uint32_t>(m_arrays.labels.size()));
+            if (added) {
+                m_arrays.labels.push_back(label);
+            }
+            labelIndex = entry->second;
+        }
+        touch(m_arrays.labelIndices, index, 0u).push_back(labelIndex);
+    }
+    return index;
+}
+
+void SceneBuilder::setParent(uint32_t sphere, uint32_t parent) {
+    touch(m_arrays.parents, m_arrays.spheres.size(), int32_t(-1))[sphere] = static_cast<int32_t>(parent);
+}
+
+size_t SceneBuilder::appendSpheres(size_t count) {
+    size_t first = m_arrays.spheres.size();
+    m_arrays.spheres.resize(first + count);
+    m_arrays.materialIndices.resize(first + count);
+    if (!m_arrays.parents.empty()) {
+        m_arrays.parents.resize(first + count, -1);
+    }
+    if (!m_arrays.priorities.empty()) {
+        m_arrays.priorities.resize(first + count, 0);
+    }
+    if (!m_arrays.labelIndices.empty()) {
+        m_arrays.labelIndices.resize(first + count, 0);
+    }
+    return first;
+}
+
+std::shared_ptr<SphereSet> SceneBuilder::build(SceneStatistics* statistics) {
+    if (statistics != nullptr) {
+        *statistics = this->statistics();
+    }
+    std::shared_ptr<SphereSet> set = nullptr;
+    if (!m_arrays.spheres.empty()) {
+        set = SphereSet::fromArrays(std::move(m_arrays), std::move(m_materials));
+    }
+    m_arrays = {};
+    m_materials = {};
+    m_labelIndices = {};
+    m_materialIndices = {};
+    m_definedMaterialCount = 0;
+    return set;
+}
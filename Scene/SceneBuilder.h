@@ -0,0 +1,90 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#ifndef SCENE_BUILDER_H
+#define SCENE_BUILDER_H
+
+#include <unordered_map>
+
+#include "RayTracer/Arena.h"
+#include "Shape/SphereSet.h"
+
+// Size of a built scene, for reports.
+struct SceneStatistics {
+    size_t sphereCount = 0;
+    // Materials the scene defined, and the distinct ones they were interned to.
+    size_t materialCount = 0;
+    size_t distinctMaterialCount = 0;
+
+    inline double dedupRatio() const {
+        return distinctMaterialCount > 0 ? static_cast<double>(materialCount) / distinctMaterialCount : 1.0;
+    }
+};
+
+/*
+ * Builds a scene into the arrays of one SphereSet rather than an object per sphere. Geometry and
+ * material indices are packed densely for the hits, while parents, priorities and labels go to side
+ * arrays indexed by sphere, which are only made once some sphere has one. Materials are interned by
+ * their parameters, so that equal ones share a table entry, and allocated from an arena that lives as
+ * long as the scene.
+ */
+class SceneBuilder {
+public:
+    SceneBuilder() = default;
+
+    SceneBuilder(const SceneBuilder&) = delete;
+    SceneBuilder& operator=(const SceneBuilder&) = delete;
+
+    // Index of the material, which spheres refer to, the one of an equal material added before if any.
+    template<typename T, typename... Args>
+    uint32_t addMaterial(Args&&... args) {
+        T material(std::forward<Args>(args)...);
+        ++m_definedMaterialCount;
+        auto [entry, added] = m_materialIndices.try_emplace(material.parameters(),
+                                                            static_cast<uint32_t>(m_materials.size()));
+        if (added) {
+            m_materials.push_back(makeInArena<T>(m_arena, std::move(material)));
+        }
+        return entry->second;
+    }
+
+    // Index of a new sphere, an empty label leaves the default one.
+    uint32_t addSphere(const Vector3d& center, double radius, uint32_t material, const std::string& label = {},
+                       uint32_t priority = 0);
+
+    void setParent(uint32_t sphere, uint32_t parent);
+
+    // Room for count more spheres without parent, priority or label, for generators that fill spheres()
+    // and materialIndices() in place. Index of the first.
+    size_t appendSpheres(size_t count);
+
+    inline PackedSphere* spheres() { return m_arrays.spheres.data(); }
+    inline uint32_t* materialIndices() { return m_arrays.materialIndices.data(); }
+
+    inline size_t sphereCount() const { return m_arrays.spheres.size(); }
+
+    inline SceneStatistics statistics() const {
+        return { m_arrays.spheres.size(), m_definedMaterialCount, m_materials.size() };
+    }
+
+    // All spheres as one shape, nullptr when there are none. Leaves the builder empty, statistics, when
+    // given, receive what it held.
+    std::shared_ptr<SphereSet> build(SceneStatistics* statistics = nullptr);
+
+private:
+    SphereArrays m_arrays = {};
+    std::vector<std::shared_ptr<Material>> m_materials = {};
+    std::shared_ptr<Arena> m_arena = std::make_shared<Arena>();
+    std::unordered_map<MaterialParameters, uint32_t, MaterialParametersHash> m_materialIndices = {};
+    size_t m_definedMaterialCount = 0;
+
+    std::unordered_map<std::string, uint32_t> m_labelIndices = {};
+};
+
+#endif // SCENE_BUILDER_H
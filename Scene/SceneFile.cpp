@@ -0,0 +1,328 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+
+#include "Material/Dielectric.h"
+#include "Material/DiffuseLight.h"
+#include "Material/Lambertian.h"
+#include "Material/Metal.h"
+#include "SceneBuilder.h"
+#include "SceneFile.h"
+
+namespace {
+    using Token = std::string_view;
+
+    inline bool isBlank(char c) {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    // Exactly representable powers of ten.
+    constexpr double PowersOf10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                      1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+    // Plain decimals like -12.375 of up to 15 digits, the numbers of nearly every scene file, are an exact
+    // integer and an exact power of ten, so one division or multiplication rounds them correctly. That is
+    // several times faster than std::from_chars, which takes over everything else.
+    bool parseReal(std::string_view token, double& value) {
+        const char* p = token.data();
+        const char* end = p + token.size();
+        bool negative = p < end && *p == '-';
+        if (negative) ++p;
+
+        uint64_t mantissa = 0;
+        int digitCount = 0, fractionCount = 0;
+        for (; p < end && *p >= '0' && *p <= '9'; ++p, ++digitCount) {
+            mantissa = mantissa * 10 + (*p - '0');
+        }
+        if (p < end && *p == '.') {
+            for (++p; p < end && *p >= '0' && *p <= '9'; ++p, ++digitCount, ++fractionCount) {
+                mantissa = mantissa * 10 + (*p - '0');
+            }
+        }
+        if (p == end && digitCount > 0 && digitCount <= 15) {
+            value = static_cast<double>(mantissa) / PowersOf10[fractionCount];
+            if (negative) value = -value;
+            return true;
+        }
+
+        auto [last, error] = std::from_chars(token.data(), token.data() + token.size(), value);
+        return error == std::errc() && last == token.data() + token.size();
+    }
+
+    // Blank-separated tokens of one line, views into the file text, and the place of its errors.
+    class Line {
+    public:
+        Line(const std::string& filename, int number, const char* begin, const char* end)
+            : m_filename(filename), m_number(number), m_position(begin), m_end(end) {}
+
+        // False at the end of the line.
+        bool next(Token& token) {
+            while (m_position < m_end && isBlank(*m_position)) ++m_position;
+            if (m_position == m_end) return false;
+            const char* start = m_position;
+            while (m_position < m_end && !isBlank(*m_position)) ++m_position;
+            token = Token(start, m_position - start);
+            return true;
+        }
+
+        Token expect(const char* what) {
+            Token token = {};
+            if (!next(token)) {
+                fail("expects " + std::string(what) + ".");
+            }
+            return token;
+        }
+
+        [[noreturn]] void fail(const std::string& message) const {
+            throw std::invalid_argument(m_filename + ":" + std::to_string(m_number) + ": " + message);
+        }
+
+        double real(Token what, Token token) const {
+            double value = 0.0;
+            if (!parseReal(token, value) || !std::isfinite(value)) {
+                fail(std::string(what) + " expects a number, got \"" + std::string(token) + "\".");
+            }
+            return value;
+        }
+
+        double positiveReal(Token what, Token token) const {
+            double value = real(what, token);
+            if (value <= 0.0) {
+                fail(std::string(what) + " expects a positive number, got \"" + std::string(token) + "\".");
+            }
+            return value;
+        }
+
+        int integer(Token what, Token token, int minValue = 1) const {
+            int value = 0;
+            auto [end, error] = std::from_chars(token.data(), token.data() + token.size(), value);
+            if (error != std::errc() || end != token.data() + token.size() || value < minValue) {
+                fail(std::string(what) + " expects an integer >= " + std::to_string(minValue) + ", got \"" +
+                     std::string(token) + "\".");
+            }
+            return value;
+        }
+
+        Vector3d vector(Token what, Token token) const {
+            double xyz[3] = {};
+            size_t start = 0;
+            for (int k = 0; k < 3; ++k) {
+                size_t end = k < 2 ? token.find(',', start) : token.size();
+                if (end == Token::npos || (k == 2 && token.find(',', start) != Token::npos)) {
+                    fail(std::string(what) + " expects x,y,z, got \"" + std::string(token) + "\".");
+                }
+                xyz[k] = real(what, token.substr(start, end - start));
+                start = end + 1;
+            }
+            return { xyz[0], xyz[1], xyz[2] };
+        }
+
+        // Key and value of a key=value token.
+        std::pair<Token, Token> keyValue(Token token) const {
+            auto equals = token.find('=');
+            if (equals == Token::npos) {
+                fail("\"" + std::string(token) + "\" is not a key=value pair.");
+            }
+            return { token.substr(0, equals), token.substr(equals + 1) };
+        }
+
+    private:
+        const std::string& m_filename;
+        int m_number = 0;
+        const char* m_position = nullptr;
+        const char* m_end = nullptr;
+    };
+
+    void readRender(Line& line, SceneDescription& scene) {
+        Token token = {};
+        while (line.next(token)) {
+            auto [key, value] = line.keyValue(token);
+            if (key == "width") {
+                scene.imageWidth = line.integer(key, value);
+            }
+            else if (key == "height") {
+                scene.imageHeight = line.integer(key, value);
+            }
+            else if (key == "spp") {
+                scene.sampleCount = line.integer(key, value);
+            }
+            else if (key == "depth") {
+                scene.maxDepth = line.integer(key, value);
+            }
+            else {
+                line.fail(std::string(key) + " is not a render key.");
+            }
+        }
+    }
+
+    void readCamera(Line& line, CameraSettings& camera) {
+        Token token = {};
+        while (line.next(token)) {
+            auto [key, value] = line.keyValue(token);
+            if (key == "position") {
+                camera.position = line.vector(key, value);
+            }
+            else if (key == "look_at") {
+                camera.lookAt = line.vector(key, value);
+            }
+            else if (key == "up") {
+                camera.up = line.vector(key, value);
+            }
+            else if (key == "fov") {
+                camera.verticalFov = line.positiveReal(key, value);
+            }
+            else if (key == "aperture") {
+                camera.aperture = line.real(key, value);
+            }
+            else if (key == "focus") {
+                camera.focusDistance = line.positiveReal(key, value);
+            }
+            else {
+                line.fail(std::string(key) + " is not a camera key.");
+            }
+        }
+    }
+
+    uint32_t readMaterial(Line& line, SceneBuilder& builder) {
+        Token type = line.expect("a material type after the name");
+        bool lambertian = type == "lambertian", metal = type == "metal";
+        bool dielectric = type == "dielectric", light = type == "light";
+        if (!lambertian && !metal && !dielectric && !light) {
+            line.fail("Unknown material type \"" + std::string(type) + "\".");
+        }
+
+        Vector3d albedo(0.5, 0.5, 0.5), emission(1.0, 1.0, 1.0);
+        double fuzz = 0.0, ior = 1.5;
+        Token token = {};
+        while (line.next(token)) {
+            auto [key, value] = line.keyValue(token);
+            if (key == "albedo" && !light) {
+                albedo = line.vector(key, value);
+            }
+            else if (key == "fuzz" && metal) {
+                fuzz = line.real(key, value);
+            }
+            else if (key == "ior" && dielectric) {
+                ior = line.positiveReal(key, value);
+            }
+            else if (key == "emission" && light) {
+                emission = line.vector(key, value);
+            }
+            else {
+                line.fail(std::string(key) + " is not a key of " + std::string(type) + " materials.");
+            }
+        }
+
+        if (metal) return builder.addMaterial<Metal>(albedo, fuzz);
+        if (dielectric) return builder.addMaterial<Dielectric>(albedo, ior);
+        if (light) return builder.addMaterial<DiffuseLight>(emission);
+        return builder.addMaterial<Lambertian>(albedo);
+    }
+}
+
+SceneDescription readSceneFile(const std::string& filename) {
+    std::ifstream fin(filename, std::ios::binary | std::ios::ate);
+    if (!fin) {
+        throw std::runtime_error("Cannot read scene file " + filename + ".");
+    }
+    std::string text(static_cast<size_t>(fin.tellg()), '\0');
+    fin.seekg(0);
+    if (!fin.read(text.data(), static_cast<std::streamsize>(text.size()))) {
+        throw std::runtime_error("Cannot read scene file " + filename + ".");
+    }
+
+    SceneDescription scene = {};
+    SceneBuilder builder = {};
+    // Indices into the builder, keyed by views into text, which outlives them.
+    std::unordered_map<Token, uint32_t> materials = {};
+    // Named spheres only, the ones that can be parents.
+    std::unordered_map<Token, uint32_t> namedSpheres = {};
+
+    const char* position = text.data();
+    const char* end = text.data() + text.size();
+    for (int number = 1; position < end; ++number) {
+        auto lineEnd = static_cast<const char*>(std::memchr(position, '\n', end - position));
+        if (lineEnd == nullptr) {
+            lineEnd = end;
+        }
+        Line line(filename, number, position, lineEnd);
+        position = lineEnd + 1;
+
+        Token statement = {};
+        if (!line.next(statement) || statement[0] == '#') continue;
+
+        if (statement == "sphere") {
+            Vector3d center = line.vector("center", line.expect("a center x,y,z"));
+            double radius = line.positiveReal("radius", line.expect("a radius after the center"));
+            Token materialName = line.expect("a material after the radius");
+            auto material = materials.find(materialName);
+            if (material == materials.end()) {
+                line.fail("Material \"" + std::string(materialName) + "\" is not defined.");
+            }
+
+            Token name = {}, parent = {};
+            uint32_t priority = 0;
+            Token token = {};
+            while (line.next(token)) {
+                auto [key, value] = line.keyValue(token);
+                if (key == "name") {
+                    name = value;
+                }
+                else if (key == "parent") {
+                    parent = value;
+                }
+                else if (key == "priority") {
+                    priority = static_cast<uint32_t>(line.integer(key, value, 0));
+                }
+                else {
+                    line.fail(std::string(key) + " is not a sphere key.");
+                }
+            }
+
+            auto sphere = builder.addSphere(center, radius, material->second, std::string(name), priority);
+            if (!parent.empty()) {
+                auto parentSphere = namedSpheres.find(parent);
+                if (parentSphere == namedSpheres.end()) {
+                    line.fail("Parent \"" + std::string(parent) + "\" is not a sphere named before.");
+                }
+                builder.setParent(sphere, parentSphere->second);
+            }
+            if (!name.empty() && !namedSpheres.emplace(name, sphere).second) {
+                line.fail("Sphere name \"" + std::string(name) + "\" is taken.");
+            }
+        }
+        else if (statement == "material") {
+            Token name = line.expect("a material name");
+            auto material = readMaterial(line, builder);
+            if (!materials.emplace(name, material).second) {
+                line.fail("Material \"" + std::string(name) + "\" is defined twice.");
+            }
+        }
+        else if (statement == "camera") {
+            readCamera(line, scene.camera);
+        }
+        else if (statement == "render") {
+            readRender(line, scene);
+        }
+        else {
+            line.fail("\"" + std::string(statement) + "\" is not a statement.");
+        }
+    }
+
+    if (builder.sphereCount() == 0) {
+        throw std::invalid_argument("Scene file " + filename + " has no shapes.");
+    }
+    scene.shapes.push_back(builder.build(&scene.statistics));
+    return scene;
+}
@@ -0,0 +1,53 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#ifndef SCENE_FILE_H
+#define SCENE_FILE_H
+
+#include "Camera/Camera.h"
+#include "Scene/SceneBuilder.h"
+#include "Shape/Shape.h"
+
+// Everything a scene file describes.
+struct SceneDescription {
+    CameraSettings camera = {};
+    std::vector<std::shared_ptr<Shape>> shapes = {};
+    SceneStatistics statistics = {};
+
+    // Render settings of the file, zero where it has none.
+    int imageWidth = 0;
+    int imageHeight = 0;
+    int sampleCount = 0;
+    int maxDepth = 0;
+};
+
+/*
+ * Read a scene file (.scene), one statement per line:
+ *
+ *     render width=1200 height=675 spp=100 depth=50
+ *     camera position=13,2,3 look_at=0,0,0 up=0,1,0 fov=20 aperture=0.1 focus=10
+ *     material ground lambertian albedo=0.5,0.5,0.5
+ *     material steel metal albedo=0.7,0.6,0.5 fuzz=0.1
+ *     material glass dielectric albedo=0.95,0.95,1 ior=1.5
+ *     material lamp light emission=4,4,4
+ *     sphere 0,-1000,0 1000 ground name=floor
+ *     sphere 4,1,0 1 steel parent=floor priority=1
+ *
+ * A sphere is its center, radius and material followed by optional keys: name labels it and lets later
+ * spheres name it as their parent, priority orders the shapes of a hierarchy. Materials are defined
+ * before their first use. Camera keys missing from the file keep the defaults of CameraSettings. Blank
+ * lines and lines starting with # are skipped.
+ *
+ * The file is read at once and parsed in a single pass without copying tokens, into a single SphereSet
+ * made by SceneBuilder, so that scenes of millions of spheres load in a fraction of a second. Throws
+ * std::invalid_argument with the line number on bad input, std::runtime_error if the file cannot be read.
+ */
+SceneDescription readSceneFile(const std::string& filename);
+
+#endif // SCENE_FILE_H
@@ -0,0 +1,151 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#include "Concurrency/ThreadPool.h"
+#include "Material/Dielectric.h"
+#include "Material/DiffuseLight.h"
+#include "Material/Lambertian.h"
+#include "Material/Metal.h"
+#include "SceneBuilder.h"
+#include "SceneGenerator.h"
+
+namespace {
+    constexpr size_t ChunkSize = 65536;
+
+    constexpr double MinRadius = 0.1;
+    constexpr double MaxRadius = 0.3;
+
+    enum MaterialKind { Diffuse, Shiny, Glass, Light, KindCount };
+
+    // Half the edge of the square field.
+    double fieldHalfSize(const GeneratorSettings& settings) {
+        // Mean of pi r^2 for r uniform in [MinRadius, MaxRadius].
+        double meanArea = pi * (MinRadius * MinRadius + MinRadius * MaxRadius + MaxRadius * MaxRadius) / 3.0;
+        return 0.5 * std::sqrt(std::max<size_t>(settings.sphereCount, 1) * meanArea / settings.density);
+    }
+
+    // Flat enough over the field, but not so large that hits on it lose their precision.
+    double groundRadius(double halfSize) {
+        return std::max(1000.0, 100.0 * halfSize);
+    }
+
+    // Indices of paletteSize materials of each kind, kind after kind, drawn like those of randomBallsScene.
+    // The glass ones are all alike, so they are interned to one.
+    std::vector<uint32_t> addPalette(SceneBuilder& builder, int paletteSize, std::default_random_engine& engine) {
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        auto randomColor = [&](double min, double max) {
+            return Vector3d(min + (max - min) * unit(engine), min + (max - min) * unit(engine),
+                            min + (max - min) * unit(engine));
+        };
+
+        std::vector<uint32_t> palette = {};
+        for (int i = 0; i < paletteSize; ++i) {
+            palette.push_back(builder.addMaterial<Lambertian>(randomColor(0.0, 1.0) * randomColor(0.0, 1.0)));
+        }
+        for (int i = 0; i < paletteSize; ++i) {
+            auto albedo = randomColor(0.5, 1.0);
+            palette.push_back(builder.addMaterial<Metal>(albedo, 0.5 * unit(engine)));
+        }
+        for (int i = 0; i < paletteSize; ++i) {
+            palette.push_back(builder.addMaterial<Dielectric>(Vector3d(0.9, 0.9, 0.95), 1.5));
+        }
+        for (int i = 0; i < paletteSize; ++i) {
+            palette.push_back(builder.addMaterial<DiffuseLight>(4.0 * (Vector3d(0.2, 0.2, 0.2) + randomColor(0.0, 1.0))));
+        }
+        return palette;
+    }
+}
+
+std::vector<std::shared_ptr<Shape>> generatedScene(const GeneratorSettings& settings, unsigned seed, ThreadPool* pool,
+                                                   SceneStatistics* statistics) {
+    double halfSize = fieldHalfSize(settings);
+    double radius = groundRadius(halfSize);
+
+    SceneBuilder builder = {};
+    auto groundMaterial = builder.addMaterial<Lambertian>(Vector3d(0.5, 0.5, 0.5));
+    // Unlabeled, one label would give all the generated spheres an entry in the label array.
+    builder.addSphere(Vector3d(0.0, -radius, 0.0), radius, groundMaterial);
+
+    // Palette and cluster centers come from the seed alone, the spheres from one engine per chunk.
+    std::seed_seq sceneSequence = { seed };
+    std::default_random_engine sceneEngine(sceneSequence);
+    auto palette = addPalette(builder, settings.paletteSize, sceneEngine);
+
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::vector<std::pair<double, double>> clusters(settings.clusterCount);
+    for (auto& cluster : clusters) {
+        cluster = { (2.0 * unit(sceneEngine) - 1.0) * halfSize, (2.0 * unit(sceneEngine) - 1.0) * halfSize };
+    }
+    // A quarter of the mean distance between clusters. Unused in a uniform field, but the normal
+    // distribution still needs a positive deviation there.
+    double spread = clusters.empty() ? 1.0 : 0.5 * halfSize / std::sqrt(static_cast<double>(clusters.size()));
+
+    double mixTotal = 0.0;
+    double mixEnds[KindCount] = {};
+    for (int kind = 0; kind < KindCount; ++kind) {
+        mixTotal += settings.materialMix[kind];
+        mixEnds[kind] = mixTotal;
+    }
+
+    size_t first = builder.appendSpheres(settings.sphereCount);
+    PackedSphere* spheres = builder.spheres() + first;
+    uint32_t* materialIndices = builder.materialIndices() + first;
+    size_t chunkCount = (settings.sphereCount + ChunkSize - 1) / ChunkSize;
+    auto generateChunk = [&](size_t chunk) {
+        std::seed_seq sequence = { seed, static_cast<unsigned>(chunk + 1) };
+        std::default_random_engine engine(sequence);
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        std::normal_distribution<double> offset(0.0, spread);
+
+        size_t end = std::min(settings.sphereCount, (chunk + 1) * ChunkSize);
+        for (size_t i = chunk * ChunkSize; i < end; ++i) {
+            double u = unit(engine) * mixTotal;
+            int kind = 0;
+            while (kind < KindCount - 1 && u >= mixEnds[kind]) ++kind;
+            auto entry = std::min(settings.paletteSize - 1, static_cast<int>(unit(engine) * settings.paletteSize));
+            materialIndices[i] = palette[kind * settings.paletteSize + entry];
+
+            double x = 0.0, z = 0.0;
+            if (clusters.empty()) {
+                x = (2.0 * unit(engine) - 1.0) * halfSize;
+                z = (2.0 * unit(engine) - 1.0) * halfSize;
+            }
+            else {
+                const auto& cluster = clusters[std::min(clusters.size() - 1, static_cast<size_t>(unit(engine) * clusters.size()))];
+                x = std::clamp(cluster.first + offset(engine), -halfSize, halfSize);
+                z = std::clamp(cluster.second + offset(engine), -halfSize, halfSize);
+            }
+            double r = MinRadius + (MaxRadius - MinRadius) * unit(engine);
+            // Resting on the curved ground.
+            spheres[i] = { x, r - (x * x + z * z) / (2.0 * radius), z, r };
+        }
+    };
+    if (pool != nullptr) {
+        pool->parallelFor(chunkCount, generateChunk);
+    }
+    else {
+        for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+            generateChunk(chunk);
+        }
+    }
+
+    return { builder.build(statistics) };
+}
+
+CameraSettings generatedCameraSettings(const GeneratorSettings& settings) {
+    double halfSize = fieldHalfSize(settings);
+    CameraSettings camera = {};
+    camera.position = { 1.2 * halfSize, 0.3 * halfSize + 2.0, 1.2 * halfSize };
+    camera.lookAt = { 0.0, 0.0, 0.0 };
+    camera.up = { 0.0, 1.0, 0.0 };
+    camera.verticalFov = 40.0;
+    camera.aperture = 0.0;
+    camera.focusDistance = 10.0;
+    return camera;
+}
@@ -0,0 +1,44 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#ifndef SCENE_GENERATOR_H
+#define SCENE_GENERATOR_H
+
+#include "Camera/Camera.h"
+#include "Shape/Shape.h"
+
+class ThreadPool;
+struct SceneStatistics;
+
+struct GeneratorSettings {
+    size_t sphereCount = 1000000;
+    // Share of the ground covered by spheres, which sets the size of the field.
+    double density = 0.3;
+    // Relative weights of diffuse, metal, glass and light materials.
+    double materialMix[4] = { 0.8, 0.15, 0.05, 0.0 };
+    // Gaussian clusters the spheres gather in, zero for a uniform field.
+    int clusterCount = 0;
+    // Distinct materials of each kind the spheres draw from.
+    int paletteSize = 256;
+};
+
+/*
+ * Scene of settings.sphereCount small spheres of random size and material on a field of ground, for
+ * benchmarks at scale. The spheres are generated straight into the arrays of a SceneBuilder, in chunks
+ * of 65536 spread over pool (serially without one). Each chunk draws from its own engine seeded with
+ * the seed and the chunk number, so a seed gives the same scene for any thread count. Spheres may
+ * overlap. statistics, when given, receive the size of the scene.
+ */
+std::vector<std::shared_ptr<Shape>> generatedScene(const GeneratorSettings& settings, unsigned seed,
+                                                   ThreadPool* pool = nullptr, SceneStatistics* statistics = nullptr);
+
+// Looking across the field from above one corner, which depends on the size of the field.
+CameraSettings generatedCameraSettings(const GeneratorSettings& settings);
+
+#endif // SCENE_GENERATOR_H
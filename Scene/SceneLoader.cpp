@@ -0,0 +1,101 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#include "SceneLoader.h"
+
+#include "Scene/Scene.h"
+
+bool isSceneFile(const std::string& scene) {
+    return scene != "random_balls" && scene != "test" && scene != "many_lights" && scene != "generated";
+}
+
+SceneDescription readScene(const std::string& filename) {
+    const std::string binaryExtension = ".rtscene";
+    if (filename.size() > binaryExtension.size() &&
+        filename.compare(filename.size() - binaryExtension.size(), binaryExtension.size(), binaryExtension) == 0) {
+        return readBinaryScene(filename);
+    }
+    return readSceneFile(filename);
+}
+
+void loadScene(const RenderOptions& options, unsigned seed, std::shared_ptr<Camera>& camera,
+               std::vector<std::shared_ptr<Shape>>& shapeList, SceneDescription* file, ThreadPool* pool,
+               SceneStatistics* statistics) {
+    if (isSceneFile(options.scene)) {
+        SceneDescription read = {};
+        if (file == nullptr) {
+            read = readScene(options.scene);
+            file = &read;
+        }
+        camera = std::make_shared<Camera>(options.aspectRatio, file->camera);
+        shapeList = std::move(file->shapes);
+        if (statistics != nullptr) {
+            *statistics = file->statistics;
+        }
+    }
+    else if (options.scene == "test") {
+        camera = testCamera(options.aspectRatio);
+        shapeList = testScene(statistics);
+    }
+    else if (options.scene == "many_lights") {
+        camera = manyLightsCamera(options.aspectRatio);
+        shapeList = manyLightsScene(options.lightCount, statistics);
+    }
+    else if (options.scene == "generated") {
+        camera = std::make_shared<Camera>(options.aspectRatio, generatedCameraSettings(options.generator));
+        shapeList = generatedScene(options.generator, seed, pool, statistics);
+    }
+    else {
+        camera = randomBallsCamera(options.aspectRatio);
+        shapeList = randomBallsScene(statistics);
+    }
+}
+
+size_t buildHierarchies(const std::vector<std::shared_ptr<Shape>>& shapeList, ThreadPool* pool) {
+    size_t nodeCount = 0;
+    for (const auto& shape : shapeList) {
+        if (auto set = std::dynamic_pointer_cast<SphereSet>(shape)) {
+            set->buildHierarchy(pool);
+            nodeCount += set->nodeCount();
+        }
+    }
+    return nodeCount;
+}
+
+CameraSettings sceneCameraSettings(const RenderOptions& options, const SceneDescription* file) {
+    if (isSceneFile(options.scene)) {
+        return file != nullptr ? file->camera : readScene(options.scene).camera;
+    }
+    else if (options.scene == "test") {
+        return testCameraSettings();
+    }
+    else if (options.scene == "many_lights") {
+        return manyLightsCameraSettings();
+    }
+    else if (options.scene == "generated") {
+        return generatedCameraSettings(options.generator);
+    }
+    return randomBallsCameraSettings();
+}
+
+void applySceneSettings(const SceneDescription& file, RenderOptions& options) {
+    auto given = [&options](const char* name) { return options.givenOptions.count(name) > 0; };
+    if (file.imageWidth > 0 && file.imageHeight > 0) {
+        options.aspectRatio = static_cast<double>(file.imageWidth) / file.imageHeight;
+    }
+    if (file.imageWidth > 0 && !given("--width")) {
+        options.imageWidth = file.imageWidth;
+    }
+    if (file.sampleCount > 0 && !given("--spp")) {
+        options.sampleCount = file.sampleCount;
+    }
+    if (file.maxDepth > 0 && !given("--depth")) {
+        options.maxDepth = file.maxDepth;
+    }
+}
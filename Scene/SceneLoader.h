@@ -0,0 +1,44 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#ifndef SCENE_LOADER_H
+#define SCENE_LOADER_H
+
+#include "Camera/Camera.h"
+#include "RayTracer/RenderOptions.h"
+#include "Scene/BinaryScene.h"
+#include "Scene/SceneFile.h"
+#include "Scene/SceneGenerator.h"
+#include "Shape/Shape.h"
+
+// Whether options.scene names a scene file rather than one of the built-in scenes.
+bool isSceneFile(const std::string& scene);
+
+// A binary scene (.rtscene) or a text one, see BinaryScene.h and SceneFile.h.
+SceneDescription readScene(const std::string& filename);
+
+// Camera and shapes of the scene named by options.scene. Random scenes draw from defaultRandomEngine,
+// the generated one from seed, so the same seed gives the same scene in every process. The shapes of
+// a scene file are taken from file when given, which is read otherwise. The generated scene is spread
+// over pool when given. statistics, when given, receive the size of the scene.
+void loadScene(const RenderOptions& options, unsigned seed, std::shared_ptr<Camera>& camera,
+               std::vector<std::shared_ptr<Shape>>& shapeList, SceneDescription* file = nullptr,
+               ThreadPool* pool = nullptr, SceneStatistics* statistics = nullptr);
+
+// Put a bounding volume hierarchy over every sphere set of shapeList, see SphereSet::buildHierarchy.
+// Returns the number of nodes built.
+size_t buildHierarchies(const std::vector<std::shared_ptr<Shape>>& shapeList, ThreadPool* pool = nullptr);
+
+// Default camera placement of the scene named by options.scene.
+CameraSettings sceneCameraSettings(const RenderOptions& options, const SceneDescription* file = nullptr);
+
+// Take the render settings of a scene file over, except the ones given on the command line.
+void applySceneSettings(const SceneDescription& file, RenderOptions& options);
+
+#endif // SCENE_LOADER_H
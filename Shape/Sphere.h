@@ -23,6 +23,10 @@ public:
 public:
     bool hit(const Ray &r, double t_min, double t_max, HitResult &result) const override;
 
+public:
+    inline Vector3d center() const { return m_center; }
+    inline double radius() const { return m_radius; }
+
 private:
     Vector3d m_center = {};
     double m_radius = 0.0f;
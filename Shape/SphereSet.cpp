@@ -0,0 +1,258 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "Concurrency/ThreadPool.h"
+
+#include "SphereSet.h"
+
+namespace {
+    // Spheres of a leaf, and sets up to this size are not worth a hierarchy.
+    constexpr size_t LeafSize = 8;
+
+    struct BuildItem {
+        float center[3] = {};
+        uint32_t index = 0;
+    };
+
+    // Nearest floats at or beyond value, so that float bounds never cut into a sphere.
+    inline float floatBelow(double value) {
+        auto f = static_cast<float>(value);
+        return static_cast<double>(f) > value ? std::nextafter(f, -std::numeric_limits<float>::infinity()) : f;
+    }
+
+    inline float floatAbove(double value) {
+        auto f = static_cast<float>(value);
+        return static_cast<double>(f) < value ? std::nextafter(f, std::numeric_limits<float>::infinity()) : f;
+    }
+}
+
+std::shared_ptr<SphereSet> SphereSet::fromArrays(SphereArrays arrays, std::vector<std::shared_ptr<Material>> materials) {
+    auto storage = std::make_shared<SphereArrays>(std::move(arrays));
+    auto optional = [](const auto& array) { return array.empty() ? nullptr : array.data(); };
+    auto set = std::make_shared<SphereSet>(storage->spheres.data(), storage->materialIndices.data(),
+                                           storage->spheres.size(), std::move(materials), storage,
+                                           optional(storage->parents), optional(storage->priorities));
+    set->m_labelIndices = optional(storage->labelIndices);
+    set->m_labels = &storage->labels;
+    return set;
+}
+
+const std::string& SphereSet::label(size_t index) const {
+    static const std::string defaultLabel = "sphere";
+    return m_labelIndices != nullptr ? (*m_labels)[m_labelIndices[index]] : defaultLabel;
+}
+
+void SphereSet::hitSphere(size_t index, const Vector3d& origin, const Vector3d& direction, double a, double t_min,
+                          double& t_max, size_t& closest) const {
+    // Same test as Sphere::hit.
+    const PackedSphere& sphere = m_spheres[index];
+    double ocX = origin.x() - sphere.x, ocY = origin.y() - sphere.y, ocZ = origin.z() - sphere.z;
+    double half_b = ocX * direction.x() + ocY * direction.y() + ocZ * direction.z();
+    double c = ocX * ocX + ocY * ocY + ocZ * ocZ - sphere.radius * sphere.radius;
+
+    double discriminant = half_b * half_b - a * c;
+    if (discriminant < 0.0) return;
+
+    double sqrtd = sqrt(discriminant);
+    double root = (-half_b - sqrtd) / a;
+    if (root < t_min || root > t_max) {
+        root = (-half_b + sqrtd) / a;
+        if (root < t_min || root > t_max) return;
+    }
+    t_max = root;
+    closest = index;
+}
+
+bool SphereSet::hit(const Ray& r, double t_min, double t_max, HitResult& result) const {
+    Vector3d origin = r.origin();
+    Vector3d direction = r.direction();
+    double a = direction.length2();
+
+    size_t closest = m_count;
+    if (m_nodes.empty()) {
+        for (size_t i = 0; i < m_count; ++i) {
+            hitSphere(i, origin, direction, a, t_min, t_max, closest);
+        }
+    }
+    else {
+        // Slab test against the bounds of a node, up to the closest hit so far. A zero direction
+        // component makes an infinite inverse, NaN products then fail the comparisons and keep the node.
+        Vector3d inverse(1.0 / direction.x(), 1.0 / direction.y(), 1.0 / direction.z());
+        auto hitBounds = [&](const Node& node) {
+            double tNear = t_min, tFar = t_max;
+            for (int axis = 0; axis < 3; ++axis) {
+                double t0 = (node.lower[axis] - origin[axis]) * inverse[axis];
+                double t1 = (node.upper[axis] - origin[axis]) * inverse[axis];
+                if (inverse[axis] < 0.0) std::swap(t0, t1);
+                tNear = t0 > tNear ? t0 : tNear;
+                tFar = t1 < tFar ? t1 : tFar;
+            }
+            return tNear <= tFar;
+        };
+
+        // Each level pushes at most one node, median splits of 2^32 spheres are about 30 levels deep.
+        uint32_t stack[64];
+        size_t stackSize = 0;
+        uint32_t index = 0;
+        while (true) {
+            const Node& node = m_nodes[index];
+            if (hitBounds(node)) {
+                if (node.count == 0) {
+                    bool backwards = direction[node.axis] < 0.0;
+                    stack[stackSize++] = node.offset + (backwards ? 0 : 1);
+                    index = node.offset + (backwards ? 1 : 0);
+                    continue;
+                }
+                for (uint32_t k = node.offset; k < node.offset + node.count; ++k) {
+                    hitSphere(m_order[k], origin, direction, a, t_min, t_max, closest);
+                }
+            }
+            if (stackSize == 0) break;
+            index = stack[--stackSize];
+        }
+    }
+    if (closest == m_count) return false;
+
+    const PackedSphere& sphere = m_spheres[closest];
+    Vector3d center(sphere.x, sphere.y, sphere.z);
+    result.t = t_max;
+    result.position = r.at(result.t);
+    Vector3d outwardNormal = (result.position - center) / sphere.radius;
+    result.isOuter = dot(direction, outwardNormal) < 0.0;
+    result.normal = result.isOuter ? outwardNormal : -outwardNormal;
+    result.material = material(closest);
+    return true;
+}
+
+void SphereSet::buildHierarchy(ThreadPool* pool) {
+    m_nodes.clear();
+    m_order.clear();
+    if (m_count <= LeafSize || m_count > std::numeric_limits<uint32_t>::max()) return;
+
+    std::vector<BuildItem> items(m_count);
+    auto fillItems = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const PackedSphere& sphere = m_spheres[i];
+            items[i] = { { static_cast<float>(sphere.x), static_cast<float>(sphere.y), static_cast<float>(sphere.z) },
+                         static_cast<uint32_t>(i) };
+        }
+    };
+
+    // Leaves get their bounds here, interior nodes are fitted to their children afterwards. Ranges at
+    // deferDepth are left to deferred, with the node they start at, instead of being split further.
+    struct Subtree {
+        uint32_t node = 0;
+        size_t begin = 0, end = 0;
+    };
+    std::function<void(std::vector<Node>&, uint32_t, size_t, size_t, int, int, std::vector<Subtree>*)> split;
+    split = [&](std::vector<Node>& nodes, uint32_t index, size_t begin, size_t end, int depth, int deferDepth,
+                std::vector<Subtree>* deferred) {
+        if (end - begin <= LeafSize) {
+            double lower[3] = { infinity, infinity, infinity }, upper[3] = { -infinity, -infinity, -infinity };
+            for (size_t i = begin; i < end; ++i) {
+                const PackedSphere& sphere = m_spheres[items[i].index];
+                double center[3] = { sphere.x, sphere.y, sphere.z };
+                for (int axis = 0; axis < 3; ++axis) {
+                    lower[axis] = std::min(lower[axis], center[axis] - sphere.radius);
+                    upper[axis] = std::max(upper[axis], center[axis] + sphere.radius);
+                }
+            }
+            Node& node = nodes[index];
+            for (int axis = 0; axis < 3; ++axis) {
+                node.lower[axis] = floatBelow(lower[axis]);
+                node.upper[axis] = floatAbove(upper[axis]);
+            }
+            node.offset = static_cast<uint32_t>(begin);
+            node.count = static_cast<uint16_t>(end - begin);
+            return;
+        }
+        if (deferred != nullptr && depth == deferDepth) {
+            deferred->push_back({ index, begin, end });
+            return;
+        }
+
+        float lower[3] = { items[begin].center[0], items[begin].center[1], items[begin].center[2] };
+        float upper[3] = { lower[0], lower[1], lower[2] };
+        for (size_t i = begin + 1; i < end; ++i) {
+            for (int axis = 0; axis < 3; ++axis) {
+                lower[axis] = std::min(lower[axis], items[i].center[axis]);
+                upper[axis] = std::max(upper[axis], items[i].center[axis]);
+            }
+        }
+        int axis = 0;
+        for (int k = 1; k < 3; ++k) {
+            if (upper[k] - lower[k] > upper[axis] - lower[axis]) axis = k;
+        }
+        size_t middle = begin + (end - begin) / 2;
+        std::nth_element(items.begin() + begin, items.begin() + middle, items.begin() + end,
+                         [axis](const BuildItem& a, const BuildItem& b) { return a.center[axis] < b.center[axis]; });
+
+        auto first = static_cast<uint32_t>(nodes.size());
+        nodes[index].offset = first;
+        nodes[index].axis = static_cast<uint16_t>(axis);
+        nodes.resize(nodes.size() + 2);
+        split(nodes, first, begin, middle, depth + 1, deferDepth, deferred);
+        split(nodes, first + 1, middle, end, depth + 1, deferDepth, deferred);
+    };
+
+    // A few subtrees per worker keep the pool busy while the first levels are split on this thread.
+    std::vector<Subtree> subtrees = {};
+    int deferDepth = 0;
+    if (pool != nullptr) {
+        while ((size_t(1) << deferDepth) < 4 * pool->size()) ++deferDepth;
+        size_t chunkCount = pool->size();
+        pool->parallelFor(chunkCount, [&](size_t chunk) {
+            fillItems(m_count * chunk / chunkCount, m_count * (chunk + 1) / chunkCount);
+        });
+    }
+    else {
+        fillItems(0, m_count);
+    }
+    m_nodes.reserve(2 * ((m_count + LeafSize / 2 - 1) / (LeafSize / 2)));
+    m_nodes.resize(1);
+    split(m_nodes, 0, 0, m_count, 0, deferDepth, pool != nullptr ? &subtrees : nullptr);
+
+    if (!subtrees.empty()) {
+        std::vector<std::vector<Node>> built(subtrees.size());
+        pool->parallelFor(subtrees.size(), [&](size_t i) {
+            built[i].resize(1);
+            split(built[i], 0, subtrees[i].begin, subtrees[i].end, 0, 0, nullptr);
+        });
+        // The root of a subtree takes the place left for it, the rest is appended and renumbered.
+        for (size_t i = 0; i < subtrees.size(); ++i) {
+            auto base = static_cast<uint32_t>(m_nodes.size()) - 1;
+            for (auto& node : built[i]) {
+                if (node.count == 0) node.offset += base;
+            }
+            m_nodes[subtrees[i].node] = built[i].front();
+            m_nodes.insert(m_nodes.end(), built[i].begin() + 1, built[i].end());
+        }
+    }
+
+    // Children always come after their parent.
+    for (size_t i = m_nodes.size(); i-- > 0;) {
+        Node& node = m_nodes[i];
+        if (node.count > 0) continue;
+        const Node& a = m_nodes[node.offset];
+        const Node& b = m_nodes[node.offset + 1];
+        for (int axis = 0; axis < 3; ++axis) {
+            node.lower[axis] = std::min(a.lower[axis], b.lower[axis]);
+            node.upper[axis] = std::max(a.upper[axis], b.upper[axis]);
+        }
+    }
+
+    m_order.resize(m_count);
+    for (size_t i = 0; i < m_count; ++i) {
+        m_order[i] = items[i].index;
+    }
+}
@@ -0,0 +1,116 @@
+/*
+ * Ray Tracer @ https://github.com/yiyaowen/RayTracer
+ *
+ * yiyaowen 2021 (c) All Rights Reserved.
+ *
+ * Also see tutorial: Ray Tracing in One Weekend by Peter Shirley.
+ * Web URL: https://raytracing.github.io/books/RayTracingInOneWeekend.html
+*/
+
+#ifndef SPHERE_SET_H
+#define SPHERE_SET_H
+
+#include "Material/Material.h"
+#include "Ray/Ray.h"
+#include "Shape.h"
+
+// Geometry of one sphere, with the fixed layout of the sphere arrays in binary scene files.
+struct PackedSphere {
+    double x = 0.0, y = 0.0, z = 0.0;
+    double radius = 0.0;
+};
+
+static_assert(sizeof(PackedSphere) == 32, "Binary scene files rely on 32-byte spheres.");
+
+class ThreadPool;
+
+// Arrays of a sphere set built in memory, hot ones first. The cold ones are either empty, when no
+// sphere has a parent, priority or label of its own, or hold one entry per sphere.
+struct SphereArrays {
+    std::vector<PackedSphere> spheres = {};
+    std::vector<uint32_t> materialIndices = {};
+
+    std::vector<int32_t> parents = {};
+    std::vector<uint32_t> priorities = {};
+    // Indices into labels, which holds every distinct label once.
+    std::vector<uint32_t> labelIndices = {};
+    std::vector<std::string> labels = {};
+};
+
+/*
+ * Many spheres as a single shape, a dense array of geometry plus the index of each sphere into a small
+ * material table. Parent indices, priorities and labels of the spheres are kept in separate arrays that
+ * hits never touch. The arrays are only viewed, e.g. in a mapped binary scene file, and kept alive by
+ * the storage handed in with them, so that no sphere is an object of its own. Hits test every sphere
+ * until buildHierarchy puts a bounding volume hierarchy over them, which leaves the arrays as they are.
+ */
+class SphereSet : public Shape {
+public:
+    // parents (-1 for none) and priorities may be nullptr when the spheres have neither.
+    SphereSet(const PackedSphere* spheres, const uint32_t* materialIndices, size_t count,
+              std::vector<std::shared_ptr<Material>> materials, std::shared_ptr<const void> storage,
+              const int32_t* parents = nullptr, const uint32_t* priorities = nullptr)
+        : Shape("sphere_set"), m_spheres(spheres), m_materialIndices(materialIndices), m_parents(parents),
+          m_priorities(priorities), m_count(count), m_materials(std::move(materials)), m_storage(std::move(storage)) {}
+
+    // A set owning its arrays, see SceneBuilder.
+    static std::shared_ptr<SphereSet> fromArrays(SphereArrays arrays, std::vector<std::shared_ptr<Material>> materials);
+
+public:
+    // Closest hit among all spheres.
+    bool hit(const Ray& r, double t_min, double t_max, HitResult& result) const override;
+
+    // Split the spheres at the median of their centers along the widest axis down to leaves of a few,
+    // the subtrees below the first levels in parallel over pool when given. Sets too small to gain
+    // from it keep testing every sphere.
+    void buildHierarchy(ThreadPool* pool = nullptr);
+
+    inline size_t nodeCount() const { return m_nodes.size(); }
+
+public:
+    inline size_t size() const { return m_count; }
+
+    inline const PackedSphere& sphere(size_t index) const { return m_spheres[index]; }
+
+    inline const std::shared_ptr<Material>& material(size_t index) const { return m_materials[m_materialIndices[index]]; }
+    inline uint32_t materialIndex(size_t index) const { return m_materialIndices[index]; }
+    inline const std::vector<std::shared_ptr<Material>>& materials() const { return m_materials; }
+
+    inline int32_t parent(size_t index) const { return m_parents != nullptr ? m_parents[index] : -1; }
+    inline uint32_t priority(size_t index) const { return m_priorities != nullptr ? m_priorities[index] : 0; }
+
+    // "sphere" for spheres without a label of their own.
+    const std::string& label(size_t index) const;
+
+private:
+    // Bounds rounded outwards to floats, 32 bytes, two nodes to a cache line.
+    struct Node {
+        float lower[3] = {}, upper[3] = {};
+        // Leaf: first entry of m_order. Interior: index of the first child, the second one follows it.
+        uint32_t offset = 0;
+        uint16_t count = 0; // Spheres of a leaf, zero for interior nodes.
+        uint16_t axis = 0;  // Interior: axis the children were split along, nearer one is visited first.
+    };
+
+    // Hits narrow t_max to the closest root so far and set closest to the sphere of it.
+    inline void hitSphere(size_t index, const Vector3d& origin, const Vector3d& direction, double a, double t_min,
+                          double& t_max, size_t& closest) const;
+
+private:
+    const PackedSphere* m_spheres = nullptr;
+    const uint32_t* m_materialIndices = nullptr;
+    const int32_t* m_parents = nullptr;
+    const uint32_t* m_priorities = nullptr;
+    const uint32_t* m_labelIndices = nullptr;
+    const std::vector<std::string>* m_labels = nullptr;
+    size_t m_count = 0;
+
+    std::vector<std::shared_ptr<Material>> m_materials = {};
+    std::shared_ptr<const void> m_storage = nullptr;
+
+    // Empty without a hierarchy. Leaves own consecutive runs of m_order, the indices of their spheres.
+    std::vector<Node> m_nodes = {};
+    std::vector<uint32_t> m_order = {};
+};
+
+#endif // SPHERE_SET_H